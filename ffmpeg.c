@@ -158,6 +158,23 @@ static int restore_tty;
 
 #if HAVE_PTHREADS
 static void free_input_threads(void);
+static int free_encoder_threads(void);
+static void free_filtergraph_threads(void);
+static void free_output_threads(void);
+static void check_muxer_errors(void);
+
+/* serializes writing the video stats while encoder threads are running */
+static pthread_mutex_t vstats_lock;
+/* protects current_time, the muxing queue peaks, and the frame_number,
+ * quality, pict_type and error fields of the output streams written by their
+ * encoder thread */
+static pthread_mutex_t enc_state_lock;
+static int encoder_threads_active;
+
+typedef struct FilterGraphMessage {
+    InputFilter *ifilter;
+    AVFrame     *frame;
+} FilterGraphMessage;
 #endif
 
 /* sub2video hack:
@@ -467,9 +484,13 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+#if HAVE_PTHREADS
+    free_filtergraph_threads();
+#endif
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         avfilter_graph_free(&fg->graph);
+        avfilter_formats_cache_free(&fg->formats_cache);
         for (j = 0; j < fg->nb_inputs; j++) {
             av_freep(&fg->inputs[j]->name);
             av_freep(&fg->inputs[j]);
@@ -488,6 +509,18 @@ static void ffmpeg_cleanup(int ret)
 
     av_freep(&subtitle_out);
 
+#if HAVE_PTHREADS
+    /* drop the frames still waiting to be encoded */
+    for (i = 0; i < nb_output_streams; i++)
+        if (output_streams[i] && output_streams[i]->enc_thread_queue)
+            av_thread_message_flush(output_streams[i]->enc_thread_queue);
+    free_encoder_threads();
+    for (i = 0; i < nb_output_files; i++)
+        if (output_files[i] && output_files[i]->mux_thread_queue)
+            av_thread_message_flush(output_files[i]->mux_thread_queue);
+    free_output_threads();
+#endif
+
     /* close files */
     for (i = 0; i < nb_output_files; i++) {
         OutputFile *of = output_files[i];
@@ -616,13 +649,31 @@ static void abort_codec_experimental(AVCodec *c, int encoder)
     exit_program(1);
 }
 
+static void lock_encoder_state(void)
+{
+#if HAVE_PTHREADS
+    if (encoder_threads_active)
+        pthread_mutex_lock(&enc_state_lock);
+#endif
+}
+
+static void unlock_encoder_state(void)
+{
+#if HAVE_PTHREADS
+    if (encoder_threads_active)
+        pthread_mutex_unlock(&enc_state_lock);
+#endif
+}
+
 static void update_benchmark(const char *fmt, ...)
 {
     if (do_benchmark_all) {
-        int64_t t = getutime();
+        int64_t t;
         va_list va;
         char buf[1024];
 
+        lock_encoder_state();
+        t = getutime();
         if (fmt) {
             va_start(va, fmt);
             vsnprintf(buf, sizeof(buf), fmt, va);
@@ -630,7 +681,68 @@ static void update_benchmark(const char *fmt, ...)
             av_log(NULL, AV_LOG_INFO, "bench: %8"PRIu64" %s \n", t - current_time, buf);
         }
         current_time = t;
+        unlock_encoder_state();
+    }
+}
+
+/**
+ * @return the current write position in an output file
+ */
+static int64_t output_file_pos(OutputFile *of)
+{
+#if HAVE_PTHREADS
+    /* the muxer thread owns the AVIOContext while it runs */
+    if (of->mux_thread_queue) {
+        int64_t pos;
+
+        pthread_mutex_lock(&of->mux_lock);
+        pos = of->mux_size;
+        pthread_mutex_unlock(&of->mux_lock);
+        return pos;
     }
+#endif
+    return avio_tell(of->ctx->pb);
+}
+
+/**
+ * @return the size of an output file, as far as it can be known
+ */
+static int64_t output_file_size(OutputFile *of)
+{
+    int64_t size;
+
+#if HAVE_PTHREADS
+    if (of->mux_thread_queue)
+        return output_file_pos(of);
+#endif
+    size = avio_size(of->ctx->pb);
+    if (size <= 0) // FIXME improve avio_size() so it works with non seekable output too
+        size = avio_tell(of->ctx->pb);
+    return size;
+}
+
+/**
+ * Get the current dts, the end pts and the number of frames written of an
+ * output stream, from the copy made by the muxer thread if it runs.
+ */
+static void get_mux_state(OutputStream *ost, int64_t *cur_dts,
+                          int64_t *end_pts, int64_t *nb_frames)
+{
+#if HAVE_PTHREADS
+    OutputFile *of = output_files[ost->file_index];
+
+    if (of->mux_thread_queue) {
+        pthread_mutex_lock(&of->mux_lock);
+        *cur_dts   = ost->mux_cur_dts;
+        *end_pts   = ost->mux_end_pts;
+        *nb_frames = ost->mux_nb_frames;
+        pthread_mutex_unlock(&of->mux_lock);
+        return;
+    }
+#endif
+    *cur_dts   = ost->st->cur_dts;
+    *end_pts   = av_stream_get_end_pts(ost->st);
+    *nb_frames = ost->st->nb_frames;
 }
 
 static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream, OSTFinished others)
@@ -658,11 +770,20 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
                 av_log(NULL, AV_LOG_ERROR,
                        "Too many packets buffered for output stream %d:%d.\n",
                        ost->file_index, ost->st->index);
-                exit_program(1);
+                ret = AVERROR(ENOSPC);
+            } else {
+                ret = av_fifo_realloc2(ost->muxing_queue, new_size);
             }
-            ret = av_fifo_realloc2(ost->muxing_queue, new_size);
-            if (ret < 0)
+            if (ret < 0) {
+#if HAVE_PTHREADS
+                if (ost->enc_thread_queue) {
+                    ost->enc_thread_ret = ret;
+                    av_packet_unref(pkt);
+                    return;
+                }
+#endif
                 exit_program(1);
+            }
         }
         av_packet_move_ref(&tmp_pkt, pkt);
         av_fifo_generic_write(ost->muxing_queue, &tmp_pkt, sizeof(tmp_pkt), NULL);
@@ -685,12 +806,15 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
             av_packet_unref(pkt);
             return;
         }
+        lock_encoder_state();
         ost->frame_number++;
+        unlock_encoder_state();
     }
     if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-        int i;
+        int i, is_cfr;
         uint8_t *sd = av_packet_get_side_data(pkt, AV_PKT_DATA_QUALITY_STATS,
                                               NULL);
+        lock_encoder_state();
         ost->quality = sd ? AV_RL32(sd) : -1;
         ost->pict_type = sd ? sd[4] : AV_PICTURE_TYPE_NONE;
 
@@ -700,8 +824,10 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
             else
                 ost->error[i] = -1;
         }
+        is_cfr = ost->is_cfr;
+        unlock_encoder_state();
 
-        if (ost->frame_rate.num && ost->is_cfr) {
+        if (ost->frame_rate.num && is_cfr) {
             if (pkt->duration > 0)
                 av_log(NULL, AV_LOG_WARNING, "Overriding packet duration by frame rate, this should not happen\n");
             pkt->duration = av_rescale_q(1, av_inv_q(ost->frame_rate),
@@ -733,6 +859,15 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
                        ost->file_index, ost->st->index, ost->last_mux_dts, pkt->dts);
                 if (exit_on_error) {
                     av_log(NULL, AV_LOG_FATAL, "aborting.\n");
+#if HAVE_PTHREADS
+                    /* the encoder thread must not exit, it stops and the
+                     * main thread exits once it notices */
+                    if (ost->enc_thread_queue) {
+                        ost->enc_thread_ret = AVERROR(EINVAL);
+                        av_packet_unref(pkt);
+                        return;
+                    }
+#endif
                     exit_program(1);
                 }
                 av_log(s, loglevel, "changing to %"PRId64". This may result "
@@ -761,9 +896,50 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost)
               );
     }
 
+#if HAVE_PTHREADS
+    if (of->mux_thread_queue) {
+        int nb_queued;
+
+        /* the packet may point to a buffer that is about to be reused */
+        if (!pkt->buf) {
+            AVPacket tmp_pkt;
+            av_init_packet(&tmp_pkt);
+            ret = av_packet_ref(&tmp_pkt, pkt);
+            av_packet_unref(pkt);
+            if (ret < 0) {
+                print_error("av_packet_ref()", ret);
+                return;
+            }
+            av_packet_move_ref(pkt, &tmp_pkt);
+        }
+        ret = av_thread_message_queue_send(of->mux_thread_queue, pkt, 0);
+        if (ret < 0) {
+            /* the muxer thread has failed and already reported it */
+            av_packet_unref(pkt);
+            return;
+        }
+        /* the queue owns the packet now */
+        av_init_packet(pkt);
+        pkt->data = NULL;
+        pkt->size = 0;
+        nb_queued = av_thread_message_queue_nb_elems(of->mux_thread_queue);
+        lock_encoder_state();
+        of->mux_queue_peak = FFMAX(of->mux_queue_peak, nb_queued);
+        unlock_encoder_state();
+        return;
+    }
+#endif
+
     ret = av_interleaved_write_frame(s, pkt);
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
+#if HAVE_PTHREADS
+        if (ost->enc_thread_queue) {
+            ost->enc_thread_ret = ret;
+            av_packet_unref(pkt);
+            return;
+        }
+#endif
         main_return_code = 1;
         close_all_output_streams(ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
     }
@@ -838,8 +1014,15 @@ finish:
     if (ret < 0 && ret != AVERROR_EOF) {
         av_log(NULL, AV_LOG_ERROR, "Error applying bitstream filters to an output "
                "packet for stream #%d:%d.\n", ost->file_index, ost->index);
-        if(exit_on_error)
+        if(exit_on_error) {
+#if HAVE_PTHREADS
+            if (ost->enc_thread_queue) {
+                ost->enc_thread_ret = ret;
+                return;
+            }
+#endif
             exit_program(1);
+        }
     }
 }
 
@@ -856,10 +1039,17 @@ static int check_recording_time(OutputStream *ost)
     return 1;
 }
 
-static void do_audio_out(OutputFile *of, OutputStream *ost,
-                         AVFrame *frame)
+/**
+ * Send a frame to the encoder of the given output stream and pass all the
+ * packets it returns to the muxer.
+ *
+ * @return  0 for success, <0 for error
+ */
+static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
 {
     AVCodecContext *enc = ost->enc_ctx;
+    const char *type    = av_get_media_type_string(enc->codec_type);
+    int64_t frame_pts   = frame->pts;
     AVPacket pkt;
     int ret;
 
@@ -867,53 +1057,238 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
     pkt.data = NULL;
     pkt.size = 0;
 
-    if (!check_recording_time(ost))
-        return;
-
-    if (frame->pts == AV_NOPTS_VALUE || audio_sync_method < 0)
-        frame->pts = ost->sync_opts;
-    ost->sync_opts = frame->pts + frame->nb_samples;
-    ost->samples_encoded += frame->nb_samples;
-    ost->frames_encoded++;
-
-    av_assert0(pkt.size || !pkt.data);
-    update_benchmark(NULL);
-    if (debug_ts) {
-        av_log(NULL, AV_LOG_INFO, "encoder <- type:audio "
-               "frame_pts:%s frame_pts_time:%s time_base:%d/%d\n",
-               av_ts2str(frame->pts), av_ts2timestr(frame->pts, &enc->time_base),
-               enc->time_base.num, enc->time_base.den);
-    }
+    /* set here rather than in reap_filters(), which may run concurrently
+       with an encoder thread using the context */
+    if (enc->codec_type == AVMEDIA_TYPE_VIDEO && !ost->frame_aspect_ratio.num)
+        enc->sample_aspect_ratio = frame->sample_aspect_ratio;
 
     ret = avcodec_send_frame(enc, frame);
     if (ret < 0)
-        goto error;
+        return ret;
 
     while (1) {
+        int frame_size;
+
         ret = avcodec_receive_packet(enc, &pkt);
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO)
+            update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
         if (ret == AVERROR(EAGAIN))
             break;
         if (ret < 0)
-            goto error;
+            return ret;
+        if (enc->codec_type == AVMEDIA_TYPE_AUDIO)
+            update_benchmark("encode_audio %d.%d", ost->file_index, ost->index);
 
-        update_benchmark("encode_audio %d.%d", ost->file_index, ost->index);
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+            if (debug_ts) {
+                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
+                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
+            }
+
+            if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                pkt.pts = frame_pts;
+        }
 
         av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
 
         if (debug_ts) {
-            av_log(NULL, AV_LOG_INFO, "encoder -> type:audio "
+            av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                   type,
                    av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->st->time_base),
                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->st->time_base));
         }
 
+        frame_size = pkt.size;
         output_packet(of, &pkt, ost);
+
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+            /* if two pass, output log */
+            if (ost->logfile && enc->stats_out) {
+                fprintf(ost->logfile, "%s", enc->stats_out);
+            }
+
+            if (vstats_filename && frame_size) {
+#if HAVE_PTHREADS
+                if (encoder_threads_active)
+                    pthread_mutex_lock(&vstats_lock);
+#endif
+                do_video_stats(ost, frame_size);
+#if HAVE_PTHREADS
+                if (encoder_threads_active)
+                    pthread_mutex_unlock(&vstats_lock);
+#endif
+            }
+        }
     }
 
-    return;
-error:
-    av_log(NULL, AV_LOG_FATAL, "Audio encoding failed\n");
-    exit_program(1);
+    return 0;
+}
+
+#if HAVE_PTHREADS
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    OutputFile    *of = output_files[ost->file_index];
+    AVFrame *frame;
+    int ret;
+
+    while (1) {
+        ret = av_thread_message_queue_recv(ost->enc_thread_queue, &frame, 0);
+        if (ret < 0)
+            break;
+
+        ret = encode_frame(of, ost, frame);
+        av_frame_free(&frame);
+        /* muxing errors are recorded in enc_thread_ret by write_packet() */
+        if (ret >= 0)
+            ret = ost->enc_thread_ret;
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR,
+                   "Error encoding a frame for output stream #%d:%d: %s\n",
+                   ost->file_index, ost->index, av_err2str(ret));
+            ost->enc_thread_ret = ret;
+            av_thread_message_queue_set_err_send(ost->enc_thread_queue, ret);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void free_encoder_frame(void *msg)
+{
+    av_frame_free(msg);
+}
+
+/**
+ * Stop all the encoder threads, after they have encoded every queued frame.
+ *
+ * @return  0 for success, <0 if any of the encoders failed
+ */
+static int free_encoder_threads(void)
+{
+    int i, ret = 0;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!ost || !ost->enc_thread_queue)
+            continue;
+        av_thread_message_queue_set_err_recv(ost->enc_thread_queue, AVERROR_EOF);
+        pthread_join(ost->enc_thread, NULL);
+        av_thread_message_queue_free(&ost->enc_thread_queue);
+        if (ost->enc_thread_ret < 0)
+            ret = ost->enc_thread_ret;
+    }
+
+    if (encoder_threads_active) {
+        pthread_mutex_destroy(&vstats_lock);
+        pthread_mutex_destroy(&enc_state_lock);
+        encoder_threads_active = 0;
+    }
+
+    return ret;
+}
+
+static int init_encoder_threads(void)
+{
+    int i, ret;
+
+    if (!do_pipeline)
+        return 0;
+
+    if ((ret = pthread_mutex_init(&vstats_lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_mutex_init(&enc_state_lock, NULL))) {
+        pthread_mutex_destroy(&vstats_lock);
+        return AVERROR(ret);
+    }
+    encoder_threads_active = 1;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!ost->encoding_needed ||
+            (ost->enc_ctx->codec_type != AVMEDIA_TYPE_VIDEO &&
+             ost->enc_ctx->codec_type != AVMEDIA_TYPE_AUDIO))
+            continue;
+#if FF_API_LAVF_FMT_RAWPICTURE
+        if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO &&
+            output_files[ost->file_index]->ctx->oformat->flags & AVFMT_RAWPICTURE &&
+            ost->enc_ctx->codec->id == AV_CODEC_ID_RAWVIDEO)
+            continue;
+#endif
+
+        ret = av_thread_message_queue_alloc(&ost->enc_thread_queue,
+                                            ost->enc_queue_size, sizeof(AVFrame *));
+        if (ret < 0)
+            return ret;
+        av_thread_message_queue_set_free_func(ost->enc_thread_queue,
+                                              free_encoder_frame);
+
+        if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            av_thread_message_queue_free(&ost->enc_thread_queue);
+            return AVERROR(ret);
+        }
+    }
+    return 0;
+}
+#endif
+
+/**
+ * Encode a frame, either directly or by handing a reference to it over to
+ * the encoder thread of the output stream.
+ *
+ * @return  0 for success, <0 for error
+ */
+static int send_frame_to_encoder(OutputFile *of, OutputStream *ost, AVFrame *frame)
+{
+#if HAVE_PTHREADS
+    if (ost->enc_thread_queue) {
+        AVFrame *f = av_frame_clone(frame);
+        int ret;
+
+        if (!f)
+            return AVERROR(ENOMEM);
+        ret = av_thread_message_queue_send(ost->enc_thread_queue, &f, 0);
+        if (ret < 0)
+            av_frame_free(&f);
+        return ret;
+    }
+#endif
+    return encode_frame(of, ost, frame);
+}
+
+static void do_audio_out(OutputFile *of, OutputStream *ost,
+                         AVFrame *frame)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+
+    if (!check_recording_time(ost))
+        return;
+
+    if (frame->pts == AV_NOPTS_VALUE || audio_sync_method < 0)
+        frame->pts = ost->sync_opts;
+    ost->sync_opts = frame->pts + frame->nb_samples;
+    ost->samples_encoded += frame->nb_samples;
+    ost->frames_encoded++;
+
+    update_benchmark(NULL);
+    if (debug_ts) {
+        av_log(NULL, AV_LOG_INFO, "encoder <- type:audio "
+               "frame_pts:%s frame_pts_time:%s time_base:%d/%d\n",
+               av_ts2str(frame->pts), av_ts2timestr(frame->pts, &enc->time_base),
+               enc->time_base.num, enc->time_base.den);
+    }
+
+    if (send_frame_to_encoder(of, ost, frame) < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Audio encoding failed\n");
+        exit_program(1);
+    }
 }
 
 static void do_subtitle_out(OutputFile *of,
@@ -1011,7 +1386,6 @@ static void do_video_out(OutputFile *of,
     int nb_frames, nb0_frames, i;
     double delta, delta0;
     double duration = 0;
-    int frame_size = 0;
     InputStream *ist = NULL;
     AVFilterContext *filter = ost->filter->filter;
 
@@ -1062,7 +1436,9 @@ static void do_video_out(OutputFile *of,
                 format_video_sync = VSYNC_VSCFR;
             }
         }
+        lock_encoder_state();
         ost->is_cfr = (format_video_sync == VSYNC_CFR || format_video_sync == VSYNC_VSCFR);
+        unlock_encoder_state();
 
         if (delta0 < 0 &&
             delta > 0 &&
@@ -1247,45 +1623,9 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
-        ret = avcodec_send_frame(enc, in_picture);
+        ret = send_frame_to_encoder(of, ost, in_picture);
         if (ret < 0)
             goto error;
-
-        while (1) {
-            ret = avcodec_receive_packet(enc, &pkt);
-            update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
-            if (ret == AVERROR(EAGAIN))
-                break;
-            if (ret < 0)
-                goto error;
-
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
-                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
-            }
-
-            if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
-                pkt.pts = ost->sync_opts;
-
-            av_packet_rescale_ts(&pkt, enc->time_base, ost->st->time_base);
-
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                    av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->st->time_base),
-                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->st->time_base));
-            }
-
-            frame_size = pkt.size;
-            output_packet(of, &pkt, ost);
-
-            /* if two pass, output log */
-            if (ost->logfile && enc->stats_out) {
-                fprintf(ost->logfile, "%s", enc->stats_out);
-            }
-        }
     }
     ost->sync_opts++;
     /*
@@ -1294,9 +1634,6 @@ static void do_video_out(OutputFile *of,
      * flush, we need to limit them here, before they go into encoder.
      */
     ost->frame_number++;
-
-    if (vstats_filename && frame_size)
-        do_video_stats(ost, frame_size);
   }
 
     if (!ost->last_frame)
@@ -1322,20 +1659,14 @@ static void do_video_stats(OutputStream *ost, int frame_size)
 {
     AVCodecContext *enc;
     int frame_number;
+    int64_t cur_dts, end_pts, nb_frames;
     double ti1, bitrate, avg_bitrate;
 
-    /* this is executed just the first time do_video_stats is called */
-    if (!vstats_file) {
-        vstats_file = fopen(vstats_filename, "w");
-        if (!vstats_file) {
-            perror("fopen");
-            exit_program(1);
-        }
-    }
-
+    /* vstats_file was opened by transcode_init() */
     enc = ost->enc_ctx;
     if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
-        frame_number = ost->st->nb_frames;
+        get_mux_state(ost, &cur_dts, &end_pts, &nb_frames);
+        frame_number = nb_frames;
         fprintf(vstats_file, "frame= %5d q= %2.1f ", frame_number,
                 ost->quality / (float)FF_QP2LAMBDA);
 
@@ -1344,7 +1675,7 @@ static void do_video_stats(OutputStream *ost, int frame_size)
 
         fprintf(vstats_file,"f_size= %6d ", frame_size);
         /* compute pts value */
-        ti1 = av_stream_get_end_pts(ost->st) * av_q2d(ost->st->time_base);
+        ti1 = end_pts * av_q2d(ost->st->time_base);
         if (ti1 < 0.01)
             ti1 = 0.01;
 
@@ -1437,9 +1768,6 @@ static int reap_filters(int flush)
 
             switch (filter->inputs[0]->type) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
-
                 if (debug_ts) {
                     av_log(NULL, AV_LOG_INFO, "filter -> pts:%s pts_time:%s exact:%f time_base:%d/%d\n",
                             av_ts2str(filtered_frame->pts), av_ts2timestr(filtered_frame->pts, &enc->time_base),
@@ -1576,6 +1904,11 @@ static void print_final_stats(int64_t total_size)
 
         av_log(NULL, AV_LOG_VERBOSE, "  Total: %"PRIu64" packets (%"PRIu64" bytes) muxed\n",
                total_packets, total_size);
+#if HAVE_PTHREADS
+        if (of->mux_queue_peak)
+            av_log(NULL, AV_LOG_VERBOSE, "  Muxing queue: at most %d of %d packets queued\n",
+                   of->mux_queue_peak, of->thread_queue_size);
+#endif
     }
     if(video_size + data_size + audio_size + subtitle_size + extra_size == 0){
         av_log(NULL, AV_LOG_WARNING, "Output file is empty, nothing was encoded ");
@@ -1587,15 +1920,32 @@ static void print_final_stats(int64_t total_size)
     }
 }
 
+static void print_filter_profile(void)
+{
+    int i;
+
+    for (i = 0; i < nb_filtergraphs; i++) {
+        char *dump;
+
+        if (!filtergraphs[i]->graph)
+            continue;
+        dump = avfilter_graph_dump(filtergraphs[i]->graph, "profile");
+        if (!dump)
+            continue;
+        av_log(NULL, AV_LOG_INFO, "Filtergraph #%d profile:\n%s", i, dump);
+        av_free(dump);
+    }
+}
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time)
 {
     char buf[1024];
     AVBPrint buf_script;
     OutputStream *ost;
-    AVFormatContext *oc;
     int64_t total_size;
     AVCodecContext *enc;
-    int frame_number, vid, i;
+    int frame_number, vid, i, nb_queues;
+    int64_t cur_dts, end_pts, nb_frames;
     double bitrate;
     double speed;
     int64_t pts = INT64_MIN + 1;
@@ -1621,15 +1971,12 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     t = (cur_time-timer_start) / 1000000.0;
 
 
-    oc = output_files[0]->ctx;
-
-    total_size = avio_size(oc->pb);
-    if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
-        total_size = avio_tell(oc->pb);
+    total_size = output_file_size(output_files[0]);
 
     buf[0] = '\0';
     vid = 0;
     av_bprint_init(&buf_script, 0, 1);
+    lock_encoder_state();
     for (i = 0; i < nb_output_streams; i++) {
         float q = -1;
         ost = output_streams[i];
@@ -1696,12 +2043,14 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             vid = 1;
         }
         /* compute min output value */
-        if (av_stream_get_end_pts(ost->st) != AV_NOPTS_VALUE)
-            pts = FFMAX(pts, av_rescale_q(av_stream_get_end_pts(ost->st),
+        get_mux_state(ost, &cur_dts, &end_pts, &nb_frames);
+        if (end_pts != AV_NOPTS_VALUE)
+            pts = FFMAX(pts, av_rescale_q(end_pts,
                                           ost->st->time_base, AV_TIME_BASE_Q));
         if (is_last_report)
             nb_frames_drop += ost->last_dropped;
     }
+    unlock_encoder_state();
 
     secs = FFABS(pts) / AV_TIME_BASE;
     us = FFABS(pts) % AV_TIME_BASE;
@@ -1751,6 +2100,20 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         av_bprintf(&buf_script, "speed=%4.3gx\n", speed);
     }
 
+#if HAVE_PTHREADS
+    for (i = 0, nb_queues = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+        int nb_queued;
+
+        if (!of->mux_thread_queue)
+            continue;
+        nb_queued = av_thread_message_queue_nb_elems(of->mux_thread_queue);
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "%s%d/%d",
+                 nb_queues++ ? "," : " muxq=", nb_queued, of->thread_queue_size);
+        av_bprintf(&buf_script, "out_%d_mux_queue=%d\n", i, nb_queued);
+    }
+#endif
+
     if (print_stats || is_last_report) {
         const char end = is_last_report ? '\n' : '\r';
         if (print_stats==1 && AV_LOG_INFO > av_log_get_level()) {
@@ -1783,6 +2146,14 @@ static void flush_encoders(void)
 {
     int i, ret;
 
+#if HAVE_PTHREADS
+    /* let the encoder threads finish the frames already queued */
+    if (free_encoder_threads() < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Encoding failed\n");
+        exit_program(1);
+    }
+#endif
+
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream   *ost = output_streams[i];
         AVCodecContext *enc = ost->enc_ctx;
@@ -2055,9 +2426,80 @@ static int decode(AVCodecContext *avctx, AVFrame *frame, int *got_frame, AVPacke
     return 0;
 }
 
+/**
+ * Send a decoded frame to all the filtergraph inputs fed by the given input
+ * stream. The filtergraphs running in their own thread process the frame
+ * concurrently, each one with its own reference to it.
+ *
+ * This is a barrier: it returns only once every graph is done with the
+ * frame. The main loop still requests frames from the graphs and reaps
+ * their sinks itself, so the graph threads must be idle when it does.
+ *
+ * @return  0 for success, <0 for error
+ */
+static int send_frame_to_filters(InputStream *ist, AVFrame *decoded_frame)
+{
+    int i, ret, err = 0, nb_sent;
+    AVFrame *f;
+
+    for (i = 0; i < ist->nb_filters; i++) {
+        InputFilter *ifilter = ist->filters[i];
+
+#if HAVE_PTHREADS
+        if (ifilter->graph->in_thread_queue) {
+            FilterGraphMessage msg = { ifilter, av_frame_clone(decoded_frame) };
+
+            if (!msg.frame) {
+                err = AVERROR(ENOMEM);
+                break;
+            }
+            err = av_thread_message_queue_send(ifilter->graph->in_thread_queue, &msg, 0);
+            if (err < 0) {
+                av_frame_free(&msg.frame);
+                break;
+            }
+            continue;
+        }
+#endif
+
+        if (i < ist->nb_filters - 1) {
+            f = ist->filter_frame;
+            err = av_frame_ref(f, decoded_frame);
+            if (err < 0)
+                break;
+        } else
+            f = decoded_frame;
+        err = av_buffersrc_add_frame_flags(ifilter->filter, f,
+                                           AV_BUFFERSRC_FLAG_PUSH);
+        if (err == AVERROR_EOF)
+            err = 0; /* ignore */
+        if (err < 0)
+            break;
+    }
+    nb_sent = i;
+
+    /* wait for the filtergraph threads to be done with the frame */
+    for (i = 0; i < nb_sent; i++) {
+        FilterGraph *fg = ist->filters[i]->graph;
+
+#if HAVE_PTHREADS
+        if (!fg->in_thread_queue)
+            continue;
+        if (av_thread_message_queue_recv(fg->out_thread_queue, &ret, 0) < 0)
+            ret = AVERROR_BUG;
+        if (ret == AVERROR_EOF)
+            ret = 0; /* ignore */
+        if (ret < 0 && err >= 0)
+            err = ret;
+#endif
+    }
+
+    return err;
+}
+
 static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
 {
-    AVFrame *decoded_frame, *f;
+    AVFrame *decoded_frame;
     AVCodecContext *avctx = ist->dec_ctx;
     int i, ret, err = 0, resample_changed;
     AVRational decoded_frame_tb;
@@ -2152,21 +2594,7 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
                                               (AVRational){1, avctx->sample_rate}, decoded_frame->nb_samples, &ist->filter_in_rescale_delta_last,
                                               (AVRational){1, avctx->sample_rate});
     ist->nb_samples = decoded_frame->nb_samples;
-    for (i = 0; i < ist->nb_filters; i++) {
-        if (i < ist->nb_filters - 1) {
-            f = ist->filter_frame;
-            err = av_frame_ref(f, decoded_frame);
-            if (err < 0)
-                break;
-        } else
-            f = decoded_frame;
-        err = av_buffersrc_add_frame_flags(ist->filters[i]->filter, f,
-                                     AV_BUFFERSRC_FLAG_PUSH);
-        if (err == AVERROR_EOF)
-            err = 0; /* ignore */
-        if (err < 0)
-            break;
-    }
+    err = send_frame_to_filters(ist, decoded_frame);
     decoded_frame->pts = AV_NOPTS_VALUE;
 
     av_frame_unref(ist->filter_frame);
@@ -2176,7 +2604,7 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output)
 
 static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int eof)
 {
-    AVFrame *decoded_frame, *f;
+    AVFrame *decoded_frame;
     int i, ret = 0, err = 0, resample_changed;
     int64_t best_effort_timestamp;
     int64_t dts = AV_NOPTS_VALUE;
@@ -2317,25 +2745,14 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int eo
     }
 
     frame_sample_aspect= av_opt_ptr(avcodec_get_frame_class(), decoded_frame, "sample_aspect_ratio");
-    for (i = 0; i < ist->nb_filters; i++) {
-        if (!frame_sample_aspect->num)
-            *frame_sample_aspect = ist->st->sample_aspect_ratio;
+    if (!frame_sample_aspect->num)
+        *frame_sample_aspect = ist->st->sample_aspect_ratio;
 
-        if (i < ist->nb_filters - 1) {
-            f = ist->filter_frame;
-            err = av_frame_ref(f, decoded_frame);
-            if (err < 0)
-                break;
-        } else
-            f = decoded_frame;
-        err = av_buffersrc_add_frame_flags(ist->filters[i]->filter, f, AV_BUFFERSRC_FLAG_PUSH);
-        if (err == AVERROR_EOF) {
-            err = 0; /* ignore */
-        } else if (err < 0) {
-            av_log(NULL, AV_LOG_FATAL,
-                   "Failed to inject frame into filter network: %s\n", av_err2str(err));
-            exit_program(1);
-        }
+    err = send_frame_to_filters(ist, decoded_frame);
+    if (err < 0) {
+        av_log(NULL, AV_LOG_FATAL,
+               "Failed to inject frame into filter network: %s\n", av_err2str(err));
+        exit_program(1);
     }
 
 fail:
@@ -3483,6 +3900,25 @@ static int transcode_init(void)
             goto dump_format;
     }
 
+    /* open the vstats file here, as an encoder thread could not exit on
+     * failure */
+    if (vstats_filename) {
+        for (i = 0; i < nb_output_streams; i++) {
+            ost = output_streams[i];
+            if (ost->encoding_needed && ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
+                break;
+        }
+        if (i < nb_output_streams) {
+            vstats_file = fopen(vstats_filename, "w");
+            if (!vstats_file) {
+                ret = AVERROR(errno);
+                snprintf(error, sizeof(error), "Could not open vstats file '%s': %s",
+                         vstats_filename, av_err2str(ret));
+                goto dump_format;
+            }
+        }
+    }
+
     /* discard unused programs */
     for (i = 0; i < nb_input_files; i++) {
         InputFile *ifile = input_files[i];
@@ -3608,15 +4044,23 @@ static int need_output(void)
 {
     int i;
 
+#if HAVE_PTHREADS
+    check_muxer_errors();
+#endif
+
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost    = output_streams[i];
         OutputFile *of       = output_files[ost->file_index];
         AVFormatContext *os  = output_files[ost->file_index]->ctx;
+        int frame_number;
 
         if (ost->finished ||
-            (os->pb && avio_tell(os->pb) >= of->limit_filesize))
+            (os->pb && output_file_pos(of) >= of->limit_filesize))
             continue;
-        if (ost->frame_number >= ost->max_frames) {
+        lock_encoder_state();
+        frame_number = ost->frame_number;
+        unlock_encoder_state();
+        if (frame_number >= ost->max_frames) {
             int j;
             for (j = 0; j < of->ctx->nb_streams; j++)
                 close_output_stream(output_streams[of->ost_index + j]);
@@ -3642,10 +4086,12 @@ static OutputStream *choose_output(void)
 
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost = output_streams[i];
-        int64_t opts = ost->st->cur_dts == AV_NOPTS_VALUE ? INT64_MIN :
-                       av_rescale_q(ost->st->cur_dts, ost->st->time_base,
-                                    AV_TIME_BASE_Q);
-        if (ost->st->cur_dts == AV_NOPTS_VALUE)
+        int64_t cur_dts, end_pts, nb_frames, opts;
+
+        get_mux_state(ost, &cur_dts, &end_pts, &nb_frames);
+        opts = cur_dts == AV_NOPTS_VALUE ? INT64_MIN :
+               av_rescale_q(cur_dts, ost->st->time_base, AV_TIME_BASE_Q);
+        if (cur_dts == AV_NOPTS_VALUE)
             av_log(NULL, AV_LOG_DEBUG, "cur_dts is invalid (this is harmless if it occurs once at the start per stream)\n");
 
         if (!ost->finished && opts < opts_min) {
@@ -3870,6 +4316,216 @@ static int init_input_threads(void)
     return 0;
 }
 
+/* push the frames sent by send_frame_to_filters() and report the result of
+   each one; the sinks of the graph are reaped by the main thread */
+static void *filtergraph_thread(void *arg)
+{
+    FilterGraph *fg = arg;
+    FilterGraphMessage msg;
+    int ret;
+
+    while (av_thread_message_queue_recv(fg->in_thread_queue, &msg, 0) >= 0) {
+        ret = av_buffersrc_add_frame_flags(msg.ifilter->filter, msg.frame,
+                                           AV_BUFFERSRC_FLAG_PUSH);
+        av_frame_free(&msg.frame);
+        if (av_thread_message_queue_send(fg->out_thread_queue, &ret, 0) < 0)
+            break;
+    }
+
+    return NULL;
+}
+
+static void free_filtergraph_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+
+        if (!fg || !fg->in_thread_queue)
+            continue;
+        av_thread_message_queue_set_err_recv(fg->in_thread_queue, AVERROR_EOF);
+        av_thread_message_queue_set_err_send(fg->out_thread_queue, AVERROR_EOF);
+        pthread_join(fg->thread, NULL);
+        av_thread_message_queue_free(&fg->in_thread_queue);
+        av_thread_message_queue_free(&fg->out_thread_queue);
+    }
+}
+
+static int init_filtergraph_threads(void)
+{
+    int i, ret;
+
+    /* running a single graph in a thread would not gain anything */
+    if (!do_pipeline || nb_filtergraphs < 2)
+        return 0;
+
+    for (i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph *fg = filtergraphs[i];
+
+        ret = av_thread_message_queue_alloc(&fg->in_thread_queue,
+                                            1, sizeof(FilterGraphMessage));
+        if (ret < 0)
+            return ret;
+        /* one result per input of the graph may be pending */
+        ret = av_thread_message_queue_alloc(&fg->out_thread_queue,
+                                            FFMAX(fg->nb_inputs, 1), sizeof(int));
+        if (ret < 0) {
+            av_thread_message_queue_free(&fg->in_thread_queue);
+            return ret;
+        }
+
+        if ((ret = pthread_create(&fg->thread, NULL, filtergraph_thread, fg))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            av_thread_message_queue_free(&fg->in_thread_queue);
+            av_thread_message_queue_free(&fg->out_thread_queue);
+            return AVERROR(ret);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Copy the muxer state the main and encoder threads look at, so that they
+ * do not access the muxer while the muxer thread is running.
+ * Must be called with mux_lock held, or before the muxer thread starts.
+ */
+static void publish_mux_state(OutputFile *of)
+{
+    int i;
+
+    of->mux_size = avio_tell(of->ctx->pb);
+    for (i = 0; i < of->ctx->nb_streams; i++) {
+        OutputStream *ost = output_streams[of->ost_index + i];
+
+        ost->mux_cur_dts   = ost->st->cur_dts;
+        ost->mux_end_pts   = av_stream_get_end_pts(ost->st);
+        ost->mux_nb_frames = ost->st->nb_frames;
+    }
+}
+
+static void *muxer_thread(void *arg)
+{
+    OutputFile *of = arg;
+    AVPacket pkt;
+    int stream_index;
+    int ret;
+
+    while (1) {
+        ret = av_thread_message_queue_recv(of->mux_thread_queue, &pkt, 0);
+        if (ret < 0)
+            break;
+
+        stream_index = pkt.stream_index;
+        ret = av_interleaved_write_frame(of->ctx, &pkt);
+        av_packet_unref(&pkt);
+
+        pthread_mutex_lock(&of->mux_lock);
+        publish_mux_state(of);
+        if (ret < 0) {
+            of->mux_error        = ret;
+            of->mux_error_stream = stream_index;
+        }
+        pthread_mutex_unlock(&of->mux_lock);
+
+        if (ret < 0) {
+            print_error("av_interleaved_write_frame()", ret);
+            av_thread_message_queue_set_err_send(of->mux_thread_queue, ret);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Close the output streams of the files whose muxer thread failed, as
+ * write_packet() does when writing a packet directly fails.
+ */
+static void check_muxer_errors(void)
+{
+    int i, err, stream_index;
+
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+
+        if (!of->mux_thread_queue || of->mux_error_handled)
+            continue;
+
+        pthread_mutex_lock(&of->mux_lock);
+        err          = of->mux_error;
+        stream_index = of->mux_error_stream;
+        pthread_mutex_unlock(&of->mux_lock);
+
+        if (err < 0) {
+            main_return_code = 1;
+            close_all_output_streams(output_streams[of->ost_index + stream_index],
+                                     MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
+            of->mux_error_handled = 1;
+        }
+    }
+}
+
+static void free_mux_packet(void *msg)
+{
+    av_packet_unref(msg);
+}
+
+static void free_output_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+
+        if (!of || !of->mux_thread_queue)
+            continue;
+        av_thread_message_queue_set_err_recv(of->mux_thread_queue, AVERROR_EOF);
+        pthread_join(of->mux_thread, NULL);
+        av_thread_message_queue_free(&of->mux_thread_queue);
+        pthread_mutex_destroy(&of->mux_lock);
+        if (of->mux_error < 0)
+            main_return_code = 1;
+    }
+}
+
+static int init_output_threads(void)
+{
+    int i, ret;
+
+    /* with a single output, the muxer only needs its own thread when
+     * several encoder threads feed it */
+    if (nb_output_files == 1 && !do_pipeline)
+        return 0;
+
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+
+        if (!of->header_written)
+            continue;
+
+        ret = av_thread_message_queue_alloc(&of->mux_thread_queue,
+                                            of->thread_queue_size, sizeof(AVPacket));
+        if (ret < 0)
+            return ret;
+        av_thread_message_queue_set_free_func(of->mux_thread_queue, free_mux_packet);
+
+        if ((ret = pthread_mutex_init(&of->mux_lock, NULL))) {
+            av_thread_message_queue_free(&of->mux_thread_queue);
+            return AVERROR(ret);
+        }
+        publish_mux_state(of);
+
+        if ((ret = pthread_create(&of->mux_thread, NULL, muxer_thread, of))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            av_thread_message_queue_free(&of->mux_thread_queue);
+            pthread_mutex_destroy(&of->mux_lock);
+            return AVERROR(ret);
+        }
+    }
+    return 0;
+}
+
 static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
 {
     return av_thread_message_queue_recv(f->in_thread_queue, pkt,
@@ -4367,6 +5023,12 @@ static int transcode(void)
 #if HAVE_PTHREADS
     if ((ret = init_input_threads()) < 0)
         goto fail;
+    if ((ret = init_output_threads()) < 0)
+        goto fail;
+    if ((ret = init_encoder_threads()) < 0)
+        goto fail;
+    if ((ret = init_filtergraph_threads()) < 0)
+        goto fail;
 #endif
 
     while (!received_sigterm) {
@@ -4408,6 +5070,11 @@ static int transcode(void)
     }
     flush_encoders();
 
+#if HAVE_PTHREADS
+    /* wait for the queued packets to be muxed before writing the trailers */
+    free_output_threads();
+#endif
+
     term_exit();
 
     /* write the trailer if needed and close file */
@@ -4429,6 +5096,8 @@ static int transcode(void)
 
     /* dump report by using the first video and audio streams */
     print_report(1, timer_start, av_gettime_relative());
+    if (do_filter_profile)
+        print_filter_profile();
 
     /* close each encoder */
     for (i = 0; i < nb_output_streams; i++) {
@@ -4462,6 +5131,9 @@ static int transcode(void)
  fail:
 #if HAVE_PTHREADS
     free_input_threads();
+    free_filtergraph_threads();
+    free_encoder_threads();
+    free_output_threads();
 #endif
 
     if (output_streams) {
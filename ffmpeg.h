@@ -214,6 +214,8 @@ typedef struct OptionsContext {
     int        nb_passlogfiles;
     SpecifierOpt *max_muxing_queue_size;
     int        nb_max_muxing_queue_size;
+    SpecifierOpt *enc_queue_size;
+    int        nb_enc_queue_size;
     SpecifierOpt *guess_layout_max;
     int        nb_guess_layout_max;
     SpecifierOpt *apad;
@@ -250,11 +252,18 @@ typedef struct FilterGraph {
 
     AVFilterGraph *graph;
     int reconfiguration;
+    AVFilterFormatsCache *formats_cache; /* negotiated formats of previous configurations */
 
     InputFilter   **inputs;
     int          nb_inputs;
     OutputFilter **outputs;
     int         nb_outputs;
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *in_thread_queue;  /* frames to push into the graph */
+    AVThreadMessageQueue *out_thread_queue; /* results of pushing the frames */
+    pthread_t thread;                       /* thread running the graph */
+#endif
 } FilterGraph;
 
 typedef struct InputStream {
@@ -511,6 +520,19 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+    int enc_queue_size;         /* maximum number of frames queued for the encoder thread */
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *enc_thread_queue;
+    pthread_t enc_thread;       /* thread running the encoder */
+    int enc_thread_ret;         /* error returned by the encoder thread */
+
+    /* muxer state copied by the muxer thread of the file, under its mux_lock */
+    int64_t mux_cur_dts;
+    int64_t mux_end_pts;
+    int64_t mux_nb_frames;
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -524,6 +546,19 @@ typedef struct OutputFile {
     int shortest;
 
     int header_written;
+
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *mux_thread_queue;
+    pthread_t mux_thread;       /* thread writing to this file */
+    int thread_queue_size;      /* maximum number of queued packets */
+    int mux_queue_peak;         /* highest number of queued packets seen */
+
+    pthread_mutex_t mux_lock;   /* protects the state published by the muxer thread */
+    int64_t mux_size;           /* bytes written to the output */
+    int mux_error;              /* error that stopped the muxer thread, or 0 */
+    int mux_error_stream;       /* index of the stream whose packet failed */
+    int mux_error_handled;
+#endif
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -552,6 +587,8 @@ extern int video_sync_method;
 extern float frame_drop_threshold;
 extern int do_benchmark;
 extern int do_benchmark_all;
+extern int do_pipeline;
+extern int do_filter_profile;
 extern int do_deinterlace;
 extern int do_hex_dump;
 extern int do_pkt_dump;
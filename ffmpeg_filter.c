@@ -986,6 +986,13 @@ int configure_filtergraph(FilterGraph *fg)
     avfilter_graph_free(&fg->graph);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    if (do_pipeline)
+        fg->graph->thread_type |= AVFILTER_THREAD_PIPELINE;
+    fg->graph->profile = do_filter_profile;
+    if (!fg->formats_cache &&
+        !(fg->formats_cache = avfilter_formats_cache_alloc()))
+        return AVERROR(ENOMEM);
+    avfilter_graph_set_formats_cache(fg->graph, fg->formats_cache);
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
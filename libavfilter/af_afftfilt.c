@@ -40,6 +40,12 @@ typedef struct AFFTFiltContext {
     int window_size;
     AVExpr **real;
     AVExpr **imag;
+    double *real_gain;
+    double *imag_gain;
+    int *real_per_frame;
+    int *imag_per_frame;
+    int *job_ret;
+    double *bins;
     AVAudioFifo *fifo;
     int64_t pts;
     int hop_size;
@@ -88,6 +94,49 @@ static const AVOption afftfilt_options[] = {
 
 AVFILTER_DEFINE_CLASS(afftfilt);
 
+/* expressions using pts or keeping state must be evaluated for every window */
+static int is_per_frame(AVExpr *e)
+{
+    unsigned counter[VAR_VARS_NB] = { 0 };
+
+    av_expr_count_vars(e, counter, VAR_VARS_NB);
+    return counter[VAR_PTS] > 0 || !av_expr_is_stateless(e);
+}
+
+/* evaluate the gains of channel ch, those of the expressions evaluated for
+ * every window if per_frame is set, the other ones otherwise */
+static int eval_gains(AVFilterContext *ctx, int ch, int per_frame)
+{
+    AVFilterLink *inlink = ctx->inputs[0];
+    AFFTFiltContext *s = ctx->priv;
+    const int nb_bins = s->window_size / 2;
+    const double *arrays[VAR_VARS_NB] = { NULL };
+    double values[VAR_VARS_NB];
+    int ret;
+
+    values[VAR_SAMPLE_RATE] = inlink->sample_rate;
+    values[VAR_BIN]         = 0;
+    values[VAR_NBBINS]      = nb_bins;
+    values[VAR_CHANNEL]     = ch;
+    values[VAR_CHANNELS]    = inlink->channels;
+    values[VAR_PTS]         = s->pts;
+    arrays[VAR_BIN]         = s->bins;
+
+    if (s->real_per_frame[ch] == per_frame) {
+        ret = av_expr_eval_array(s->real[ch], s->real_gain + ch * nb_bins, nb_bins,
+                                 values, arrays, s);
+        if (ret < 0)
+            return ret;
+    }
+    if (s->imag_per_frame[ch] == per_frame) {
+        ret = av_expr_eval_array(s->imag[ch], s->imag_gain + ch * nb_bins, nb_bins,
+                                 values, arrays, s);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static int config_input(AVFilterLink *inlink)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -140,6 +189,8 @@ static int config_input(AVFilterLink *inlink)
     }
 
     av_free(args);
+    if (ret < 0)
+        return ret;
 
     args = av_strdup(s->img_str ? s->img_str : s->real_str);
     if (!args)
@@ -157,6 +208,29 @@ static int config_input(AVFilterLink *inlink)
     }
 
     av_free(args);
+    if (ret < 0)
+        return ret;
+
+    s->bins      = av_malloc_array(s->window_size / 2, sizeof(*s->bins));
+    s->real_gain = av_malloc_array(inlink->channels, s->window_size / 2 * sizeof(*s->real_gain));
+    s->imag_gain = av_malloc_array(inlink->channels, s->window_size / 2 * sizeof(*s->imag_gain));
+    s->real_per_frame = av_calloc(inlink->channels, sizeof(*s->real_per_frame));
+    s->imag_per_frame = av_calloc(inlink->channels, sizeof(*s->imag_per_frame));
+    s->job_ret        = av_calloc(inlink->channels, sizeof(*s->job_ret));
+    if (!s->bins || !s->real_gain || !s->imag_gain ||
+        !s->real_per_frame || !s->imag_per_frame || !s->job_ret)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->window_size / 2; i++)
+        s->bins[i] = i;
+
+    /* the gains of the other expressions are computed only once */
+    for (ch = 0; ch < inlink->channels; ch++) {
+        s->real_per_frame[ch] = is_per_frame(s->real[ch]);
+        s->imag_per_frame[ch] = is_per_frame(s->imag[ch]);
+        if ((ret = eval_gains(ctx, ch, 0)) < 0)
+            return ret;
+    }
 
     s->fifo = av_audio_fifo_alloc(inlink->format, inlink->channels, s->window_size);
     if (!s->fifo)
@@ -185,17 +259,79 @@ static int config_input(AVFilterLink *inlink)
     return ret;
 }
 
+typedef struct ThreadData {
+    AVFrame *in;
+} ThreadData;
+
+static int filter_channel(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    AFFTFiltContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in = td->in;
+    const int channels = ctx->inputs[0]->channels;
+    const int start = (channels * jobnr) / nb_jobs;
+    const int end = (channels * (jobnr+1)) / nb_jobs;
+    const int window_size = s->window_size;
+    const float f = 1. / s->win_scale;
+    int ch, n, i, j, x, ret;
+
+    for (ch = start; ch < end; ch++) {
+        const float *src = (float *)in->extended_data[ch];
+        const double *real_gain = s->real_gain + ch * window_size / 2;
+        const double *imag_gain = s->imag_gain + ch * window_size / 2;
+        FFTComplex *fft_data = s->fft_data[ch];
+        float *buf = (float *)s->buffer->extended_data[ch];
+
+        for (n = 0; n < in->nb_samples; n++) {
+            fft_data[n].re = src[n] * s->window_func_lut[n];
+            fft_data[n].im = 0;
+        }
+
+        for (; n < window_size; n++) {
+            fft_data[n].re = 0;
+            fft_data[n].im = 0;
+        }
+
+        av_fft_permute(s->fft, fft_data);
+        av_fft_calc(s->fft, fft_data);
+
+        if ((ret = eval_gains(ctx, ch, 1)) < 0)
+            return ret;
+
+        for (n = 0; n < window_size / 2; n++) {
+            fft_data[n].re *= (float)real_gain[n];
+            fft_data[n].im *= (float)imag_gain[n];
+        }
+
+        for (n = window_size / 2 + 1, x = window_size / 2 - 1; n < window_size; n++, x--) {
+            fft_data[n].re =  fft_data[x].re;
+            fft_data[n].im = -fft_data[x].im;
+        }
+
+        av_fft_permute(s->ifft, fft_data);
+        av_fft_calc(s->ifft, fft_data);
+
+        for (i = 0, j = s->start; j < s->end && i < window_size; i++, j++) {
+            buf[j] += fft_data[i].re * f;
+        }
+
+        for (; i < window_size; i++, j++) {
+            buf[j] = fft_data[i].re * f;
+        }
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
     AVFilterLink *outlink = ctx->outputs[0];
     AFFTFiltContext *s = ctx->priv;
     const int window_size = s->window_size;
-    const float f = 1. / s->win_scale;
-    double values[VAR_VARS_NB];
     AVFrame *out, *in = NULL;
-    int ch, n, ret, i, j, k;
-    int start = s->start, end = s->end;
+    ThreadData td;
+    int ch, n, nb_jobs, ret = 0;
 
     av_audio_fifo_write(s->fifo, (void **)frame->extended_data, frame->nb_samples);
     av_frame_free(&frame);
@@ -211,82 +347,23 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
         if (ret < 0)
             break;
 
-        for (ch = 0; ch < inlink->channels; ch++) {
-            const float *src = (float *)in->extended_data[ch];
-            FFTComplex *fft_data = s->fft_data[ch];
-
-            for (n = 0; n < in->nb_samples; n++) {
-                fft_data[n].re = src[n] * s->window_func_lut[n];
-                fft_data[n].im = 0;
-            }
-
-            for (; n < window_size; n++) {
-                fft_data[n].re = 0;
-                fft_data[n].im = 0;
-            }
-        }
-
-        values[VAR_PTS]         = s->pts;
-        values[VAR_SAMPLE_RATE] = inlink->sample_rate;
-        values[VAR_NBBINS]      = window_size / 2;
-        values[VAR_CHANNELS]    = inlink->channels;
-
-        for (ch = 0; ch < inlink->channels; ch++) {
-            FFTComplex *fft_data = s->fft_data[ch];
-            float *buf = (float *)s->buffer->extended_data[ch];
-            int x;
-
-            values[VAR_CHANNEL] = ch;
-
-            av_fft_permute(s->fft, fft_data);
-            av_fft_calc(s->fft, fft_data);
-
-            for (n = 0; n < window_size / 2; n++) {
-                float fr, fi;
-
-                values[VAR_BIN] = n;
-
-                fr = av_expr_eval(s->real[ch], values, s);
-                fi = av_expr_eval(s->imag[ch], values, s);
-
-                fft_data[n].re *= fr;
-                fft_data[n].im *= fi;
-            }
-
-            for (n = window_size / 2 + 1, x = window_size / 2 - 1; n < window_size; n++, x--) {
-                fft_data[n].re =  fft_data[x].re;
-                fft_data[n].im = -fft_data[x].im;
-            }
-
-            av_fft_permute(s->ifft, fft_data);
-            av_fft_calc(s->ifft, fft_data);
-
-            start = s->start;
-            end = s->end;
-            k = end;
-            for (i = 0, j = start; j < k && i < window_size; i++, j++) {
-                buf[j] += s->fft_data[ch][i].re * f;
-            }
-
-            for (; i < window_size; i++, j++) {
-                buf[j] = s->fft_data[ch][i].re * f;
-            }
-
-            start += s->hop_size;
-            end = j;
-        }
+        td.in = in;
+        nb_jobs = FFMIN(inlink->channels, ff_filter_get_nb_threads(ctx));
+        ctx->internal->execute(ctx, filter_channel, &td, s->job_ret, nb_jobs);
+        for (n = 0; n < nb_jobs; n++)
+            if (s->job_ret[n] < 0)
+                ret = s->job_ret[n];
+        if (ret < 0)
+            break;
 
-        s->start = start;
-        s->end = end;
+        s->end    = s->start + window_size;
+        s->start += s->hop_size;
 
-        if (start >= window_size) {
+        if (s->start >= window_size) {
             float *dst, *buf;
 
-            start -= window_size;
-            end   -= window_size;
-
-            s->start = start;
-            s->end = end;
+            s->start -= window_size;
+            s->end   -= window_size;
 
             out = ff_get_audio_buffer(outlink, window_size);
             if (!out) {
@@ -370,6 +447,12 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     av_freep(&s->real);
     av_freep(&s->imag);
+    av_freep(&s->real_gain);
+    av_freep(&s->imag_gain);
+    av_freep(&s->real_per_frame);
+    av_freep(&s->imag_per_frame);
+    av_freep(&s->job_ret);
+    av_freep(&s->bins);
     av_frame_free(&s->buffer);
 }
 
@@ -400,4 +483,5 @@ AVFilter ff_af_afftfilt = {
     .outputs         = outputs,
     .query_formats   = query_formats,
     .uninit          = uninit,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -34,7 +34,6 @@
 #include "libavutil/avstring.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/common.h"
-#include "libavutil/float_dsp.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/samplefmt.h"
@@ -55,11 +54,10 @@
 typedef struct FrameInfo {
     int nb_samples;
     int64_t pts;
-    struct FrameInfo *next;
 } FrameInfo;
 
 /**
- * Linked list used to store timestamps and frame sizes of all frames in the
+ * Ring buffer used to store timestamps and frame sizes of all frames in the
  * FIFO for the first input.
  *
  * This is needed to keep timestamps synchronized for the case where multiple
@@ -69,36 +67,45 @@ typedef struct FrameInfo {
 typedef struct FrameList {
     int nb_frames;
     int nb_samples;
-    FrameInfo *list;
-    FrameInfo *end;
+    FrameInfo *frames;          /**< allocated entries, grown when full */
+    int size;                   /**< number of allocated entries */
+    int first;                  /**< index of the oldest entry */
 } FrameList;
 
+#define FRAME_LIST_SIZE 32
+
+#define MAX_INPUTS 32
+
+static int frame_list_init(FrameList *frame_list)
+{
+    frame_list->frames = av_malloc_array(FRAME_LIST_SIZE, sizeof(*frame_list->frames));
+    if (!frame_list->frames)
+        return AVERROR(ENOMEM);
+    frame_list->size = FRAME_LIST_SIZE;
+    return 0;
+}
+
 static void frame_list_clear(FrameList *frame_list)
 {
     if (frame_list) {
-        while (frame_list->list) {
-            FrameInfo *info = frame_list->list;
-            frame_list->list = info->next;
-            av_free(info);
-        }
         frame_list->nb_frames  = 0;
         frame_list->nb_samples = 0;
-        frame_list->end        = NULL;
+        frame_list->first      = 0;
     }
 }
 
 static int frame_list_next_frame_size(FrameList *frame_list)
 {
-    if (!frame_list->list)
+    if (!frame_list->nb_frames)
         return 0;
-    return frame_list->list->nb_samples;
+    return frame_list->frames[frame_list->first].nb_samples;
 }
 
 static int64_t frame_list_next_pts(FrameList *frame_list)
 {
-    if (!frame_list->list)
+    if (!frame_list->nb_frames)
         return AV_NOPTS_VALUE;
-    return frame_list->list->pts;
+    return frame_list->frames[frame_list->first].pts;
 }
 
 static void frame_list_remove_samples(FrameList *frame_list, int nb_samples)
@@ -108,16 +115,13 @@ static void frame_list_remove_samples(FrameList *frame_list, int nb_samples)
     } else {
         int samples = nb_samples;
         while (samples > 0) {
-            FrameInfo *info = frame_list->list;
-            av_assert0(info);
+            FrameInfo *info = &frame_list->frames[frame_list->first];
+            av_assert0(frame_list->nb_frames);
             if (info->nb_samples <= samples) {
                 samples -= info->nb_samples;
-                frame_list->list = info->next;
-                if (!frame_list->list)
-                    frame_list->end = NULL;
+                frame_list->first = (frame_list->first + 1) % frame_list->size;
                 frame_list->nb_frames--;
                 frame_list->nb_samples -= info->nb_samples;
-                av_free(info);
             } else {
                 info->nb_samples       -= samples;
                 info->pts              += samples;
@@ -130,21 +134,26 @@ static void frame_list_remove_samples(FrameList *frame_list, int nb_samples)
 
 static int frame_list_add_frame(FrameList *frame_list, int nb_samples, int64_t pts)
 {
-    FrameInfo *info = av_malloc(sizeof(*info));
-    if (!info)
-        return AVERROR(ENOMEM);
-    info->nb_samples = nb_samples;
-    info->pts        = pts;
-    info->next       = NULL;
+    FrameInfo *info;
 
-    if (!frame_list->list) {
-        frame_list->list = info;
-        frame_list->end  = info;
-    } else {
-        av_assert0(frame_list->end);
-        frame_list->end->next = info;
-        frame_list->end       = info;
+    if (frame_list->nb_frames == frame_list->size) {
+        int size = frame_list->size * 2;
+        FrameInfo *frames = av_malloc_array(size, sizeof(*frames));
+        int n = frame_list->size - frame_list->first;
+
+        if (!frames)
+            return AVERROR(ENOMEM);
+        memcpy(frames, frame_list->frames + frame_list->first, n * sizeof(*frames));
+        memcpy(frames + n, frame_list->frames, frame_list->first * sizeof(*frames));
+        av_free(frame_list->frames);
+        frame_list->frames = frames;
+        frame_list->size   = size;
+        frame_list->first  = 0;
     }
+
+    info = &frame_list->frames[(frame_list->first + frame_list->nb_frames) % frame_list->size];
+    info->nb_samples = nb_samples;
+    info->pts        = pts;
     frame_list->nb_frames++;
     frame_list->nb_samples += nb_samples;
 
@@ -154,7 +163,6 @@ static int frame_list_add_frame(FrameList *frame_list, int nb_samples, int64_t p
 
 typedef struct MixContext {
     const AVClass *class;       /**< class for AVOptions */
-    AVFloatDSPContext *fdsp;
 
     int nb_inputs;              /**< number of inputs */
     int active_inputs;          /**< number of input currently active */
@@ -170,6 +178,9 @@ typedef struct MixContext {
     float scale_norm;           /**< normalization factor for all inputs */
     int64_t next_pts;           /**< calculated pts for next output frame */
     FrameList *frame_list;      /**< list of frame info for the first input */
+    AVFrame **in_bufs;          /**< samples read from the active inputs */
+    float *gains;               /**< mixing scale factors of the active inputs */
+    int *frame_sizes;           /**< size of the last frame of each input */
 } MixContext;
 
 #define OFFSET(x) offsetof(MixContext, x)
@@ -177,7 +188,7 @@ typedef struct MixContext {
 #define F AV_OPT_FLAG_FILTERING_PARAM
 static const AVOption amix_options[] = {
     { "inputs", "Number of inputs.",
-            OFFSET(nb_inputs), AV_OPT_TYPE_INT, { .i64 = 2 }, 1, 32, A|F },
+            OFFSET(nb_inputs), AV_OPT_TYPE_INT, { .i64 = 2 }, 1, MAX_INPUTS, A|F },
     { "duration", "How to determine the end-of-stream.",
             OFFSET(duration_mode), AV_OPT_TYPE_INT, { .i64 = DURATION_LONGEST }, 0,  2, A|F, "duration" },
         { "longest",  "Duration of longest input.",  0, AV_OPT_TYPE_CONST, { .i64 = DURATION_LONGEST  }, INT_MIN, INT_MAX, A|F, "duration" },
@@ -228,7 +239,7 @@ static int config_output(AVFilterLink *outlink)
     s->next_pts        = AV_NOPTS_VALUE;
 
     s->frame_list = av_mallocz(sizeof(*s->frame_list));
-    if (!s->frame_list)
+    if (!s->frame_list || frame_list_init(s->frame_list) < 0)
         return AVERROR(ENOMEM);
 
     s->fifos = av_mallocz_array(s->nb_inputs, sizeof(*s->fifos));
@@ -249,7 +260,10 @@ static int config_output(AVFilterLink *outlink)
     s->active_inputs = s->nb_inputs;
 
     s->input_scale = av_mallocz_array(s->nb_inputs, sizeof(*s->input_scale));
-    if (!s->input_scale)
+    s->in_bufs     = av_mallocz_array(s->nb_inputs, sizeof(*s->in_bufs));
+    s->gains       = av_mallocz_array(s->nb_inputs, sizeof(*s->gains));
+    s->frame_sizes = av_mallocz_array(s->nb_inputs, sizeof(*s->frame_sizes));
+    if (!s->input_scale || !s->in_bufs || !s->gains || !s->frame_sizes)
         return AVERROR(ENOMEM);
     s->scale_norm = s->active_inputs;
     calculate_scales(s, 0);
@@ -265,6 +279,49 @@ static int config_output(AVFilterLink *outlink)
 
 static int calc_active_inputs(MixContext *s);
 
+/* Mix nb_inputs planes of len samples, a multiple of 16, in one pass over
+ * the output. The products are summed in input order. */
+static void mix(float *dst, const float **src, const float *gain,
+                int nb_inputs, int len)
+{
+    int i, j, k;
+
+    for (i = 0; i < len; i += 16) {
+        float sum[16] = { 0.0f };
+
+        for (k = 0; k < nb_inputs; k++)
+            for (j = 0; j < 16; j++)
+                sum[j] += src[k][i + j] * gain[k];
+        memcpy(dst + i, sum, sizeof(sum));
+    }
+}
+
+typedef struct ThreadData {
+    AVFrame *out;
+    int nb_active;
+    int plane_size;
+} ThreadData;
+
+static int mix_planes(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MixContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int planes = s->planar ? s->nb_channels : 1;
+    const int start = (planes * jobnr) / nb_jobs;
+    const int end = (planes * (jobnr+1)) / nb_jobs;
+    const float *src[MAX_INPUTS];
+    int i, p;
+
+    for (p = start; p < end; p++) {
+        for (i = 0; i < td->nb_active; i++)
+            src[i] = (const float *)s->in_bufs[i]->extended_data[p];
+        mix((float *)td->out->extended_data[p], src, s->gains,
+            td->nb_active, td->plane_size);
+    }
+
+    return 0;
+}
+
 /**
  * Read samples from the input FIFOs, mix, and write to the output link.
  */
@@ -272,8 +329,9 @@ static int output_frame(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
     MixContext      *s = ctx->priv;
-    AVFrame *out_buf, *in_buf;
-    int nb_samples, ns, ret, i;
+    AVFrame *out_buf;
+    ThreadData td;
+    int nb_samples, ns, ret, i, planes;
 
     ret = calc_active_inputs(s);
     if (ret < 0)
@@ -319,31 +377,39 @@ static int output_frame(AVFilterLink *outlink)
     if (!out_buf)
         return AVERROR(ENOMEM);
 
-    in_buf = ff_get_audio_buffer(outlink, nb_samples);
-    if (!in_buf) {
-        av_frame_free(&out_buf);
-        return AVERROR(ENOMEM);
-    }
+    td.out        = out_buf;
+    td.nb_active  = 0;
+    td.plane_size = FFALIGN(nb_samples * (s->planar ? 1 : s->nb_channels), 16);
 
     for (i = 0; i < s->nb_inputs; i++) {
         if (s->input_state[i] & INPUT_ON) {
-            int planes, plane_size, p;
+            AVFrame *in_buf = ff_get_audio_buffer(outlink, nb_samples);
 
+            if (!in_buf) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
             av_audio_fifo_read(s->fifos[i], (void **)in_buf->extended_data,
                                nb_samples);
+            s->in_bufs[td.nb_active] = in_buf;
+            s->gains[td.nb_active++] = s->input_scale[i];
+        }
+    }
 
-            planes     = s->planar ? s->nb_channels : 1;
-            plane_size = nb_samples * (s->planar ? 1 : s->nb_channels);
-            plane_size = FFALIGN(plane_size, 16);
+    if (td.nb_active) {
+        planes = s->planar ? s->nb_channels : 1;
+        ctx->internal->execute(ctx, mix_planes, &td, NULL,
+                               FFMIN(planes, ff_filter_get_nb_threads(ctx)));
+    }
+    ret = 0;
 
-            for (p = 0; p < planes; p++) {
-                s->fdsp->vector_fmac_scalar((float *)out_buf->extended_data[p],
-                                           (float *) in_buf->extended_data[p],
-                                           s->input_scale[i], plane_size);
-            }
-        }
+end:
+    for (i = 0; i < td.nb_active; i++)
+        av_frame_free(&s->in_bufs[i]);
+    if (ret < 0) {
+        av_frame_free(&out_buf);
+        return ret;
     }
-    av_frame_free(&in_buf);
 
     out_buf->pts = s->next_pts;
     if (s->next_pts != AV_NOPTS_VALUE)
@@ -457,6 +523,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *buf)
             goto fail;
     }
 
+    s->frame_sizes[i] = buf->nb_samples;
     ret = av_audio_fifo_write(s->fifos[i], (void **)buf->extended_data,
                               buf->nb_samples);
 
@@ -469,6 +536,40 @@ fail:
     return ret;
 }
 
+/**
+ * Tell if the samples buffered from an input reach the queue limits of its
+ * link, while no more of them are needed to output the next frame.
+ */
+static int hold_input(void *opaque, unsigned in)
+{
+    AVFilterContext *ctx = opaque;
+    MixContext      *s = ctx->priv;
+    int wanted, samples;
+
+    if (!s->fifos || !s->frame_sizes[in])
+        return 0;
+    samples = av_audio_fifo_size(s->fifos[in]);
+    if (in == 0) {
+        /* the first input is requested once its frames are all mixed */
+        if (!s->frame_list->nb_frames)
+            return 0;
+        wanted = 0;
+    } else {
+        wanted = s->frame_list->nb_frames ?
+                 frame_list_next_frame_size(s->frame_list) : 1;
+    }
+    if (samples < wanted)
+        return 0;
+    return ff_link_queue_limit_reached(ctx->inputs[in],
+                                       (samples + s->frame_sizes[in] - 1) / s->frame_sizes[in],
+                                       (uint64_t)samples * s->nb_channels * sizeof(float));
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    return ff_filter_activate_default_hold(ctx, hold_input, ctx);
+}
+
 static av_cold int init(AVFilterContext *ctx)
 {
     MixContext *s = ctx->priv;
@@ -488,10 +589,6 @@ static av_cold int init(AVFilterContext *ctx)
         ff_insert_inpad(ctx, i, &pad);
     }
 
-    s->fdsp = avpriv_float_dsp_alloc(0);
-    if (!s->fdsp)
-        return AVERROR(ENOMEM);
-
     return 0;
 }
 
@@ -505,11 +602,14 @@ static av_cold void uninit(AVFilterContext *ctx)
             av_audio_fifo_free(s->fifos[i]);
         av_freep(&s->fifos);
     }
-    frame_list_clear(s->frame_list);
+    if (s->frame_list)
+        av_freep(&s->frame_list->frames);
     av_freep(&s->frame_list);
     av_freep(&s->input_state);
     av_freep(&s->input_scale);
-    av_freep(&s->fdsp);
+    av_freep(&s->in_bufs);
+    av_freep(&s->gains);
+    av_freep(&s->frame_sizes);
 
     for (i = 0; i < ctx->nb_inputs; i++)
         av_freep(&ctx->input_pads[i].name);
@@ -559,7 +659,9 @@ AVFilter ff_af_amix = {
     .init           = init,
     .uninit         = uninit,
     .query_formats  = query_formats,
+    .activate       = activate,
     .inputs         = NULL,
     .outputs        = avfilter_af_amix_outputs,
-    .flags          = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags          = AVFILTER_FLAG_DYNAMIC_INPUTS |
+                      AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -63,6 +63,8 @@
  */
 
 #include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "audio.h"
 #include "avfilter.h"
@@ -94,6 +96,14 @@ typedef struct ChanCache {
     double o1, o2;
 } ChanCache;
 
+typedef struct Section {
+    double frequency;
+    double width;
+    double gain;
+    double a1, a2;
+    double b0, b1, b2;
+} Section;
+
 typedef struct BiquadsContext {
     const AVClass *class;
 
@@ -109,14 +119,88 @@ typedef struct BiquadsContext {
     double a0, a1, a2;
     double b0, b1, b2;
 
-    ChanCache *cache;
+    char *sections_str;
+    Section *sections;              ///< this filter followed by the cascaded sections
+    int nb_sections;
+
+    ChanCache *cache;               ///< nb_sections * channels entries
     int clippings;
 
     void (*filter)(struct BiquadsContext *s, const void *ibuf, void *obuf, int len,
                    double *i1, double *i2, double *o1, double *o2,
                    double b0, double b1, double b2, double a1, double a2);
+    void (*filter2)(uint8_t **dst, uint8_t **src, ChanCache *cache,
+                    const Section *sec, int len);
 } BiquadsContext;
 
+static int parse_sections(AVFilterContext *ctx)
+{
+    BiquadsContext *s = ctx->priv;
+    char *args, *arg, *saveptr = NULL;
+    int i, ret = 0;
+
+    /* one more than the number of separators, plus this filter */
+    s->nb_sections = 1;
+    if (s->sections_str) {
+        s->nb_sections++;
+        for (i = 0; s->sections_str[i]; i++)
+            s->nb_sections += s->sections_str[i] == '|';
+    }
+
+    s->sections = av_calloc(s->nb_sections, sizeof(*s->sections));
+    if (!s->sections)
+        return AVERROR(ENOMEM);
+    s->sections[0].frequency = s->frequency;
+    s->sections[0].width     = s->width;
+    s->sections[0].gain      = s->gain;
+    s->nb_sections = 1;
+
+    if (!s->sections_str)
+        return 0;
+    args = av_strdup(s->sections_str);
+    if (!args)
+        return AVERROR(ENOMEM);
+
+    while ((arg = av_strtok(s->nb_sections == 1 ? args : NULL, "|", &saveptr))) {
+        Section *sec = &s->sections[s->nb_sections];
+        char *tok, *saveptr2 = NULL;
+
+        sec->frequency = s->frequency;
+        sec->width     = s->width;
+        sec->gain      = s->gain;
+
+        for (tok = av_strtok(arg, " ", &saveptr2); tok; tok = av_strtok(NULL, " ", &saveptr2)) {
+            double val;
+            char key;
+            int len = 0;
+
+            if (sscanf(tok, "%c=%lf%n", &key, &val, &len) != 2 || tok[len])
+                key = 0;
+            switch (key) {
+            case 'f': sec->frequency = val; break;
+            case 'w': sec->width     = val; break;
+            case 'g': sec->gain      = val; break;
+            default:
+                av_log(ctx, AV_LOG_ERROR, "Invalid section parameter '%s'\n", tok);
+                ret = AVERROR(EINVAL);
+                goto end;
+            }
+        }
+
+        if (sec->frequency <= 0 || sec->width <= 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid frequency %f and/or width %f <= 0 in section %d\n",
+                   sec->frequency, sec->width, s->nb_sections);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+        s->nb_sections++;
+    }
+
+end:
+    av_free(args);
+    return ret;
+}
+
 static av_cold int init(AVFilterContext *ctx)
 {
     BiquadsContext *s = ctx->priv;
@@ -129,7 +213,7 @@ static av_cold int init(AVFilterContext *ctx)
         }
     }
 
-    return 0;
+    return parse_sections(ctx);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -235,19 +319,63 @@ BIQUAD_FILTER(s32, int32_t, INT32_MIN, INT32_MAX, 1)
 BIQUAD_FILTER(flt, float,   -1., 1., 0)
 BIQUAD_FILTER(dbl, double,  -1., 1., 0)
 
-static int config_output(AVFilterLink *outlink)
+/* Two channels at once, with the same operation order as BIQUAD_FILTER(). */
+#define BIQUAD_FILTER2(name, type)                                            \
+static void biquad2_## name(uint8_t **dst, uint8_t **src,                     \
+                            ChanCache *cache, const Section *sec, int len)    \
+{                                                                             \
+    const type *ibuf0 = (const type *)src[0];                                 \
+    const type *ibuf1 = (const type *)src[1];                                 \
+    type *obuf0 = (type *)dst[0];                                             \
+    type *obuf1 = (type *)dst[1];                                             \
+    const double b0 = sec->b0, b1 = sec->b1, b2 = sec->b2;                    \
+    const double a1 = -sec->a1, a2 = -sec->a2;                                \
+    double i1a = cache[0].i1, i2a = cache[0].i2;                              \
+    double o1a = cache[0].o1, o2a = cache[0].o2;                              \
+    double i1b = cache[1].i1, i2b = cache[1].i2;                              \
+    double o1b = cache[1].o1, o2b = cache[1].o2;                              \
+    int i;                                                                    \
+                                                                              \
+    for (i = 0; i < (len & ~1); i++) {                                        \
+        const double xa = ibuf0[i], xb = ibuf1[i];                            \
+        const double ya = i2a * b2 + i1a * b1 + xa * b0 + o2a * a2 + o1a * a1; \
+        const double yb = i2b * b2 + i1b * b1 + xb * b0 + o2b * a2 + o1b * a1; \
+        obuf0[i] = ya;                                                        \
+        obuf1[i] = yb;                                                        \
+        i2a = i1a; i1a = xa; o2a = o1a; o1a = ya;                             \
+        i2b = i1b; i1b = xb; o2b = o1b; o1b = yb;                             \
+    }                                                                         \
+    if (i < len) {                                                            \
+        const double xa = ibuf0[i], xb = ibuf1[i];                            \
+        const double ya = xa * b0 + i1a * b1 + i2a * b2 + o1a * a1 + o2a * a2; \
+        const double yb = xb * b0 + i1b * b1 + i2b * b2 + o1b * a1 + o2b * a2; \
+        obuf0[i] = ya;                                                        \
+        obuf1[i] = yb;                                                        \
+        i2a = i1a; i1a = xa; o2a = o1a; o1a = ya;                             \
+        i2b = i1b; i1b = xb; o2b = o1b; o1b = yb;                             \
+    }                                                                         \
+    cache[0].i1 = i1a; cache[0].i2 = i2a;                                     \
+    cache[0].o1 = o1a; cache[0].o2 = o2a;                                     \
+    cache[1].i1 = i1b; cache[1].i2 = i2b;                                     \
+    cache[1].o1 = o1b; cache[1].o2 = o2b;                                     \
+}
+
+BIQUAD_FILTER2(flt, float)
+BIQUAD_FILTER2(dbl, double)
+
+static int calc_coefs(AVFilterContext *ctx, Section *sec, int sample_rate)
 {
-    AVFilterContext *ctx    = outlink->src;
-    BiquadsContext *s       = ctx->priv;
-    AVFilterLink *inlink    = ctx->inputs[0];
-    double A = exp(s->gain / 40 * log(10.));
-    double w0 = 2 * M_PI * s->frequency / inlink->sample_rate;
+    BiquadsContext *s = ctx->priv;
+    double A = exp(sec->gain / 40 * log(10.));
+    double w0 = 2 * M_PI * sec->frequency / sample_rate;
     double alpha;
+    double a0 = 1, a1 = 0, a2 = 0;
+    double b0 = 1, b1 = 0, b2 = 0;
 
     if (w0 > M_PI) {
         av_log(ctx, AV_LOG_ERROR,
                "Invalid frequency %f. Frequency must be less than half the sample-rate %d.\n",
-               s->frequency, inlink->sample_rate);
+               sec->frequency, sample_rate);
         return AVERROR(EINVAL);
     }
 
@@ -256,16 +384,16 @@ static int config_output(AVFilterLink *outlink)
         alpha = 0.0;
         break;
     case HERTZ:
-        alpha = sin(w0) / (2 * s->frequency / s->width);
+        alpha = sin(w0) / (2 * sec->frequency / sec->width);
         break;
     case OCTAVE:
-        alpha = sin(w0) * sinh(log(2.) / 2 * s->width * w0 / sin(w0));
+        alpha = sin(w0) * sinh(log(2.) / 2 * sec->width * w0 / sin(w0));
         break;
     case QFACTOR:
-        alpha = sin(w0) / (2 * s->width);
+        alpha = sin(w0) / (2 * sec->width);
         break;
     case SLOPE:
-        alpha = sin(w0) / 2 * sqrt((A + 1 / A) * (1 / s->width - 1) + 2);
+        alpha = sin(w0) / 2 * sqrt((A + 1 / A) * (1 / sec->width - 1) + 2);
         break;
     default:
         av_assert0(0);
@@ -273,118 +401,142 @@ static int config_output(AVFilterLink *outlink)
 
     switch (s->filter_type) {
     case biquad:
+        a0 = s->a0;
+        a1 = s->a1;
+        a2 = s->a2;
+        b0 = s->b0;
+        b1 = s->b1;
+        b2 = s->b2;
         break;
     case equalizer:
-        s->a0 =   1 + alpha / A;
-        s->a1 =  -2 * cos(w0);
-        s->a2 =   1 - alpha / A;
-        s->b0 =   1 + alpha * A;
-        s->b1 =  -2 * cos(w0);
-        s->b2 =   1 - alpha * A;
+        a0 =   1 + alpha / A;
+        a1 =  -2 * cos(w0);
+        a2 =   1 - alpha / A;
+        b0 =   1 + alpha * A;
+        b1 =  -2 * cos(w0);
+        b2 =   1 - alpha * A;
         break;
     case bass:
-        s->a0 =          (A + 1) + (A - 1) * cos(w0) + 2 * sqrt(A) * alpha;
-        s->a1 =    -2 * ((A - 1) + (A + 1) * cos(w0));
-        s->a2 =          (A + 1) + (A - 1) * cos(w0) - 2 * sqrt(A) * alpha;
-        s->b0 =     A * ((A + 1) - (A - 1) * cos(w0) + 2 * sqrt(A) * alpha);
-        s->b1 = 2 * A * ((A - 1) - (A + 1) * cos(w0));
-        s->b2 =     A * ((A + 1) - (A - 1) * cos(w0) - 2 * sqrt(A) * alpha);
+        a0 =          (A + 1) + (A - 1) * cos(w0) + 2 * sqrt(A) * alpha;
+        a1 =    -2 * ((A - 1) + (A + 1) * cos(w0));
+        a2 =          (A + 1) + (A - 1) * cos(w0) - 2 * sqrt(A) * alpha;
+        b0 =     A * ((A + 1) - (A - 1) * cos(w0) + 2 * sqrt(A) * alpha);
+        b1 = 2 * A * ((A - 1) - (A + 1) * cos(w0));
+        b2 =     A * ((A + 1) - (A - 1) * cos(w0) - 2 * sqrt(A) * alpha);
         break;
     case treble:
-        s->a0 =          (A + 1) - (A - 1) * cos(w0) + 2 * sqrt(A) * alpha;
-        s->a1 =     2 * ((A - 1) - (A + 1) * cos(w0));
-        s->a2 =          (A + 1) - (A - 1) * cos(w0) - 2 * sqrt(A) * alpha;
-        s->b0 =     A * ((A + 1) + (A - 1) * cos(w0) + 2 * sqrt(A) * alpha);
-        s->b1 =-2 * A * ((A - 1) + (A + 1) * cos(w0));
-        s->b2 =     A * ((A + 1) + (A - 1) * cos(w0) - 2 * sqrt(A) * alpha);
+        a0 =          (A + 1) - (A - 1) * cos(w0) + 2 * sqrt(A) * alpha;
+        a1 =     2 * ((A - 1) - (A + 1) * cos(w0));
+        a2 =          (A + 1) - (A - 1) * cos(w0) - 2 * sqrt(A) * alpha;
+        b0 =     A * ((A + 1) + (A - 1) * cos(w0) + 2 * sqrt(A) * alpha);
+        b1 =-2 * A * ((A - 1) + (A + 1) * cos(w0));
+        b2 =     A * ((A + 1) + (A - 1) * cos(w0) - 2 * sqrt(A) * alpha);
         break;
     case bandpass:
         if (s->csg) {
-            s->a0 =  1 + alpha;
-            s->a1 = -2 * cos(w0);
-            s->a2 =  1 - alpha;
-            s->b0 =  sin(w0) / 2;
-            s->b1 =  0;
-            s->b2 = -sin(w0) / 2;
+            a0 =  1 + alpha;
+            a1 = -2 * cos(w0);
+            a2 =  1 - alpha;
+            b0 =  sin(w0) / 2;
+            b1 =  0;
+            b2 = -sin(w0) / 2;
         } else {
-            s->a0 =  1 + alpha;
-            s->a1 = -2 * cos(w0);
-            s->a2 =  1 - alpha;
-            s->b0 =  alpha;
-            s->b1 =  0;
-            s->b2 = -alpha;
+            a0 =  1 + alpha;
+            a1 = -2 * cos(w0);
+            a2 =  1 - alpha;
+            b0 =  alpha;
+            b1 =  0;
+            b2 = -alpha;
         }
         break;
     case bandreject:
-        s->a0 =  1 + alpha;
-        s->a1 = -2 * cos(w0);
-        s->a2 =  1 - alpha;
-        s->b0 =  1;
-        s->b1 = -2 * cos(w0);
-        s->b2 =  1;
+        a0 =  1 + alpha;
+        a1 = -2 * cos(w0);
+        a2 =  1 - alpha;
+        b0 =  1;
+        b1 = -2 * cos(w0);
+        b2 =  1;
         break;
     case lowpass:
         if (s->poles == 1) {
-            s->a0 = 1;
-            s->a1 = -exp(-w0);
-            s->a2 = 0;
-            s->b0 = 1 + s->a1;
-            s->b1 = 0;
-            s->b2 = 0;
+            a0 = 1;
+            a1 = -exp(-w0);
+            a2 = 0;
+            b0 = 1 + a1;
+            b1 = 0;
+            b2 = 0;
         } else {
-            s->a0 =  1 + alpha;
-            s->a1 = -2 * cos(w0);
-            s->a2 =  1 - alpha;
-            s->b0 = (1 - cos(w0)) / 2;
-            s->b1 =  1 - cos(w0);
-            s->b2 = (1 - cos(w0)) / 2;
+            a0 =  1 + alpha;
+            a1 = -2 * cos(w0);
+            a2 =  1 - alpha;
+            b0 = (1 - cos(w0)) / 2;
+            b1 =  1 - cos(w0);
+            b2 = (1 - cos(w0)) / 2;
         }
         break;
     case highpass:
         if (s->poles == 1) {
-            s->a0 = 1;
-            s->a1 = -exp(-w0);
-            s->a2 = 0;
-            s->b0 = (1 - s->a1) / 2;
-            s->b1 = -s->b0;
-            s->b2 = 0;
+            a0 = 1;
+            a1 = -exp(-w0);
+            a2 = 0;
+            b0 = (1 - a1) / 2;
+            b1 = -b0;
+            b2 = 0;
         } else {
-            s->a0 =   1 + alpha;
-            s->a1 =  -2 * cos(w0);
-            s->a2 =   1 - alpha;
-            s->b0 =  (1 + cos(w0)) / 2;
-            s->b1 = -(1 + cos(w0));
-            s->b2 =  (1 + cos(w0)) / 2;
+            a0 =   1 + alpha;
+            a1 =  -2 * cos(w0);
+            a2 =   1 - alpha;
+            b0 =  (1 + cos(w0)) / 2;
+            b1 = -(1 + cos(w0));
+            b2 =  (1 + cos(w0)) / 2;
         }
         break;
     case allpass:
-        s->a0 =  1 + alpha;
-        s->a1 = -2 * cos(w0);
-        s->a2 =  1 - alpha;
-        s->b0 =  1 - alpha;
-        s->b1 = -2 * cos(w0);
-        s->b2 =  1 + alpha;
+        a0 =  1 + alpha;
+        a1 = -2 * cos(w0);
+        a2 =  1 - alpha;
+        b0 =  1 - alpha;
+        b1 = -2 * cos(w0);
+        b2 =  1 + alpha;
         break;
     default:
         av_assert0(0);
     }
 
-    s->a1 /= s->a0;
-    s->a2 /= s->a0;
-    s->b0 /= s->a0;
-    s->b1 /= s->a0;
-    s->b2 /= s->a0;
+    sec->a1 = a1 / a0;
+    sec->a2 = a2 / a0;
+    sec->b0 = b0 / a0;
+    sec->b1 = b1 / a0;
+    sec->b2 = b2 / a0;
+
+    return 0;
+}
 
-    s->cache = av_realloc_f(s->cache, sizeof(ChanCache), inlink->channels);
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx    = outlink->src;
+    BiquadsContext *s       = ctx->priv;
+    AVFilterLink *inlink    = ctx->inputs[0];
+    int i, ret;
+
+    for (i = 0; i < s->nb_sections; i++) {
+        ret = calc_coefs(ctx, &s->sections[i], inlink->sample_rate);
+        if (ret < 0)
+            return ret;
+    }
+
+
+    s->cache = av_realloc_f(s->cache, sizeof(ChanCache), s->nb_sections * inlink->channels);
     if (!s->cache)
         return AVERROR(ENOMEM);
-    memset(s->cache, 0, sizeof(ChanCache) * inlink->channels);
+    memset(s->cache, 0, sizeof(ChanCache) * s->nb_sections * inlink->channels);
 
+    s->filter2 = NULL;
     switch (inlink->format) {
     case AV_SAMPLE_FMT_S16P: s->filter = biquad_s16; break;
     case AV_SAMPLE_FMT_S32P: s->filter = biquad_s32; break;
-    case AV_SAMPLE_FMT_FLTP: s->filter = biquad_flt; break;
-    case AV_SAMPLE_FMT_DBLP: s->filter = biquad_dbl; break;
+    case AV_SAMPLE_FMT_FLTP: s->filter = biquad_flt; s->filter2 = biquad2_flt; break;
+    case AV_SAMPLE_FMT_DBLP: s->filter = biquad_dbl; s->filter2 = biquad2_dbl; break;
     default: av_assert0(0);
     }
 
@@ -397,8 +549,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *buf)
     BiquadsContext *s     = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out_buf;
+    const int channels = av_frame_get_channels(buf);
     int nb_samples = buf->nb_samples;
-    int ch;
+    int ch, i;
 
     if (av_frame_is_writable(buf)) {
         out_buf = buf;
@@ -411,12 +564,29 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *buf)
         av_frame_copy_props(out_buf, buf);
     }
 
-    for (ch = 0; ch < av_frame_get_channels(buf); ch++)
-        s->filter(s, buf->extended_data[ch],
-                  out_buf->extended_data[ch], nb_samples,
-                  &s->cache[ch].i1, &s->cache[ch].i2,
-                  &s->cache[ch].o1, &s->cache[ch].o2,
-                  s->b0, s->b1, s->b2, s->a1, s->a2);
+    /* the sections are applied one after the other on each channel, exactly
+     * like a chain of filters, the later ones working in place */
+    ch = 0;
+    if (s->filter2) {
+        for (; ch + 1 < channels; ch += 2) {
+            for (i = 0; i < s->nb_sections; i++)
+                s->filter2(out_buf->extended_data + ch,
+                           (i ? out_buf : buf)->extended_data + ch,
+                           s->cache + i * channels + ch,
+                           &s->sections[i], nb_samples);
+        }
+    }
+    for (; ch < channels; ch++) {
+        for (i = 0; i < s->nb_sections; i++) {
+            const Section *sec = &s->sections[i];
+            ChanCache *cache = &s->cache[i * channels + ch];
+
+            s->filter(s, (i ? out_buf : buf)->extended_data[ch],
+                      out_buf->extended_data[ch], nb_samples,
+                      &cache->i1, &cache->i2, &cache->o1, &cache->o2,
+                      sec->b0, sec->b1, sec->b2, sec->a1, sec->a2);
+        }
+    }
 
     if (s->clippings > 0)
         av_log(ctx, AV_LOG_WARNING, "clipping %d times. Please reduce gain.\n", s->clippings);
@@ -432,6 +602,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     BiquadsContext *s = ctx->priv;
 
     av_freep(&s->cache);
+    av_freep(&s->sections);
 }
 
 static const AVFilterPad inputs[] = {
@@ -490,6 +661,7 @@ static const AVOption equalizer_options[] = {
     {"w",     "set band-width", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=1}, 0, 999, FLAGS},
     {"gain", "set gain", OFFSET(gain), AV_OPT_TYPE_DOUBLE, {.dbl=0}, -900, 900, FLAGS},
     {"g",    "set gain", OFFSET(gain), AV_OPT_TYPE_DOUBLE, {.dbl=0}, -900, 900, FLAGS},
+    {"sections", "set further cascaded sections", OFFSET(sections_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS},
     {NULL}
 };
 
@@ -508,6 +680,7 @@ static const AVOption bass_options[] = {
     {"w",     "set shelf transition steep", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=0.5}, 0, 99999, FLAGS},
     {"gain", "set gain", OFFSET(gain), AV_OPT_TYPE_DOUBLE, {.dbl=0}, -900, 900, FLAGS},
     {"g",    "set gain", OFFSET(gain), AV_OPT_TYPE_DOUBLE, {.dbl=0}, -900, 900, FLAGS},
+    {"sections", "set further cascaded sections", OFFSET(sections_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS},
     {NULL}
 };
 
@@ -526,6 +699,7 @@ static const AVOption treble_options[] = {
     {"w",     "set shelf transition steep", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=0.5}, 0, 99999, FLAGS},
     {"gain", "set gain", OFFSET(gain), AV_OPT_TYPE_DOUBLE, {.dbl=0}, -900, 900, FLAGS},
     {"g",    "set gain", OFFSET(gain), AV_OPT_TYPE_DOUBLE, {.dbl=0}, -900, 900, FLAGS},
+    {"sections", "set further cascaded sections", OFFSET(sections_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS},
     {NULL}
 };
 
@@ -543,6 +717,7 @@ static const AVOption bandpass_options[] = {
     {"width", "set band-width", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=0.5}, 0, 999, FLAGS},
     {"w",     "set band-width", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=0.5}, 0, 999, FLAGS},
     {"csg",   "use constant skirt gain", OFFSET(csg), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS},
+    {"sections", "set further cascaded sections", OFFSET(sections_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS},
     {NULL}
 };
 
@@ -559,6 +734,7 @@ static const AVOption bandreject_options[] = {
     {"s", "slope", 0, AV_OPT_TYPE_CONST, {.i64=SLOPE}, 0, 0, FLAGS, "width_type"},
     {"width", "set band-width", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=0.5}, 0, 999, FLAGS},
     {"w",     "set band-width", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=0.5}, 0, 999, FLAGS},
+    {"sections", "set further cascaded sections", OFFSET(sections_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS},
     {NULL}
 };
 
@@ -577,6 +753,7 @@ static const AVOption lowpass_options[] = {
     {"w",     "set width", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=0.707}, 0, 99999, FLAGS},
     {"poles", "set number of poles", OFFSET(poles), AV_OPT_TYPE_INT, {.i64=2}, 1, 2, FLAGS},
     {"p",     "set number of poles", OFFSET(poles), AV_OPT_TYPE_INT, {.i64=2}, 1, 2, FLAGS},
+    {"sections", "set further cascaded sections", OFFSET(sections_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS},
     {NULL}
 };
 
@@ -595,6 +772,7 @@ static const AVOption highpass_options[] = {
     {"w",     "set width", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=0.707}, 0, 99999, FLAGS},
     {"poles", "set number of poles", OFFSET(poles), AV_OPT_TYPE_INT, {.i64=2}, 1, 2, FLAGS},
     {"p",     "set number of poles", OFFSET(poles), AV_OPT_TYPE_INT, {.i64=2}, 1, 2, FLAGS},
+    {"sections", "set further cascaded sections", OFFSET(sections_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS},
     {NULL}
 };
 
@@ -611,6 +789,7 @@ static const AVOption allpass_options[] = {
     {"s", "slope", 0, AV_OPT_TYPE_CONST, {.i64=SLOPE}, 0, 0, FLAGS, "width_type"},
     {"width", "set filter-width", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=707.1}, 0, 99999, FLAGS},
     {"w",     "set filter-width", OFFSET(width), AV_OPT_TYPE_DOUBLE, {.dbl=707.1}, 0, 99999, FLAGS},
+    {"sections", "set further cascaded sections", OFFSET(sections_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS},
     {NULL}
 };
 
@@ -25,9 +25,12 @@
 #include "avfilter.h"
 #include "internal.h"
 #include "audio.h"
+#include "partconv.h"
 
 #define RDFT_BITS_MIN 4
 #define RDFT_BITS_MAX 16
+/* longer kernels use partitioned convolution with this rdft size */
+#define PART_RDFT_BITS 13
 
 enum WindowFunc {
     WFUNC_RECTANGULAR,
@@ -78,6 +81,7 @@ typedef struct {
     float         *kernel_buf;
     float         *conv_buf;
     OverlapIndex  *conv_idx;
+    PartConvContext conv;
     int           fir_len;
     int           nsamples_max;
     int64_t       next_pts;
@@ -151,6 +155,7 @@ static void common_uninit(FIREqualizerContext *s)
     av_freep(&s->kernel_buf);
     av_freep(&s->conv_buf);
     av_freep(&s->conv_idx);
+    ff_partconv_uninit(&s->conv);
 }
 
 static av_cold void uninit(AVFilterContext *ctx)
@@ -460,6 +465,8 @@ static int generate_kernel(AVFilterContext *ctx, const char *gain, const char *g
     vars[VAR_SR] = inlink->sample_rate;
     for (ch = 0; ch < inlink->channels; ch++) {
         float *rdft_buf = s->kernel_tmp_buf + ch * s->rdft_len;
+        float *nan_check_buf;
+        int nan_check_len;
         double result;
         vars[VAR_CH] = ch;
         vars[VAR_CHID] = av_channel_layout_extract_channel(inlink->channel_layout, ch);
@@ -533,12 +540,25 @@ static int generate_kernel(AVFilterContext *ctx, const char *gain, const char *g
         }
 
         memset(s->analysis_buf + center + 1, 0, (s->analysis_rdft_len - s->fir_len) * sizeof(*s->analysis_buf));
-        memcpy(rdft_buf, s->analysis_buf, s->rdft_len/2 * sizeof(*s->analysis_buf));
-        memcpy(rdft_buf + s->rdft_len/2, s->analysis_buf + s->analysis_rdft_len - s->rdft_len/2, s->rdft_len/2 * sizeof(*s->analysis_buf));
-        av_rdft_calc(s->rdft, rdft_buf);
 
-        for (k = 0; k < s->rdft_len; k++) {
-            if (isnan(rdft_buf[k]) || isinf(rdft_buf[k])) {
+        if (s->conv.block_size) {
+            /* causal kernel for the partitioned convolution */
+            float *fir_buf = s->kernel_tmp_buf + ch * s->fir_len;
+
+            for (k = 0; k < s->fir_len; k++)
+                fir_buf[k] = s->analysis_buf[(k - center) & (s->analysis_rdft_len - 1)];
+            nan_check_buf = fir_buf;
+            nan_check_len = s->fir_len;
+        } else {
+            memcpy(rdft_buf, s->analysis_buf, s->rdft_len/2 * sizeof(*s->analysis_buf));
+            memcpy(rdft_buf + s->rdft_len/2, s->analysis_buf + s->analysis_rdft_len - s->rdft_len/2, s->rdft_len/2 * sizeof(*s->analysis_buf));
+            av_rdft_calc(s->rdft, rdft_buf);
+            nan_check_buf = rdft_buf;
+            nan_check_len = s->rdft_len;
+        }
+
+        for (k = 0; k < nan_check_len; k++) {
+            if (isnan(nan_check_buf[k]) || isinf(nan_check_buf[k])) {
                 av_log(ctx, AV_LOG_ERROR, "filter kernel contains nan or infinity.\n");
                 av_expr_free(gain_expr);
                 if (dump_fp)
@@ -547,10 +567,12 @@ static int generate_kernel(AVFilterContext *ctx, const char *gain, const char *g
             }
         }
 
-        rdft_buf[s->rdft_len-1] = rdft_buf[1];
-        for (k = 0; k < s->rdft_len/2; k++)
-            rdft_buf[k] = rdft_buf[2*k];
-        rdft_buf[s->rdft_len/2] = rdft_buf[s->rdft_len-1];
+        if (!s->conv.block_size) {
+            rdft_buf[s->rdft_len-1] = rdft_buf[1];
+            for (k = 0; k < s->rdft_len/2; k++)
+                rdft_buf[k] = rdft_buf[2*k];
+            rdft_buf[s->rdft_len/2] = rdft_buf[s->rdft_len-1];
+        }
 
         if (dump_fp)
             dump_fir(ctx, dump_fp, ch);
@@ -559,7 +581,12 @@ static int generate_kernel(AVFilterContext *ctx, const char *gain, const char *g
             break;
     }
 
-    memcpy(s->kernel_buf, s->kernel_tmp_buf, (s->multi ? inlink->channels : 1) * s->rdft_len * sizeof(*s->kernel_buf));
+    if (s->conv.block_size) {
+        for (ch = 0; ch < s->conv.nb_kernels; ch++)
+            ff_partconv_set_kernel(&s->conv, ch, s->kernel_tmp_buf + ch * s->fir_len, s->fir_len);
+    } else {
+        memcpy(s->kernel_buf, s->kernel_tmp_buf, (s->multi ? inlink->channels : 1) * s->rdft_len * sizeof(*s->kernel_buf));
+    }
     av_expr_free(gain_expr);
     if (dump_fp)
         fclose(dump_fp);
@@ -573,7 +600,7 @@ static int config_input(AVFilterLink *inlink)
 {
     AVFilterContext *ctx = inlink->dst;
     FIREqualizerContext *s = ctx->priv;
-    int rdft_bits;
+    int rdft_bits, nb_kernels, ret;
 
     common_uninit(s);
 
@@ -583,20 +610,31 @@ static int config_input(AVFilterLink *inlink)
     s->fir_len = FFMAX(2 * (int)(inlink->sample_rate * s->delay) + 1, 3);
     s->remaining = s->fir_len - 1;
 
-    for (rdft_bits = RDFT_BITS_MIN; rdft_bits <= RDFT_BITS_MAX; rdft_bits++) {
+    nb_kernels = s->multi ? inlink->channels : 1;
+
+    for (rdft_bits = RDFT_BITS_MIN; rdft_bits <= PART_RDFT_BITS; rdft_bits++) {
         s->rdft_len = 1 << rdft_bits;
         s->nsamples_max = s->rdft_len - s->fir_len + 1;
         if (s->nsamples_max * 2 >= s->fir_len)
             break;
     }
 
-    if (rdft_bits > RDFT_BITS_MAX) {
-        av_log(ctx, AV_LOG_ERROR, "too large delay, please decrease it.\n");
-        return AVERROR(EINVAL);
-    }
+    if (rdft_bits > PART_RDFT_BITS) {
+        /* the analysis rdft below must cover the whole kernel */
+        rdft_bits = av_log2(s->fir_len) + 1;
+        if (rdft_bits > RDFT_BITS_MAX) {
+            av_log(ctx, AV_LOG_ERROR, "too large delay, please decrease it.\n");
+            return AVERROR(EINVAL);
+        }
 
-    if (!(s->rdft = av_rdft_init(rdft_bits, DFT_R2C)) || !(s->irdft = av_rdft_init(rdft_bits, IDFT_C2R)))
+        s->rdft_len = 1 << PART_RDFT_BITS;
+        s->nsamples_max = s->rdft_len / 2;
+        ret = ff_partconv_init(&s->conv, PART_RDFT_BITS - 1, s->fir_len, nb_kernels, inlink->channels);
+        if (ret < 0)
+            return ret;
+    } else if (!(s->rdft = av_rdft_init(rdft_bits, DFT_R2C)) || !(s->irdft = av_rdft_init(rdft_bits, IDFT_C2R))) {
         return AVERROR(ENOMEM);
+    }
 
     for ( ; rdft_bits <= RDFT_BITS_MAX; rdft_bits++) {
         s->analysis_rdft_len = 1 << rdft_bits;
@@ -618,12 +656,18 @@ static int config_input(AVFilterLink *inlink)
     }
 
     s->analysis_buf = av_malloc_array(s->analysis_rdft_len, sizeof(*s->analysis_buf));
-    s->kernel_tmp_buf = av_malloc_array(s->rdft_len * (s->multi ? inlink->channels : 1), sizeof(*s->kernel_tmp_buf));
-    s->kernel_buf = av_malloc_array(s->rdft_len * (s->multi ? inlink->channels : 1), sizeof(*s->kernel_buf));
-    s->conv_buf   = av_calloc(2 * s->rdft_len * inlink->channels, sizeof(*s->conv_buf));
-    s->conv_idx   = av_calloc(inlink->channels, sizeof(*s->conv_idx));
-    if (!s->analysis_buf || !s->kernel_tmp_buf || !s->kernel_buf || !s->conv_buf || !s->conv_idx)
-        return AVERROR(ENOMEM);
+    if (s->conv.block_size) {
+        s->kernel_tmp_buf = av_malloc_array(s->fir_len * nb_kernels, sizeof(*s->kernel_tmp_buf));
+        if (!s->analysis_buf || !s->kernel_tmp_buf)
+            return AVERROR(ENOMEM);
+    } else {
+        s->kernel_tmp_buf = av_malloc_array(s->rdft_len * nb_kernels, sizeof(*s->kernel_tmp_buf));
+        s->kernel_buf = av_malloc_array(s->rdft_len * nb_kernels, sizeof(*s->kernel_buf));
+        s->conv_buf   = av_calloc(2 * s->rdft_len * inlink->channels, sizeof(*s->conv_buf));
+        s->conv_idx   = av_calloc(inlink->channels, sizeof(*s->conv_idx));
+        if (!s->analysis_buf || !s->kernel_tmp_buf || !s->kernel_buf || !s->conv_buf || !s->conv_idx)
+            return AVERROR(ENOMEM);
+    }
 
     av_log(ctx, AV_LOG_DEBUG, "sample_rate = %d, channels = %d, analysis_rdft_len = %d, rdft_len = %d, fir_len = %d, nsamples_max = %d.\n",
            inlink->sample_rate, inlink->channels, s->analysis_rdft_len, s->rdft_len, s->fir_len, s->nsamples_max);
@@ -641,9 +685,14 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     int ch;
 
     for (ch = 0; ch < inlink->channels; ch++) {
-        fast_convolute(s, s->kernel_buf + (s->multi ? ch * s->rdft_len : 0),
-                       s->conv_buf + 2 * ch * s->rdft_len, s->conv_idx + ch,
-                       (float *) frame->extended_data[ch], frame->nb_samples);
+        float *data = (float *) frame->extended_data[ch];
+
+        if (s->conv.block_size)
+            ff_partconv_filter(&s->conv, ch, s->multi ? ch : 0, data, data, frame->nb_samples);
+        else
+            fast_convolute(s, s->kernel_buf + (s->multi ? ch * s->rdft_len : 0),
+                           s->conv_buf + 2 * ch * s->rdft_len, s->conv_idx + ch,
+                           data, frame->nb_samples);
     }
 
     s->next_pts = AV_NOPTS_VALUE;
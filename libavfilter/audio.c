@@ -54,6 +54,7 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
         av_frame_free(&frame);
         return NULL;
     }
+    ff_filter_count_allocation(link);
 
     av_samples_set_silence(frame->extended_data, 0, nb_samples, channels,
                            link->format);
@@ -357,6 +357,23 @@ static int request_frame(AVFilterLink *outlink)
     }
 }
 
+/**
+ * Leave the frames of the next segments in the queues of their links, where
+ * they count against the limits of the links, until the segment starts.
+ */
+static int hold_input(void *opaque, unsigned in_no)
+{
+    AVFilterContext *ctx = opaque;
+    ConcatContext *cat   = ctx->priv;
+
+    return in_no >= cat->cur_idx + ctx->nb_outputs;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    return ff_filter_activate_default_hold(ctx, hold_input, ctx);
+}
+
 static av_cold int init(AVFilterContext *ctx)
 {
     ConcatContext *cat = ctx->priv;
@@ -417,6 +434,7 @@ AVFilter ff_avf_concat = {
     .init          = init,
     .uninit        = uninit,
     .query_formats = query_formats,
+    .activate      = activate,
     .priv_size     = sizeof(ConcatContext),
     .inputs        = NULL,
     .outputs       = NULL,
@@ -33,17 +33,17 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/time.h"
 
 #include "audio.h"
 #include "avfilter.h"
 #include "formats.h"
+#include "framequeue.h"
 #include "internal.h"
 
 #include "libavutil/ffversion.h"
 const char av_filter_ffversion[] = "FFmpeg version " FFMPEG_VERSION;
 
-static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame);
-
 void ff_tlog_ref(void *ctx, AVFrame *ref, int end)
 {
     av_unused char buf[16];
@@ -150,6 +150,12 @@ int avfilter_link(AVFilterContext *src, unsigned srcpad,
     link = av_mallocz(sizeof(*link));
     if (!link)
         return AVERROR(ENOMEM);
+    link->fifo = av_mallocz(sizeof(*link->fifo));
+    if (!link->fifo) {
+        av_freep(&link);
+        return AVERROR(ENOMEM);
+    }
+    ff_framequeue_init(link->fifo);
 
     src->outputs[srcpad] = dst->inputs[dstpad] = link;
 
@@ -170,6 +176,9 @@ void avfilter_link_free(AVFilterLink **link)
         return;
 
     av_frame_free(&(*link)->partial_buf);
+    if ((*link)->fifo)
+        ff_framequeue_free((*link)->fifo);
+    av_freep(&(*link)->fifo);
     ff_video_frame_pool_uninit((FFVideoFramePool**)&(*link)->video_frame_pool);
 
     av_freep(link);
@@ -180,16 +189,80 @@ int avfilter_link_get_channels(AVFilterLink *link)
     return link->channels;
 }
 
+size_t avfilter_link_get_queued_frames(AVFilterLink *link)
+{
+    return ff_framequeue_queued_frames(link->fifo);
+}
+
+void ff_filter_count_allocation(AVFilterLink *link)
+{
+    AVFilterGraphInternal *gi;
+
+    if (!link->graph || !link->graph->profile)
+        return;
+    gi = link->graph->internal;
+    /* with pipeline threading, the filters on both sides of a filter
+       passing its buffers through may allocate on its output concurrently */
+    if (gi->pipeline_running) {
+        ff_mutex_lock(&gi->ready_lock);
+        link->src->internal->nb_allocated_frames++;
+        ff_mutex_unlock(&gi->ready_lock);
+    } else {
+        link->src->internal->nb_allocated_frames++;
+    }
+}
+
+void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
+{
+    AVFilterGraphInternal *gi = filter->graph ? filter->graph->internal : NULL;
+
+    /* a filter can be marked ready by several of its neighbors at once */
+    if (gi && gi->pipeline_running) {
+        ff_mutex_lock(&gi->ready_lock);
+        filter->internal->ready = FFMAX(filter->internal->ready, priority);
+        ff_mutex_unlock(&gi->ready_lock);
+    } else {
+        filter->internal->ready = FFMAX(filter->internal->ready, priority);
+    }
+}
+
+/**
+ * Clear frame_blocked_in on all outputs.
+ * This is necessary whenever something changes on input.
+ */
+static void filter_unblock(AVFilterContext *filter)
+{
+    unsigned i;
+
+    for (i = 0; i < filter->nb_outputs; i++)
+        filter->outputs[i]->frame_blocked_in = 0;
+}
+
 void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
 {
-    ff_avfilter_link_set_out_status(link, status, pts);
+    if (link->status_in == status)
+        return;
+    av_assert0(!link->status_in);
+    link->status_in = status;
+    link->status_in_pts = pts;
+    link->frame_wanted_out = 0;
+    link->frame_blocked_in = 0;
+    filter_unblock(link->dst);
+    ff_filter_set_ready(link->dst, 200);
 }
 
 void ff_avfilter_link_set_out_status(AVFilterLink *link, int status, int64_t pts)
 {
-    link->status = status;
-    link->frame_wanted_in = link->frame_wanted_out = 0;
+    link->status_out = status;
+    link->frame_wanted_out = 0;
+    if (status)
+        /* the destination will not read the frames still in the queue */
+        ff_framequeue_free(link->fifo);
+    else
+        link->status_in = 0;
     ff_update_link_current_pts(link, pts);
+    filter_unblock(link->dst);
+    ff_filter_set_ready(link->src, 200);
 }
 
 void avfilter_link_set_closed(AVFilterLink *link, int closed)
@@ -370,34 +443,43 @@ int ff_request_frame(AVFilterLink *link)
 {
     FF_TPRINTF_START(NULL, request_frame); ff_tlog_link(NULL, link, 1);
 
-    if (link->status)
-        return link->status;
-    link->frame_wanted_in = 1;
+    if (link->status_out)
+        return link->status_out;
+    if (ff_framequeue_queued_frames(link->fifo) ||
+        (link->status_in && link->partial_buf)) {
+        /* frames are already waiting to be filtered */
+        ff_filter_set_ready(link->dst, 300);
+        return 0;
+    }
+    if (link->status_in) {
+        /* Acknowledge the status change. Filters using ff_request_frame()
+           handle it automatically. */
+        ff_avfilter_link_set_out_status(link, link->status_in, link->status_in_pts);
+        return link->status_out;
+    }
     link->frame_wanted_out = 1;
+    ff_filter_set_ready(link->src, 100);
     return 0;
 }
 
-int ff_request_frame_to_filter(AVFilterLink *link)
+static int ff_request_frame_to_filter(AVFilterLink *link)
 {
     int ret = -1;
 
     FF_TPRINTF_START(NULL, request_frame_to_filter); ff_tlog_link(NULL, link, 1);
-    link->frame_wanted_in = 0;
+    /* Assume the filter is blocked, let the method clear it if not */
+    link->frame_blocked_in = 1;
     if (link->srcpad->request_frame)
         ret = link->srcpad->request_frame(link);
     else if (link->src->inputs[0])
         ret = ff_request_frame(link->src->inputs[0]);
-    if (ret == AVERROR_EOF && link->partial_buf) {
-        AVFrame *pbuf = link->partial_buf;
-        link->partial_buf = NULL;
-        ret = ff_filter_frame_framed(link, pbuf);
-        ff_avfilter_link_set_in_status(link, AVERROR_EOF, AV_NOPTS_VALUE);
-        link->frame_wanted_out = 0;
-        return ret;
-    }
     if (ret < 0) {
-        if (ret != AVERROR(EAGAIN) && ret != link->status)
+        if (ret != AVERROR(EAGAIN) && ret != link->status_in)
             ff_avfilter_link_set_in_status(link, ret, AV_NOPTS_VALUE);
+        /* EOF is forwarded through the link status; EAGAIN leaves the link
+           blocked until something changes on the inputs of the source */
+        if (ret == AVERROR_EOF || ret == AVERROR(EAGAIN))
+            ret = 0;
     }
     return ret;
 }
@@ -613,8 +695,9 @@ static const AVClass *filter_child_class_next(const AVClass *prev)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM
 static const AVOption avfilter_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
-        { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
+        { .i64 = AVFILTER_THREAD_SLICE | AVFILTER_THREAD_PIPELINE }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .unit = "thread_type" },
+        { "pipeline", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_PIPELINE }, .unit = "thread_type" },
     { "enable", "set enable expression", OFFSET(enable_str), AV_OPT_TYPE_STRING, {.str=NULL}, .flags = FLAGS },
     { "threads", "Allowed number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, FLAGS },
@@ -877,7 +960,7 @@ int avfilter_init_filter(AVFilterContext *filter, const char *args, void *opaque
 
 int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
 {
-    int ret = 0;
+    int ret = 0, thread_type = 0;
 
     ret = av_opt_set_dict(ctx, options);
     if (ret < 0) {
@@ -888,11 +971,13 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
     if (ctx->filter->flags & AVFILTER_FLAG_SLICE_THREADS &&
         ctx->thread_type & ctx->graph->thread_type & AVFILTER_THREAD_SLICE &&
         ctx->graph->internal->thread_execute) {
-        ctx->thread_type       = AVFILTER_THREAD_SLICE;
+        thread_type           |= AVFILTER_THREAD_SLICE;
         ctx->internal->execute = ctx->graph->internal->thread_execute;
-    } else {
-        ctx->thread_type = 0;
     }
+    if (ctx->thread_type & ctx->graph->thread_type & AVFILTER_THREAD_PIPELINE &&
+        ctx->graph->internal->pipeline)
+        thread_type |= AVFILTER_THREAD_PIPELINE;
+    ctx->thread_type = thread_type;
 
     if (ctx->filter->priv_class) {
         ret = av_opt_set_dict(ctx->priv, options);
@@ -1056,9 +1141,9 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     AVFilterCommand *cmd= link->dst->command_queue;
     int64_t pts;
 
-    if (link->status) {
+    if (link->status_out) {
         av_frame_free(&frame);
-        return link->status;
+        return link->status_out;
     }
 
     if (!(filter_frame = dst->filter_frame))
@@ -1120,7 +1205,7 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     pts = out->pts;
     if (dstctx->enable_str) {
         int64_t pos = av_frame_get_pkt_pos(out);
-        dstctx->var_values[VAR_N] = link->frame_count;
+        dstctx->var_values[VAR_N] = link->frame_count_out;
         dstctx->var_values[VAR_T] = pts == AV_NOPTS_VALUE ? NAN : pts * av_q2d(link->time_base);
         dstctx->var_values[VAR_W] = link->w;
         dstctx->var_values[VAR_H] = link->h;
@@ -1132,7 +1217,7 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
             filter_frame = default_filter_frame;
     }
     ret = filter_frame(link, out);
-    link->frame_count++;
+    link->frame_count_out++;
     ff_update_link_current_pts(link, pts);
     return ret;
 
@@ -1176,9 +1261,6 @@ static int ff_filter_frame_needs_framing(AVFilterLink *link, AVFrame *frame)
         if (pbuf->nb_samples >= link->min_samples) {
             ret = ff_filter_frame_framed(link, pbuf);
             pbuf = NULL;
-        } else {
-            if (link->frame_wanted_out)
-                link->frame_wanted_in = 1;
         }
     }
     av_frame_free(&frame);
@@ -1188,6 +1270,8 @@ static int ff_filter_frame_needs_framing(AVFilterLink *link, AVFrame *frame)
 
 int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
 {
+    int ret;
+
     FF_TPRINTF_START(NULL, filter_frame); ff_tlog_link(NULL, link, 1); ff_tlog(NULL, " "); ff_tlog_ref(NULL, frame, 1);
 
     /* Consistency checks */
@@ -1220,20 +1304,249 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
         }
     }
 
-    link->frame_wanted_out = 0;
+    if (link->status_out) {
+        av_frame_free(&frame);
+        return link->status_out;
+    }
+
+    link->frame_blocked_in = link->frame_wanted_out = 0;
+    link->frame_count_in++;
+    filter_unblock(link->dst);
+    ret = ff_framequeue_add(link->fifo, frame);
+    if (ret < 0) {
+        av_frame_free(&frame);
+        return ret;
+    }
+    ff_filter_set_ready(link->dst, 300);
+    return 0;
+
+error:
+    av_frame_free(&frame);
+    return AVERROR_PATCHWELCOME;
+}
+
+static int ff_filter_frame_to_filter(AVFilterLink *link)
+{
+    AVFrame *frame = ff_framequeue_take(link->fifo);
+    AVFilterContext *dst = link->dst;
+    int ret;
+
+    /* The filter will soon have received a new frame, that may allow it to
+       produce one or more: unblock its outputs. */
+    filter_unblock(dst);
     /* Go directly to actual filtering if possible */
     if (link->type == AVMEDIA_TYPE_AUDIO &&
         link->min_samples &&
         (link->partial_buf ||
          frame->nb_samples < link->min_samples ||
-         frame->nb_samples > link->max_samples)) {
-        return ff_filter_frame_needs_framing(link, frame);
+         frame->nb_samples > link->max_samples))
+        ret = ff_filter_frame_needs_framing(link, frame);
+    else
+        ret = ff_filter_frame_framed(link, frame);
+    if (ret < 0 && ret != link->status_out) {
+        ff_avfilter_link_set_out_status(link, ret, AV_NOPTS_VALUE);
     } else {
-        return ff_filter_frame_framed(link, frame);
+        /* Run once again, to see if several frames were available, or if
+           the input status has also changed, or any other reason. */
+        ff_filter_set_ready(dst, 300);
     }
-error:
-    av_frame_free(&frame);
-    return AVERROR_PATCHWELCOME;
+    return ret;
+}
+
+static int ff_filter_flush_partial_buf(AVFilterLink *link)
+{
+    AVFrame *pbuf = link->partial_buf;
+    int ret;
+
+    link->partial_buf = NULL;
+    ret = ff_filter_frame_framed(link, pbuf);
+    ff_filter_set_ready(link->dst, 300);
+    return ret;
+}
+
+static int forward_status_change(AVFilterContext *filter, AVFilterLink *in)
+{
+    unsigned i, progress = 0;
+    int ret;
+
+    av_assert0(!in->status_out);
+    if (!filter->nb_outputs) {
+        /* sinks acknowledge the status when they request a frame */
+        return 0;
+    }
+    /* Filters notice the status change of their inputs when they call
+       ff_request_frame() from their request_frame() method. */
+    for (i = 0; i < filter->nb_outputs && !in->status_out; i++) {
+        if (filter->outputs[i]->status_in)
+            continue;
+        progress++;
+        ret = ff_request_frame_to_filter(filter->outputs[i]);
+        if (ret < 0)
+            return ret;
+    }
+    if (!progress) {
+        /* Every output already closed: input no longer interesting
+           (example: overlay in shortest mode, other input closed). */
+        ff_avfilter_link_set_out_status(in, in->status_in, in->status_in_pts);
+        return 0;
+    }
+    if (in->status_out)
+        ff_filter_set_ready(filter, 200);
+    return 0;
+}
+
+int ff_filter_activate_default_hold(AVFilterContext *filter,
+                                    int (*hold)(void *opaque, unsigned in),
+                                    void *opaque)
+{
+    unsigned i;
+
+    for (i = 0; i < filter->nb_inputs; i++) {
+        if (ff_framequeue_queued_frames(filter->inputs[i]->fifo) &&
+            !(hold && hold(opaque, i)))
+            return ff_filter_frame_to_filter(filter->inputs[i]);
+    }
+    for (i = 0; i < filter->nb_inputs; i++) {
+        AVFilterLink *in = filter->inputs[i];
+        /* the status change happens after the frames still held */
+        if (in->status_in && !in->status_out &&
+            !ff_framequeue_queued_frames(in->fifo)) {
+            if (in->partial_buf)
+                return ff_filter_flush_partial_buf(in);
+            return forward_status_change(filter, in);
+        }
+    }
+    for (i = 0; i < filter->nb_outputs; i++) {
+        if (filter->outputs[i]->frame_wanted_out &&
+            !filter->outputs[i]->frame_blocked_in) {
+            return ff_request_frame_to_filter(filter->outputs[i]);
+        }
+    }
+    return 0;
+}
+
+int ff_filter_activate_default(AVFilterContext *filter)
+{
+    return ff_filter_activate_default_hold(filter, NULL, NULL);
+}
+
+/*
+   Filter scheduling and activation
+
+   Frames sent with ff_filter_frame() are queued in the fifo of the link
+   instead of being pushed recursively through the whole graph, so the
+   depth of the call stack and the amount of work done by a single call do
+   not depend on the size of the graph.
+
+   The following AVFilterLink fields are used for activation:
+
+   - frame_wanted_out: a frame is needed on this input of the destination
+     filter. Set by ff_request_frame(), cleared when a frame is sent over
+     the link.
+
+   - frame_blocked_in: request_frame() was called on the source filter and
+     did not produce anything yet; cleared when something changes on the
+     inputs of the source filter, to avoid requesting repeatedly on a
+     blocked link.
+
+   - fifo: the frames queued on the input of the destination filter.
+
+   - status_in / status_in_pts: status (EOF or error code) of the link as
+     seen from the source filter, set with ff_avfilter_link_set_in_status().
+     The status change is considered to happen after the queued frames.
+
+   - status_out: status of the link as seen from the destination filter,
+     set with ff_avfilter_link_set_out_status() when it acknowledges the
+     change or does not want any more frames.
+
+   Filters are activated according to their ready value, set using
+   ff_filter_set_ready() whenever something could make progress possible:
+   frames added on an input (300), a status change on a link (200), a
+   request on an output (100). Marking a filter ready when it is not is
+   not a problem, except for the small overhead it causes.
+
+   Filters implementing the legacy filter_frame() and request_frame()
+   methods perform the first possible of the following actions:
+
+   - if an input has queued frames, dequeue one and call filter_frame(),
+     applying min_samples / max_samples framing;
+
+   - if an input has status_in set but not status_out, call request_frame()
+     on the outputs in the hope that it will call ff_request_frame() on the
+     input and acknowledge the change;
+
+   - if an output has frame_wanted_out but not frame_blocked_in, call
+     request_frame() on it.
+
+   Links can have a maximum queue size (max_queued_frames,
+   max_queued_bytes). The scheduler does not activate a filter while one of
+   its outputs is full: the filter stays ready and is selected again once
+   the destination has consumed enough frames. Buffer sources and sinks
+   report the resulting stalls to the application with AVERROR(EAGAIN).
+   Filters that buffer frames internally until another input catches up
+   (amix, overlay, concat) stop taking frames from an input once they hold
+   as many as its limits allow, using ff_filter_activate_default_hold().
+ */
+
+int ff_filter_activate(AVFilterContext *filter)
+{
+    int profile = filter->graph && filter->graph->profile;
+    int64_t start = profile ? av_gettime_relative() : 0;
+    int ret;
+
+    filter->internal->ready = 0;
+    ret = filter->filter->activate ? filter->filter->activate(filter) :
+          ff_filter_activate_default(filter);
+    if (profile) {
+        filter->internal->profile_time += av_gettime_relative() - start;
+        filter->internal->nb_activations++;
+    }
+    return ret;
+}
+
+int ff_link_queue_limit_reached(AVFilterLink *link, uint64_t frames,
+                                uint64_t bytes)
+{
+    return (link->max_queued_frames && frames >= link->max_queued_frames) ||
+           (link->max_queued_bytes  && bytes  >= link->max_queued_bytes);
+}
+
+int ff_link_queue_full(AVFilterLink *link)
+{
+    return ff_link_queue_limit_reached(link, ff_framequeue_queued_frames(link->fifo),
+                                       ff_framequeue_queued_bytes(link->fifo));
+}
+
+void avfilter_link_set_queue_limits(AVFilterLink *link, unsigned max_frames,
+                                    int64_t max_bytes)
+{
+    link->max_queued_frames = max_frames;
+    link->max_queued_bytes  = max_bytes;
+    if ((max_frames || max_bytes) && link->graph)
+        link->graph->internal->bounded_queues = 1;
+}
+
+int avfilter_get_profile(AVFilterContext *filter, AVFilterProfile *profile,
+                         size_t size)
+{
+    AVFilterProfile p = { 0 };
+    unsigned i;
+
+    p.time                = filter->internal->profile_time;
+    p.nb_activations      = filter->internal->nb_activations;
+    p.nb_allocated_frames = filter->internal->nb_allocated_frames;
+    for (i = 0; i < filter->nb_inputs; i++) {
+        if (!filter->inputs[i])
+            continue;
+        p.frames_in     += filter->inputs[i]->frame_count_out;
+        p.queued_frames += ff_framequeue_queued_frames(filter->inputs[i]->fifo);
+    }
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i])
+            p.frames_out += filter->outputs[i]->frame_count_in;
+
+    memcpy(profile, &p, FFMIN(size, sizeof(p)));
+    return 0;
 }
 
 const AVClass *avfilter_get_class(void)
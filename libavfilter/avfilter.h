@@ -294,6 +294,24 @@ typedef struct AVFilter {
      * used for providing binary data.
      */
     int (*init_opaque)(AVFilterContext *ctx, void *opaque);
+
+    /**
+     * Filter activation function.
+     *
+     * Called when any processing is needed from the filter, instead of any
+     * filter_frame and request_frame on pads.
+     *
+     * The function must examine inlinks and outlinks and perform a single
+     * step of processing. If there is nothing to do, the function must do
+     * nothing and not return an error. If more steps are or may be
+     * possible, it must use ff_filter_set_ready() to schedule another
+     * activation.
+     *
+     * If NULL, the filter is activated by the generic code, which calls
+     * the filter_frame callback with the queued input frames and the
+     * request_frame callback when frames are wanted on the outputs.
+     */
+    int (*activate)(AVFilterContext *ctx);
 } AVFilter;
 
 /**
@@ -301,6 +319,12 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Run several filters of the graph concurrently, the frames being handed
+ * over through the link queues.
+ */
+#define AVFILTER_THREAD_PIPELINE (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -509,16 +533,29 @@ struct AVFilterLink {
     int max_samples;
 
     /**
-     * Link status.
-     * If not zero, all attempts of filter_frame or request_frame
-     * will fail with the corresponding code, and if necessary the reference
-     * will be destroyed.
-     * If request_frame returns an error, the status is set on the
-     * corresponding link.
-     * It can be set also be set by either the source or the destination
-     * filter.
+     * Link input status.
+     * If not zero, all attempts of filter_frame will fail with the
+     * corresponding code.
+     * Set by the source filter when it can not output frames anymore, but
+     * the frames already queued on the link can still be read: the
+     * destination filter only notices the change once the queue is empty.
+     */
+    int status_in;
+
+    /**
+     * Timestamp of the input status change.
      */
-    int status;
+    int64_t status_in_pts;
+
+    /**
+     * Link output status.
+     * If not zero, all attempts of request_frame will fail with the
+     * corresponding code.
+     * Set when the destination filter has acknowledged the input status, or
+     * directly by the destination filter when it does not want any more
+     * frames on this link.
+     */
+    int status_out;
 
     /**
      * Number of channels.
@@ -533,20 +570,13 @@ struct AVFilterLink {
     /**
      * Number of past frames sent through the link.
      */
-    int64_t frame_count;
+    int64_t frame_count_in, frame_count_out;
 
     /**
      * A pointer to a FFVideoFramePool struct.
      */
     void *video_frame_pool;
 
-    /**
-     * True if a frame is currently wanted on the input of this filter.
-     * Set when ff_request_frame() is called by the output,
-     * cleared when the request is handled or forwarded.
-     */
-    int frame_wanted_in;
-
     /**
      * True if a frame is currently wanted on the output of this filter.
      * Set when ff_request_frame() is called by the output,
@@ -554,6 +584,31 @@ struct AVFilterLink {
      */
     int frame_wanted_out;
 
+    /**
+     * If set, the source filter can not generate a frame as is.
+     * The goal is to avoid repeatedly calling the request_frame() method on
+     * the same link.
+     */
+    int frame_blocked_in;
+
+    /**
+     * Queue of frames waiting to be filtered by the destination filter.
+     */
+    struct FFFrameQueue *fifo;
+
+    /**
+     * Maximum number of frames queued on the link, 0 for no limit.
+     * When the queue is full, the source filter is not activated until
+     * the destination has consumed some frames.
+     */
+    unsigned max_queued_frames;
+
+    /**
+     * Maximum total size in bytes of the frames queued on the link,
+     * 0 for no limit.
+     */
+    int64_t max_queued_bytes;
+
     /**
      * For hwaccel pixel formats, this should be a reference to the
      * AVHWFramesContext describing the frames.
@@ -583,6 +638,29 @@ void avfilter_link_free(AVFilterLink **link);
  */
 int avfilter_link_get_channels(AVFilterLink *link);
 
+/**
+ * Get the number of frames queued on a link, waiting to be processed by
+ * its destination filter.
+ */
+size_t avfilter_link_get_queued_frames(AVFilterLink *link);
+
+/**
+ * Set the maximum size of the queue of a link.
+ *
+ * Once one of the limits is reached, the source filter of the link is no
+ * longer activated until its destination has consumed some frames, and
+ * buffer sources feeding the link return AVERROR(EAGAIN) from
+ * av_buffersrc_add_frame_flags().
+ * A single activation of the source filter may still exceed the limits
+ * if it produces several frames at once.
+ *
+ * @param max_frames maximum number of queued frames, 0 for no limit
+ * @param max_bytes  maximum total size of the data buffers of the queued
+ *                   frames, 0 for no limit
+ */
+void avfilter_link_set_queue_limits(AVFilterLink *link, unsigned max_frames,
+                                    int64_t max_bytes);
+
 /**
  * Set the closed field of a link.
  * @deprecated applications are not supposed to mess with links, they should
@@ -851,6 +929,33 @@ typedef struct AVFilterGraph {
     int sink_links_count;
 
     unsigned disable_auto_convert;
+
+    /**
+     * Maximum number of frames queued on each link of the graph, 0 for no
+     * limit. Only applies to links that have no limit set explicitly.
+     * Must be set before avfilter_graph_config().
+     *
+     * Graphs splitting a stream and merging the branches again can
+     * deadlock if one branch must get ahead of the other by more than
+     * the limits.
+     *
+     * @see avfilter_link_set_queue_limits()
+     */
+    int max_queued_frames;
+
+    /**
+     * Maximum total size in bytes of the frames queued on each link of the
+     * graph, 0 for no limit.
+     * Same rules as max_queued_frames.
+     */
+    int64_t max_queued_bytes;
+
+    /**
+     * If set, collect the processing statistics returned by
+     * avfilter_get_profile(). This costs two clock reads per activation of
+     * a filter. Must be set before the graph starts processing frames.
+     */
+    int profile;
 } AVFilterGraph;
 
 /**
@@ -943,6 +1048,47 @@ enum {
  */
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx);
 
+/**
+ * Cache of the results of the format negotiation of filter graphs.
+ *
+ * When a graph with a formats cache is configured, the formats lists
+ * declared by its filters are compared with the ones of the graphs
+ * previously configured with the same cache; if the topology of the graph
+ * and all the lists are identical, the negotiated formats are reused
+ * instead of being negotiated again. This makes rebuilding a graph after
+ * a change of the properties of its inputs that does not affect the
+ * formats, for example a change of resolution, much faster.
+ *
+ * This structure is opaque; it is allocated with
+ * avfilter_formats_cache_alloc() and freed with avfilter_formats_cache_free().
+ */
+typedef struct AVFilterFormatsCache AVFilterFormatsCache;
+
+/**
+ * Allocate an empty formats cache.
+ *
+ * @return the allocated cache on success or NULL.
+ */
+AVFilterFormatsCache *avfilter_formats_cache_alloc(void);
+
+/**
+ * Free a formats cache and set *cache to NULL.
+ */
+void avfilter_formats_cache_free(AVFilterFormatsCache **cache);
+
+/**
+ * Use a formats cache for the configuration of a graph.
+ *
+ * Must be called before avfilter_graph_config(). The cache is not owned by
+ * the graph: it can be used by successive graphs and must outlive their
+ * configuration, but must not be used by several graphs concurrently.
+ *
+ * @param graph the filter graph
+ * @param cache the cache to use, or NULL to disable caching
+ */
+void avfilter_graph_set_formats_cache(AVFilterGraph *graph,
+                                      AVFilterFormatsCache *cache);
+
 /**
  * Free a graph, destroy its links, and set *graph to NULL.
  * If *graph is NULL, do nothing.
@@ -1093,12 +1239,75 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
  * Dump a graph into a human-readable string representation.
  *
  * @param graph    the graph to dump
- * @param options  formatting options; currently ignored
+ * @param options  formatting options; "profile" prints the statistics
+ *                 returned by avfilter_get_profile() for each filter and
+ *                 the number of frames queued on each link instead of the
+ *                 structure of the graph; other values are ignored
  * @return  a string, or NULL in case of memory allocation failure;
  *          the string must be freed using av_free
  */
 char *avfilter_graph_dump(AVFilterGraph *graph, const char *options);
 
+/**
+ * Processing statistics of a filter, accumulated since its initialization.
+ * time, nb_activations and nb_allocated_frames are only collected when
+ * AVFilterGraph.profile is set.
+ *
+ * New fields may be added at the end with a minor version bump; the size
+ * of this structure is not part of the public ABI, use
+ * avfilter_get_profile() to fill it.
+ */
+typedef struct AVFilterProfile {
+    /**
+     * Time spent activating the filter, i.e. processing its input frames
+     * and producing its output, in microseconds. Time spent in slice
+     * threads is not included, except the time waiting for them.
+     */
+    int64_t time;
+
+    /**
+     * Number of times the filter was activated.
+     */
+    int64_t nb_activations;
+
+    /**
+     * Number of frames consumed from all the inputs.
+     */
+    int64_t frames_in;
+
+    /**
+     * Number of frames sent on all the outputs.
+     */
+    int64_t frames_out;
+
+    /**
+     * Number of frames currently queued on all the inputs.
+     */
+    int64_t queued_frames;
+
+    /**
+     * Number of frames allocated on the output links of the filter. This
+     * includes the frames allocated by the filter itself, by the filters
+     * before it when it lets them allocate directly on its outputs, and by
+     * the filters after it when they need a writable copy.
+     */
+    int64_t nb_allocated_frames;
+} AVFilterProfile;
+
+/**
+ * Get the processing statistics of a filter.
+ *
+ * This function must not be called while the graph is running in another
+ * thread.
+ *
+ * @param filter   the filter
+ * @param profile  the structure to fill
+ * @param size     sizeof(AVFilterProfile)
+ * @return  >= 0 in case of success, a negative AVERROR code otherwise
+ */
+int avfilter_get_profile(AVFilterContext *filter, AVFilterProfile *profile,
+                         size_t size);
+
 /**
  * Request a frame on the oldest sink link.
  *
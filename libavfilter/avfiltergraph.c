@@ -34,6 +34,8 @@
 
 #include "avfilter.h"
 #include "formats.h"
+#include "framepool.h"
+#include "framequeue.h"
 #include "internal.h"
 #include "thread.h"
 
@@ -43,12 +45,19 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = FLAGS, .unit = "thread_type" },
+        { "pipeline", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_PIPELINE }, .flags = FLAGS, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, FLAGS },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, FLAGS },
+    { "max_queued_frames", "maximum number of frames queued on each link", OFFSET(max_queued_frames),
+        AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "max_queued_bytes",  "maximum size of the frames queued on each link", OFFSET(max_queued_bytes),
+        AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, FLAGS },
+    { "profile", "collect processing statistics for each filter", OFFSET(profile),
+        AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, FLAGS },
     { NULL },
 };
 
@@ -71,6 +80,12 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_pipeline_execute(AVFilterGraph *graph, avfilter_action_func *func,
+                              void *arg, int *ret, int nb_jobs)
+{
+    return AVERROR(ENOSYS);
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -84,6 +99,17 @@ AVFilterGraph *avfilter_graph_alloc(void)
         av_freep(&ret);
         return NULL;
     }
+    if (ff_mutex_init(&ret->internal->ready_lock, NULL)) {
+        av_freep(&ret->internal);
+        av_freep(&ret);
+        return NULL;
+    }
+    if (ff_mutex_init(&ret->internal->frame_pool_lock, NULL)) {
+        ff_mutex_destroy(&ret->internal->ready_lock);
+        av_freep(&ret->internal);
+        av_freep(&ret);
+        return NULL;
+    }
 
     ret->av_class = &filtergraph_class;
     av_opt_set_defaults(ret);
@@ -118,6 +144,14 @@ void avfilter_graph_free(AVFilterGraph **graph)
         avfilter_free((*graph)->filters[0]);
 
     ff_graph_thread_free(*graph);
+    ff_mutex_destroy(&(*graph)->internal->ready_lock);
+    av_freep(&(*graph)->internal->pipeline_wave);
+    av_freep(&(*graph)->internal->pipeline_rets);
+
+    while ((*graph)->internal->nb_frame_pools--)
+        ff_video_frame_pool_uninit(&(*graph)->internal->frame_pools[(*graph)->internal->nb_frame_pools]);
+    av_freep(&(*graph)->internal->frame_pools);
+    ff_mutex_destroy(&(*graph)->internal->frame_pool_lock);
 
     av_freep(&(*graph)->sink_links);
 
@@ -183,6 +217,8 @@ AVFilterContext *avfilter_graph_alloc_filter(AVFilterGraph *graph,
     if (graph->thread_type && !graph->internal->thread_execute) {
         if (graph->execute) {
             graph->internal->thread_execute = graph->execute;
+            /* the pipeline needs a second set of threads */
+            graph->thread_type &= ~AVFILTER_THREAD_PIPELINE;
         } else {
             int ret = ff_graph_thread_init(graph);
             if (ret < 0) {
@@ -299,6 +335,29 @@ static void sanitize_channel_layouts(void *log, AVFilterChannelLayouts *l)
     }
 }
 
+static int formats_declared(AVFilterContext *f)
+{
+    int i;
+
+    for (i = 0; i < f->nb_inputs; i++) {
+        if (!f->inputs[i]->out_formats)
+            return 0;
+        if (f->inputs[i]->type == AVMEDIA_TYPE_AUDIO &&
+            !(f->inputs[i]->out_samplerates &&
+              f->inputs[i]->out_channel_layouts))
+            return 0;
+    }
+    for (i = 0; i < f->nb_outputs; i++) {
+        if (!f->outputs[i]->in_formats)
+            return 0;
+        if (f->outputs[i]->type == AVMEDIA_TYPE_AUDIO &&
+            !(f->outputs[i]->in_samplerates &&
+              f->outputs[i]->in_channel_layouts))
+            return 0;
+    }
+    return 1;
+}
+
 static int filter_query_formats(AVFilterContext *ctx)
 {
     int ret, i;
@@ -321,6 +380,10 @@ static int filter_query_formats(AVFilterContext *ctx)
     for (i = 0; i < ctx->nb_outputs; i++)
         sanitize_channel_layouts(ctx, ctx->outputs[i]->in_channel_layouts);
 
+    /* avoid building the lists of all formats if they are not needed */
+    if (formats_declared(ctx))
+        return 0;
+
     formats = ff_all_formats(type);
     if ((ret = ff_set_common_formats(ctx, formats)) < 0)
         return ret;
@@ -335,29 +398,6 @@ static int filter_query_formats(AVFilterContext *ctx)
     return 0;
 }
 
-static int formats_declared(AVFilterContext *f)
-{
-    int i;
-
-    for (i = 0; i < f->nb_inputs; i++) {
-        if (!f->inputs[i]->out_formats)
-            return 0;
-        if (f->inputs[i]->type == AVMEDIA_TYPE_AUDIO &&
-            !(f->inputs[i]->out_samplerates &&
-              f->inputs[i]->out_channel_layouts))
-            return 0;
-    }
-    for (i = 0; i < f->nb_outputs; i++) {
-        if (!f->outputs[i]->in_formats)
-            return 0;
-        if (f->outputs[i]->type == AVMEDIA_TYPE_AUDIO &&
-            !(f->outputs[i]->in_samplerates &&
-              f->outputs[i]->in_channel_layouts))
-            return 0;
-    }
-    return 1;
-}
-
 static AVFilterFormats *clone_filter_formats(AVFilterFormats *arg)
 {
     AVFilterFormats *a = av_memdup(arg, sizeof(*arg));
@@ -413,6 +453,344 @@ static int can_merge_formats(AVFilterFormats *a_arg,
     }
 }
 
+/**
+ * Insert a scale or aresample filter on a link whose formats lists can not
+ * be merged, and query its formats.
+ * If merge is set, also merge the formats lists on both sides of it.
+ */
+static int insert_convert_filter(AVFilterGraph *graph, AVFilterLink *link,
+                                 int *scaler_count, int *resampler_count,
+                                 int merge, AVClass *log_ctx)
+{
+    AVFilterContext *convert;
+    AVFilter *filter;
+    AVFilterLink *inlink, *outlink;
+    char scale_args[256];
+    char inst_name[30];
+    int ret = 0;
+
+    if (graph->disable_auto_convert) {
+        av_log(log_ctx, AV_LOG_ERROR,
+               "The filters '%s' and '%s' do not have a common format "
+               "and automatic conversion is disabled.\n",
+               link->src->name, link->dst->name);
+        return AVERROR(EINVAL);
+    }
+
+    /* couldn't merge format lists. auto-insert conversion filter */
+    switch (link->type) {
+    case AVMEDIA_TYPE_VIDEO:
+        if (!(filter = avfilter_get_by_name("scale"))) {
+            av_log(log_ctx, AV_LOG_ERROR, "'scale' filter "
+                   "not present, cannot convert pixel formats.\n");
+            return AVERROR(EINVAL);
+        }
+
+        snprintf(inst_name, sizeof(inst_name), "auto-inserted scaler %d",
+                 (*scaler_count)++);
+
+        if ((ret = avfilter_graph_create_filter(&convert, filter,
+                                                inst_name, graph->scale_sws_opts, NULL,
+                                                graph)) < 0)
+            return ret;
+        break;
+    case AVMEDIA_TYPE_AUDIO:
+        if (!(filter = avfilter_get_by_name("aresample"))) {
+            av_log(log_ctx, AV_LOG_ERROR, "'aresample' filter "
+                   "not present, cannot convert audio formats.\n");
+            return AVERROR(EINVAL);
+        }
+
+        snprintf(inst_name, sizeof(inst_name), "auto-inserted resampler %d",
+                 (*resampler_count)++);
+        scale_args[0] = '\0';
+        if (graph->aresample_swr_opts)
+            snprintf(scale_args, sizeof(scale_args), "%s",
+                     graph->aresample_swr_opts);
+        if ((ret = avfilter_graph_create_filter(&convert, filter,
+                                                inst_name, graph->aresample_swr_opts,
+                                                NULL, graph)) < 0)
+            return ret;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    if ((ret = avfilter_insert_filter(link, convert, 0, 0)) < 0)
+        return ret;
+
+    if ((ret = filter_query_formats(convert)) < 0)
+        return ret;
+    if (!merge)
+        return 0;
+
+    inlink  = convert->inputs[0];
+    outlink = convert->outputs[0];
+    av_assert0( inlink-> in_formats->refcount > 0);
+    av_assert0( inlink->out_formats->refcount > 0);
+    av_assert0(outlink-> in_formats->refcount > 0);
+    av_assert0(outlink->out_formats->refcount > 0);
+    if (outlink->type == AVMEDIA_TYPE_AUDIO) {
+        av_assert0( inlink-> in_samplerates->refcount > 0);
+        av_assert0( inlink->out_samplerates->refcount > 0);
+        av_assert0(outlink-> in_samplerates->refcount > 0);
+        av_assert0(outlink->out_samplerates->refcount > 0);
+        av_assert0( inlink-> in_channel_layouts->refcount > 0);
+        av_assert0( inlink->out_channel_layouts->refcount > 0);
+        av_assert0(outlink-> in_channel_layouts->refcount > 0);
+        av_assert0(outlink->out_channel_layouts->refcount > 0);
+    }
+    if (!ff_merge_formats( inlink->in_formats,  inlink->out_formats,  inlink->type) ||
+        !ff_merge_formats(outlink->in_formats, outlink->out_formats, outlink->type))
+        ret = AVERROR(ENOSYS);
+    if (inlink->type == AVMEDIA_TYPE_AUDIO &&
+        (!ff_merge_samplerates(inlink->in_samplerates,
+                               inlink->out_samplerates) ||
+         !ff_merge_channel_layouts(inlink->in_channel_layouts,
+                                   inlink->out_channel_layouts)))
+        ret = AVERROR(ENOSYS);
+    if (outlink->type == AVMEDIA_TYPE_AUDIO &&
+        (!ff_merge_samplerates(outlink->in_samplerates,
+                               outlink->out_samplerates) ||
+         !ff_merge_channel_layouts(outlink->in_channel_layouts,
+                                   outlink->out_channel_layouts)))
+        ret = AVERROR(ENOSYS);
+
+    if (ret < 0) {
+        av_log(log_ctx, AV_LOG_ERROR,
+               "Impossible to convert between the formats supported by the filter "
+               "'%s' and the filter '%s'\n", link->src->name, link->dst->name);
+        return ret;
+    }
+
+    return 0;
+}
+
+/**
+ * Negotiated properties of a link, as stored in a formats cache entry.
+ */
+typedef struct FormatsCacheLink {
+    int format;
+    int sample_rate;
+    uint64_t channel_layout;
+    int channels;
+} FormatsCacheLink;
+
+/**
+ * Result of the format negotiation of a graph.
+ *
+ * The key serializes the topology of the graph, the options of the graph
+ * used by the negotiation and the formats lists declared by all the
+ * filters; two graphs with the same key negotiate the same formats.
+ */
+typedef struct FormatsCacheEntry {
+    char *key;
+    unsigned key_size;
+    int valid;
+
+    /**
+     * Links on which a conversion filter was inserted, as pairs of indexes
+     * of the destination filter in the graph and of its input.
+     */
+    unsigned *converts;
+    int nb_converts;
+
+    /**
+     * Negotiated properties of all the links, in the order of the filters
+     * in the graph and of their inputs.
+     */
+    FormatsCacheLink *links;
+    int nb_links;
+} FormatsCacheEntry;
+
+#define FORMATS_CACHE_SIZE 8
+
+enum FormatsListType {
+    LIST_FORMATS,
+    LIST_SAMPLERATES,
+    LIST_CHANNEL_LAYOUTS,
+};
+
+struct AVFilterFormatsCache {
+    /**
+     * Entries, most recently used first.
+     */
+    FormatsCacheEntry *entries[FORMATS_CACHE_SIZE];
+    int nb_entries;
+};
+
+AVFilterFormatsCache *avfilter_formats_cache_alloc(void)
+{
+    return av_mallocz(sizeof(AVFilterFormatsCache));
+}
+
+static void formats_cache_entry_free(FormatsCacheEntry **entry)
+{
+    if (!*entry)
+        return;
+    av_freep(&(*entry)->key);
+    av_freep(&(*entry)->converts);
+    av_freep(&(*entry)->links);
+    av_freep(entry);
+}
+
+void avfilter_formats_cache_free(AVFilterFormatsCache **cache)
+{
+    int i;
+
+    if (!*cache)
+        return;
+    for (i = 0; i < (*cache)->nb_entries; i++)
+        formats_cache_entry_free(&(*cache)->entries[i]);
+    av_freep(cache);
+}
+
+void avfilter_graph_set_formats_cache(AVFilterGraph *graph,
+                                      AVFilterFormatsCache *cache)
+{
+    graph->internal->formats_cache = cache;
+}
+
+static int formats_cache_add_convert(FormatsCacheEntry *entry,
+                                     unsigned filter, unsigned input)
+{
+    unsigned *converts = av_realloc_array(entry->converts, entry->nb_converts + 1,
+                                          2 * sizeof(*converts));
+    if (!converts)
+        return AVERROR(ENOMEM);
+    converts[2 * entry->nb_converts    ] = filter;
+    converts[2 * entry->nb_converts + 1] = input;
+    entry->converts = converts;
+    entry->nb_converts++;
+    return 0;
+}
+
+static void key_append(AVBPrint *key, const void *buf, size_t size)
+{
+    av_bprint_append_data(key, buf, size);
+}
+
+static void key_append_int(AVBPrint *key, int64_t val)
+{
+    key_append(key, &val, sizeof(val));
+}
+
+static void key_append_str(AVBPrint *key, const char *str)
+{
+    if (!str)
+        str = "";
+    key_append(key, str, strlen(str) + 1);
+}
+
+static void key_append_formats(AVBPrint *key, AVFilterFormats *f)
+{
+    key_append_int(key, f ? f->nb_formats : -1);
+    if (f && f->nb_formats)
+        key_append(key, f->formats, f->nb_formats * sizeof(*f->formats));
+}
+
+static void key_append_layouts(AVBPrint *key, AVFilterChannelLayouts *l)
+{
+    key_append_int(key, l ? l->nb_channel_layouts : -1);
+    if (!l)
+        return;
+    key_append_int(key, l->all_layouts | l->all_counts << 1);
+    if (l->nb_channel_layouts)
+        key_append(key, l->channel_layouts,
+                   l->nb_channel_layouts * sizeof(*l->channel_layouts));
+}
+
+static void key_append_list(AVBPrint *key, void *list, enum FormatsListType type)
+{
+    if (type == LIST_CHANNEL_LAYOUTS)
+        key_append_layouts(key, list);
+    else
+        key_append_formats(key, list);
+}
+
+/**
+ * Serialize everything the format negotiation of the graph depends on.
+ * On success, key must be released with av_bprint_finalize().
+ */
+static int graph_key(AVFilterGraph *graph, AVBPrint *key)
+{
+    void **lists = NULL;
+    enum FormatsListType *types = NULL;
+    unsigned nb_lists = 0;
+    int i, j, k;
+
+    av_bprint_init(key, 0, AV_BPRINT_SIZE_UNLIMITED);
+    key_append_str(key, graph->scale_sws_opts);
+    key_append_str(key, graph->aresample_swr_opts);
+    key_append_int(key, graph->disable_auto_convert);
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        unsigned nb = 0;
+
+        key_append_str(key, f->filter->name);
+        key_append_str(key, f->name);
+        key_append_int(key, f->nb_inputs);
+        key_append_int(key, f->nb_outputs);
+
+        if (3 * (f->nb_inputs + f->nb_outputs) > nb_lists) {
+            nb_lists = 3 * (f->nb_inputs + f->nb_outputs);
+            av_freep(&lists);
+            av_freep(&types);
+            lists = av_malloc_array(nb_lists, sizeof(*lists));
+            types = av_malloc_array(nb_lists, sizeof(*types));
+            if (!lists || !types) {
+                av_freep(&lists);
+                av_freep(&types);
+                av_bprint_finalize(key, NULL);
+                return AVERROR(ENOMEM);
+            }
+        }
+
+#define ADD_LIST(list, type) do { lists[nb] = list; types[nb++] = type; } while (0)
+        for (j = 0; j < f->nb_inputs; j++) {
+            AVFilterLink *link = f->inputs[j];
+
+            key_append_str(key, link->src->name);
+            key_append_int(key, link->srcpad - link->src->output_pads);
+            key_append_int(key, link->type);
+            ADD_LIST(link->out_formats, LIST_FORMATS);
+            if (link->type == AVMEDIA_TYPE_AUDIO) {
+                ADD_LIST(link->out_samplerates,     LIST_SAMPLERATES);
+                ADD_LIST(link->out_channel_layouts, LIST_CHANNEL_LAYOUTS);
+            }
+        }
+        for (j = 0; j < f->nb_outputs; j++) {
+            AVFilterLink *link = f->outputs[j];
+
+            ADD_LIST(link->in_formats, LIST_FORMATS);
+            if (link->type == AVMEDIA_TYPE_AUDIO) {
+                ADD_LIST(link->in_samplerates,     LIST_SAMPLERATES);
+                ADD_LIST(link->in_channel_layouts, LIST_CHANNEL_LAYOUTS);
+            }
+        }
+#undef ADD_LIST
+
+        /* Every list is declared by exactly one filter. Lists shared by
+           several pads of a filter change how the formats propagate when
+           merging: record the sharing and hash the contents only once. */
+        for (j = 0; j < nb; j++) {
+            for (k = 0; k < j && lists[k] != lists[j]; k++);
+            key_append_int(key, k);
+            if (k == j)
+                key_append_list(key, lists[j], types[j]);
+        }
+    }
+
+    av_free(lists);
+    av_free(types);
+    if (!av_bprint_is_complete(key)) {
+        av_bprint_finalize(key, NULL);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
 /**
  * Perform one round of query_formats() and merging formats lists on the
  * filter graph.
@@ -422,8 +800,10 @@ static int can_merge_formats(AVFilterFormats *a_arg,
  *          AVERROR(EIO) (may be changed) plus a log message if no progress
  *          was made and the negotiation is stuck;
  *          a negative error code if some other error happened
+ * If entry is not NULL, the conversion filters inserted are recorded in it.
  */
-static int query_formats(AVFilterGraph *graph, AVClass *log_ctx)
+static int query_formats(AVFilterGraph *graph, FormatsCacheEntry *entry,
+                         AVClass *log_ctx)
 {
     int i, j, ret;
     int scaler_count = 0, resampler_count = 0;
@@ -501,103 +881,11 @@ static int query_formats(AVFilterGraph *graph, AVClass *log_ctx)
 #undef MERGE_DISPATCH
 
             if (convert_needed) {
-                AVFilterContext *convert;
-                AVFilter *filter;
-                AVFilterLink *inlink, *outlink;
-                char scale_args[256];
-                char inst_name[30];
-
-                if (graph->disable_auto_convert) {
-                    av_log(log_ctx, AV_LOG_ERROR,
-                           "The filters '%s' and '%s' do not have a common format "
-                           "and automatic conversion is disabled.\n",
-                           link->src->name, link->dst->name);
-                    return AVERROR(EINVAL);
-                }
-
-                /* couldn't merge format lists. auto-insert conversion filter */
-                switch (link->type) {
-                case AVMEDIA_TYPE_VIDEO:
-                    if (!(filter = avfilter_get_by_name("scale"))) {
-                        av_log(log_ctx, AV_LOG_ERROR, "'scale' filter "
-                               "not present, cannot convert pixel formats.\n");
-                        return AVERROR(EINVAL);
-                    }
-
-                    snprintf(inst_name, sizeof(inst_name), "auto-inserted scaler %d",
-                             scaler_count++);
-
-                    if ((ret = avfilter_graph_create_filter(&convert, filter,
-                                                            inst_name, graph->scale_sws_opts, NULL,
-                                                            graph)) < 0)
-                        return ret;
-                    break;
-                case AVMEDIA_TYPE_AUDIO:
-                    if (!(filter = avfilter_get_by_name("aresample"))) {
-                        av_log(log_ctx, AV_LOG_ERROR, "'aresample' filter "
-                               "not present, cannot convert audio formats.\n");
-                        return AVERROR(EINVAL);
-                    }
-
-                    snprintf(inst_name, sizeof(inst_name), "auto-inserted resampler %d",
-                             resampler_count++);
-                    scale_args[0] = '\0';
-                    if (graph->aresample_swr_opts)
-                        snprintf(scale_args, sizeof(scale_args), "%s",
-                                 graph->aresample_swr_opts);
-                    if ((ret = avfilter_graph_create_filter(&convert, filter,
-                                                            inst_name, graph->aresample_swr_opts,
-                                                            NULL, graph)) < 0)
-                        return ret;
-                    break;
-                default:
-                    return AVERROR(EINVAL);
-                }
-
-                if ((ret = avfilter_insert_filter(link, convert, 0, 0)) < 0)
+                if ((ret = insert_convert_filter(graph, link, &scaler_count,
+                                                 &resampler_count, 1, log_ctx)) < 0)
                     return ret;
-
-                if ((ret = filter_query_formats(convert)) < 0)
+                if (entry && (ret = formats_cache_add_convert(entry, i, j)) < 0)
                     return ret;
-
-                inlink  = convert->inputs[0];
-                outlink = convert->outputs[0];
-                av_assert0( inlink-> in_formats->refcount > 0);
-                av_assert0( inlink->out_formats->refcount > 0);
-                av_assert0(outlink-> in_formats->refcount > 0);
-                av_assert0(outlink->out_formats->refcount > 0);
-                if (outlink->type == AVMEDIA_TYPE_AUDIO) {
-                    av_assert0( inlink-> in_samplerates->refcount > 0);
-                    av_assert0( inlink->out_samplerates->refcount > 0);
-                    av_assert0(outlink-> in_samplerates->refcount > 0);
-                    av_assert0(outlink->out_samplerates->refcount > 0);
-                    av_assert0( inlink-> in_channel_layouts->refcount > 0);
-                    av_assert0( inlink->out_channel_layouts->refcount > 0);
-                    av_assert0(outlink-> in_channel_layouts->refcount > 0);
-                    av_assert0(outlink->out_channel_layouts->refcount > 0);
-                }
-                if (!ff_merge_formats( inlink->in_formats,  inlink->out_formats,  inlink->type) ||
-                    !ff_merge_formats(outlink->in_formats, outlink->out_formats, outlink->type))
-                    ret = AVERROR(ENOSYS);
-                if (inlink->type == AVMEDIA_TYPE_AUDIO &&
-                    (!ff_merge_samplerates(inlink->in_samplerates,
-                                           inlink->out_samplerates) ||
-                     !ff_merge_channel_layouts(inlink->in_channel_layouts,
-                                               inlink->out_channel_layouts)))
-                    ret = AVERROR(ENOSYS);
-                if (outlink->type == AVMEDIA_TYPE_AUDIO &&
-                    (!ff_merge_samplerates(outlink->in_samplerates,
-                                           outlink->out_samplerates) ||
-                     !ff_merge_channel_layouts(outlink->in_channel_layouts,
-                                               outlink->out_channel_layouts)))
-                    ret = AVERROR(ENOSYS);
-
-                if (ret < 0) {
-                    av_log(log_ctx, AV_LOG_ERROR,
-                           "Impossible to convert between the formats supported by the filter "
-                           "'%s' and the filter '%s'\n", link->src->name, link->dst->name);
-                    return ret;
-                }
             }
         }
     }
@@ -1141,24 +1429,157 @@ static int pick_formats(AVFilterGraph *graph)
     return 0;
 }
 
+/**
+ * Query the formats of all the filters and look the graph up in the cache.
+ * @return  1 if the negotiation result was found in the cache and applied;
+ *          0 if the negotiation must be done, with *entry set to a new
+ *          entry to fill if the result can be cached;
+ *          a negative error code if some other error happened
+ */
+static int formats_cache_lookup(AVFilterGraph *graph, AVFilterFormatsCache *cache,
+                                FormatsCacheEntry **entry, AVClass *log_ctx)
+{
+    int scaler_count = 0, resampler_count = 0;
+    AVBPrint key;
+    FormatsCacheEntry *e = NULL;
+    int i, j, n = 0, ret;
+
+    *entry = NULL;
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        if (formats_declared(f))
+            continue;
+        if (f->filter->query_formats)
+            ret = filter_query_formats(f);
+        else
+            ret = ff_default_query_formats(f);
+        /* the formats of this filter depend on its neighbours: only the
+           complete negotiation can tell */
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret < 0)
+            return ret;
+    }
+
+    if ((ret = graph_key(graph, &key)) < 0)
+        return ret;
+    for (i = 0; i < cache->nb_entries; i++) {
+        if (cache->entries[i]->key_size == key.len &&
+            !memcmp(cache->entries[i]->key, key.str, key.len)) {
+            e = cache->entries[i];
+            memmove(cache->entries + 1, cache->entries, i * sizeof(*cache->entries));
+            cache->entries[0] = e;
+            break;
+        }
+    }
+    if (!e) {
+        if (!(e = av_mallocz(sizeof(*e)))) {
+            av_bprint_finalize(&key, NULL);
+            return AVERROR(ENOMEM);
+        }
+        e->key_size = key.len;
+        if ((ret = av_bprint_finalize(&key, &e->key)) < 0) {
+            av_free(e);
+            return ret;
+        }
+        *entry = e;
+        return 0;
+    }
+    av_bprint_finalize(&key, NULL);
+
+    av_log(graph, AV_LOG_DEBUG, "Reusing the formats of a previous negotiation\n");
+    for (i = 0; i < e->nb_converts; i++) {
+        AVFilterLink *link = graph->filters[e->converts[2 * i]]->inputs[e->converts[2 * i + 1]];
+        if ((ret = insert_convert_filter(graph, link, &scaler_count,
+                                         &resampler_count, 0, log_ctx)) < 0)
+            return ret;
+    }
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        for (j = 0; j < f->nb_inputs; j++) {
+            AVFilterLink *link = f->inputs[j];
+            const FormatsCacheLink *l = &e->links[n++];
+
+            av_assert0(n <= e->nb_links);
+            link->format         = l->format;
+            link->sample_rate    = l->sample_rate;
+            link->channel_layout = l->channel_layout;
+            link->channels       = l->channels;
+            ff_formats_unref(&link->in_formats);
+            ff_formats_unref(&link->out_formats);
+            ff_formats_unref(&link->in_samplerates);
+            ff_formats_unref(&link->out_samplerates);
+            ff_channel_layouts_unref(&link->in_channel_layouts);
+            ff_channel_layouts_unref(&link->out_channel_layouts);
+        }
+    }
+    av_assert0(n == e->nb_links);
+    return 1;
+}
+
+/**
+ * Record the negotiated formats in a new cache entry and add it to the cache.
+ */
+static int formats_cache_store(AVFilterGraph *graph, AVFilterFormatsCache *cache,
+                               FormatsCacheEntry *entry)
+{
+    int i, j, n = 0;
+
+    for (i = 0; i < graph->nb_filters; i++)
+        n += graph->filters[i]->nb_inputs;
+    if (!(entry->links = av_malloc_array(n, sizeof(*entry->links)))) {
+        formats_cache_entry_free(&entry);
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        for (j = 0; j < f->nb_inputs; j++) {
+            FormatsCacheLink *l = &entry->links[entry->nb_links++];
+
+            l->format         = f->inputs[j]->format;
+            l->sample_rate    = f->inputs[j]->sample_rate;
+            l->channel_layout = f->inputs[j]->channel_layout;
+            l->channels       = f->inputs[j]->channels;
+        }
+    }
+
+    if (cache->nb_entries == FORMATS_CACHE_SIZE)
+        formats_cache_entry_free(&cache->entries[--cache->nb_entries]);
+    memmove(cache->entries + 1, cache->entries,
+            cache->nb_entries * sizeof(*cache->entries));
+    cache->entries[0] = entry;
+    cache->nb_entries++;
+    return 0;
+}
+
 /**
  * Configure the formats of all the links in the graph.
  */
 static int graph_config_formats(AVFilterGraph *graph, AVClass *log_ctx)
 {
+    AVFilterFormatsCache *cache = graph->internal->formats_cache;
+    FormatsCacheEntry *entry = NULL;
     int ret;
 
+    if (cache && (ret = formats_cache_lookup(graph, cache, &entry, log_ctx)))
+        return FFMIN(ret, 0);
+
     /* find supported formats from sub-filters, and merge along links */
-    while ((ret = query_formats(graph, log_ctx)) == AVERROR(EAGAIN))
+    while ((ret = query_formats(graph, entry, log_ctx)) == AVERROR(EAGAIN)) {
         av_log(graph, AV_LOG_DEBUG, "query_formats not finished\n");
+        /* the recorded conversions are only valid for a single round */
+        formats_cache_entry_free(&entry);
+    }
     if (ret < 0)
-        return ret;
+        goto fail;
 
     /* Once everything is merged, it's possible that we'll still have
      * multiple valid media format choices. We try to minimize the amount
      * of format conversion inside filters */
     if ((ret = reduce_formats(graph)) < 0)
-        return ret;
+        goto fail;
 
     /* for audio filters, ensure the best format, sample rate and channel layout
      * is selected */
@@ -1167,9 +1588,15 @@ static int graph_config_formats(AVFilterGraph *graph, AVClass *log_ctx)
     swap_channel_layouts(graph);
 
     if ((ret = pick_formats(graph)) < 0)
-        return ret;
+        goto fail;
 
+    if (entry)
+        return formats_cache_store(graph, cache, entry);
     return 0;
+
+fail:
+    formats_cache_entry_free(&entry);
+    return ret;
 }
 
 static int graph_config_pointers(AVFilterGraph *graph,
@@ -1214,6 +1641,24 @@ static int graph_config_pointers(AVFilterGraph *graph,
     return 0;
 }
 
+static int graph_config_pipeline(AVFilterGraph *graph)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+
+    if (!gi->pipeline)
+        return 0;
+    av_freep(&gi->pipeline_wave);
+    av_freep(&gi->pipeline_rets);
+    gi->pipeline_wave = av_malloc_array(graph->nb_filters, sizeof(*gi->pipeline_wave));
+    gi->pipeline_rets = av_malloc_array(graph->nb_filters, sizeof(*gi->pipeline_rets));
+    if (!gi->pipeline_wave || !gi->pipeline_rets) {
+        av_freep(&gi->pipeline_wave);
+        av_freep(&gi->pipeline_rets);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
 static int graph_insert_fifos(AVFilterGraph *graph, AVClass *log_ctx)
 {
     AVFilterContext *f;
@@ -1252,6 +1697,28 @@ static int graph_insert_fifos(AVFilterGraph *graph, AVClass *log_ctx)
     return 0;
 }
 
+/**
+ * Apply the default queue limits of the graph to the links that have none.
+ */
+static void graph_config_queue_limits(AVFilterGraph *graph)
+{
+    unsigned i, j;
+
+    graph->internal->bounded_queues = 0;
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        for (j = 0; j < filter->nb_outputs; j++) {
+            AVFilterLink *link = filter->outputs[j];
+            if (!link->max_queued_frames)
+                link->max_queued_frames = graph->max_queued_frames;
+            if (!link->max_queued_bytes)
+                link->max_queued_bytes = graph->max_queued_bytes;
+            if (link->max_queued_frames || link->max_queued_bytes)
+                graph->internal->bounded_queues = 1;
+        }
+    }
+}
+
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
 {
     int ret;
@@ -1266,6 +1733,9 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    if ((ret = graph_config_pipeline(graphctx)) < 0)
+        return ret;
+    graph_config_queue_limits(graphctx);
 
     return 0;
 }
@@ -1381,8 +1851,10 @@ void ff_avfilter_graph_update_heap(AVFilterGraph *graph, AVFilterLink *link)
 int avfilter_graph_request_oldest(AVFilterGraph *graph)
 {
     AVFilterLink *oldest = graph->sink_links[0];
+    int64_t frame_count;
     int r;
 
+retry:
     while (graph->sink_links_count) {
         oldest = graph->sink_links[0];
         r = ff_request_frame(oldest);
@@ -1400,49 +1872,132 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     if (!graph->sink_links_count)
         return AVERROR_EOF;
     av_assert1(oldest->age_index >= 0);
-    while (oldest->frame_wanted_out) {
+    frame_count = oldest->frame_count_out;
+    /* stop as soon as a frame has reached the sink: a sink with a bounded
+       input only takes it from the link when the application reads it */
+    while (frame_count == oldest->frame_count_out &&
+           !ff_framequeue_queued_frames(oldest->fifo)) {
         r = ff_filter_graph_run_once(graph);
-        if (r < 0)
+        if (r == AVERROR(EAGAIN) &&
+            !oldest->frame_wanted_out && !oldest->frame_blocked_in) {
+            /* the request was satisfied elsewhere or the link status
+               changed: ask again */
+            if (oldest->status_in)
+                goto retry;
+            ff_request_frame(oldest);
+        } else if (r < 0) {
             return r;
+        }
     }
     return 0;
 }
 
-static AVFilterLink *graph_run_once_find_filter(AVFilterGraph *graph)
+static int pipeline_activate(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    unsigned i, j;
-    AVFilterContext *f;
+    AVFilterContext **wave = arg;
 
-    /* TODO: replace scanning the graph with a priority list */
+    return ff_filter_activate(wave[jobnr]);
+}
+
+/**
+ * Check if a filter can be activated while the filters already selected
+ * for the current wave are running.
+ *
+ * Two filters sharing a link must not run at the same time, since both
+ * access the queue, status and frame pool of the link; this leaves every
+ * link, frame pool and filter private context to a single thread.
+ * Sinks update the heap of sink links, so only one sink runs at a time.
+ */
+static int pipeline_can_join(AVFilterContext *filter, int sink_selected)
+{
+    unsigned i;
+
+    if (!(filter->thread_type & AVFILTER_THREAD_PIPELINE))
+        return 0;
+    if (!filter->nb_outputs && sink_selected)
+        return 0;
+    for (i = 0; i < filter->nb_inputs; i++)
+        if (filter->inputs[i]->src->internal->pipeline_selected)
+            return 0;
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i]->dst->internal->pipeline_selected)
+            return 0;
+    return 1;
+}
+
+/**
+ * Check if a filter must wait for one of its outputs to be consumed
+ * before producing more frames.
+ */
+static int filter_outputs_full(AVFilterContext *filter)
+{
+    unsigned i;
+
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (ff_link_queue_full(filter->outputs[i]))
+            return 1;
+    return 0;
+}
+
+/**
+ * Activate the given filter together with all the other ready filters
+ * that can run concurrently with it.
+ */
+static int pipeline_run_once(AVFilterGraph *graph, AVFilterContext *first)
+{
+    AVFilterContext **wave = graph->internal->pipeline_wave;
+    int *rets = graph->internal->pipeline_rets;
+    int nb_wave = 0, sink_selected, ret = 0;
+    unsigned i;
+
+    wave[nb_wave++] = first;
+    first->internal->pipeline_selected = 1;
+    sink_selected = !first->nb_outputs;
     for (i = 0; i < graph->nb_filters; i++) {
-        f = graph->filters[i];
-        for (j = 0; j < f->nb_outputs; j++)
-            if (f->outputs[j]->frame_wanted_in)
-                return f->outputs[j];
+        AVFilterContext *filter = graph->filters[i];
+        if (!filter->internal->ready || filter->internal->pipeline_selected ||
+            !pipeline_can_join(filter, sink_selected) ||
+            (graph->internal->bounded_queues && filter_outputs_full(filter)))
+            continue;
+        wave[nb_wave++] = filter;
+        filter->internal->pipeline_selected = 1;
+        sink_selected |= !filter->nb_outputs;
     }
-    for (i = 0; i < graph->nb_filters; i++) {
-        f = graph->filters[i];
-        for (j = 0; j < f->nb_outputs; j++)
-            if (f->outputs[j]->frame_wanted_out)
-                return f->outputs[j];
+
+    if (nb_wave == 1) {
+        ret = ff_filter_activate(first);
+    } else {
+        graph->internal->pipeline_running = 1;
+        ff_graph_pipeline_execute(graph, pipeline_activate, wave, rets, nb_wave);
+        graph->internal->pipeline_running = 0;
+        for (i = 0; i < nb_wave; i++)
+            if (rets[i] < 0 && ret >= 0)
+                ret = rets[i];
     }
-    return NULL;
+
+    for (i = 0; i < nb_wave; i++)
+        wave[i]->internal->pipeline_selected = 0;
+    return ret;
 }
 
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
-    AVFilterLink *link;
-    int ret;
+    AVFilterContext *filter = NULL;
+    unsigned i, ready = 0;
 
-    link = graph_run_once_find_filter(graph);
-    if (!link) {
-        av_log(NULL, AV_LOG_WARNING, "Useless run of a filter graph\n");
-        return AVERROR(EAGAIN);
+    av_assert0(graph->nb_filters);
+    /* TODO: replace scanning the graph with a priority list */
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        if (f->internal->ready > ready &&
+            !(graph->internal->bounded_queues && filter_outputs_full(f))) {
+            filter = f;
+            ready  = f->internal->ready;
+        }
     }
-    ret = ff_request_frame_to_filter(link);
-    if (ret == AVERROR_EOF)
-        /* local EOF will be forwarded through request_frame() /
-           set_status() until it reaches the sink */
-        ret = 0;
-    return ret < 0 ? ret : 1;
+    if (!filter)
+        return AVERROR(EAGAIN);
+    if (graph->internal->pipeline_wave && pipeline_can_join(filter, 0))
+        return pipeline_run_once(graph, filter);
+    return ff_filter_activate(filter);
 }
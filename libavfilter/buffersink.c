@@ -34,6 +34,7 @@
 #include "audio.h"
 #include "avfilter.h"
 #include "buffersink.h"
+#include "framequeue.h"
 #include "internal.h"
 
 typedef struct BufferSinkContext {
@@ -59,6 +60,8 @@ typedef struct BufferSinkContext {
     /* only used for compat API */
     AVAudioFifo *audio_fifo;     ///< FIFO for audio samples
     int64_t next_pts;            ///< interpolating audio pts
+
+    int reading;                 ///< set while the application reads a frame
 } BufferSinkContext;
 
 #define NB_ITEMS(list) (list ## _size / sizeof(*list))
@@ -134,8 +137,21 @@ int attribute_align_arg av_buffersink_get_frame_flags(AVFilterContext *ctx, AVFr
 
     /* no picref available, fetch it from the filterchain */
     while (!av_fifo_size(buf->fifo)) {
-        if (inlink->status)
-            return inlink->status;
+        if (ff_framequeue_queued_frames(inlink->fifo) ||
+            (inlink->status_in && inlink->partial_buf)) {
+            /* frames have already reached the sink: filter them */
+            buf->reading = 1;
+            ret = ff_filter_activate(ctx);
+            buf->reading = 0;
+            if (ret < 0)
+                return ret;
+            continue;
+        }
+        if (inlink->status_out)
+            return inlink->status_out;
+        if (inlink->status_in)
+            /* acknowledge the status change */
+            return ff_request_frame(inlink);
         if (flags & AV_BUFFERSINK_FLAG_NO_REQUEST)
             return AVERROR(EAGAIN);
         if ((ret = ff_request_frame(inlink)) < 0)
@@ -160,6 +176,18 @@ int attribute_align_arg av_buffersink_get_frame_flags(AVFilterContext *ctx, AVFr
     return 0;
 }
 
+static int activate(AVFilterContext *ctx)
+{
+    BufferSinkContext *buf = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+
+    /* With a bounded input, leave the frames on the link until the
+       application reads them, so that they count against its limits. */
+    if (!buf->reading && (inlink->max_queued_frames || inlink->max_queued_bytes))
+        return 0;
+    return ff_filter_activate_default(ctx);
+}
+
 static int read_from_fifo(AVFilterContext *ctx, AVFrame *frame,
                           int nb_samples)
 {
@@ -425,6 +453,7 @@ AVFilter ff_vsink_buffer = {
     .priv_class  = &buffersink_class,
     .init_opaque = vsink_init,
     .uninit      = uninit,
+    .activate    = activate,
 
     .query_formats = vsink_query_formats,
     .inputs      = avfilter_vsink_buffer_inputs,
@@ -447,6 +476,7 @@ AVFilter ff_asink_abuffer = {
     .priv_size   = sizeof(BufferSinkContext),
     .init_opaque = asink_init,
     .uninit      = uninit,
+    .activate    = activate,
 
     .query_formats = asink_query_formats,
     .inputs      = avfilter_asink_abuffer_inputs,
@@ -115,7 +115,9 @@ AVRational av_buffersink_get_frame_rate(AVFilterContext *ctx);
  * @return
  *         - >= 0 if a frame was successfully returned.
  *         - AVERROR(EAGAIN) if no frames are available at this point; more
- *           input frames must be added to the filtergraph to get more output.
+ *           input frames must be added to the filtergraph to get more output,
+ *           or, if some links of the graph have a bounded queue, frames
+ *           must be read from the other sinks.
  *         - AVERROR_EOF if there will be no more output frames on this sink.
  *         - A different negative AVERROR code in other failure cases.
  */
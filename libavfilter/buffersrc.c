@@ -65,6 +65,9 @@ typedef struct BufferSourceContext {
 
     int got_format_from_params;
     int eof;
+
+    int max_queued_frames;
+    int64_t max_queued_bytes;
 } BufferSourceContext;
 
 #define CHECK_VIDEO_PARAM_CHANGE(s, c, width, height, format)\
@@ -173,6 +176,20 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
     return ret;
 }
 
+static int push_frame(AVFilterGraph *graph)
+{
+    int ret;
+
+    while (1) {
+        ret = ff_filter_graph_run_once(graph);
+        if (ret == AVERROR(EAGAIN))
+            break;
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static int av_buffersrc_add_frame_internal(AVFilterContext *ctx,
                                            AVFrame *frame, int flags)
 {
@@ -184,10 +201,24 @@ static int av_buffersrc_add_frame_internal(AVFilterContext *ctx,
 
     if (!frame) {
         s->eof = 1;
+        ff_avfilter_link_set_in_status(ctx->outputs[0], AVERROR_EOF, AV_NOPTS_VALUE);
+        if ((flags & AV_BUFFERSRC_FLAG_PUSH)) {
+            ret = push_frame(ctx->graph);
+            if (ret < 0)
+                return ret;
+        }
         return 0;
     } else if (s->eof)
         return AVERROR(EINVAL);
 
+    /* the output queue is full: try to make room by running the graph,
+       the caller has to consume frames from the sinks if that fails */
+    while (ff_link_queue_full(ctx->outputs[0])) {
+        ret = ff_filter_graph_run_once(ctx->graph);
+        if (ret < 0)
+            return ret;
+    }
+
     refcounted = !!frame->buf[0];
 
     if (!(flags & AV_BUFFERSRC_FLAG_NO_CHECK_FORMAT)) {
@@ -235,9 +266,16 @@ static int av_buffersrc_add_frame_internal(AVFilterContext *ctx,
         return ret;
     }
 
-    if ((flags & AV_BUFFERSRC_FLAG_PUSH))
-        if ((ret = ctx->output_pads[0].request_frame(ctx->outputs[0])) < 0)
+    /* queue the frame on the link right away, so that a pending request
+       is satisfied even without AV_BUFFERSRC_FLAG_PUSH */
+    if ((ret = ctx->output_pads[0].request_frame(ctx->outputs[0])) < 0)
+        return ret;
+
+    if ((flags & AV_BUFFERSRC_FLAG_PUSH)) {
+        ret = push_frame(ctx->graph);
+        if (ret < 0)
             return ret;
+    }
 
     return 0;
 }
@@ -290,6 +328,8 @@ static const AVOption buffer_options[] = {
     { "time_base",     NULL,                     OFFSET(time_base),        AV_OPT_TYPE_RATIONAL, { .dbl = 0 }, 0, DBL_MAX, V },
     { "frame_rate",    NULL,                     OFFSET(frame_rate),       AV_OPT_TYPE_RATIONAL, { .dbl = 0 }, 0, DBL_MAX, V },
     { "sws_param",     NULL,                     OFFSET(sws_param),        AV_OPT_TYPE_STRING,                    .flags = V },
+    { "max_queued_frames", "maximum number of frames queued on the output", OFFSET(max_queued_frames), AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX,   V },
+    { "max_queued_bytes",  "maximum size of the frames queued on the output", OFFSET(max_queued_bytes), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, V },
     { NULL },
 };
 
@@ -301,6 +341,8 @@ static const AVOption abuffer_options[] = {
     { "sample_fmt",     NULL, OFFSET(sample_fmt),          AV_OPT_TYPE_SAMPLE_FMT, { .i64 = AV_SAMPLE_FMT_NONE }, .min = AV_SAMPLE_FMT_NONE, .max = INT_MAX, .flags = A },
     { "channel_layout", NULL, OFFSET(channel_layout_str),  AV_OPT_TYPE_STRING,             .flags = A },
     { "channels",       NULL, OFFSET(channels),            AV_OPT_TYPE_INT,      { .i64 = 0 }, 0, INT_MAX, A },
+    { "max_queued_frames", "maximum number of frames queued on the output", OFFSET(max_queued_frames), AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX,   A },
+    { "max_queued_bytes",  "maximum size of the frames queued on the output", OFFSET(max_queued_bytes), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, A },
     { NULL },
 };
 
@@ -430,6 +472,9 @@ static int config_props(AVFilterLink *link)
 
     link->time_base = c->time_base;
     link->frame_rate = c->frame_rate;
+    if (c->max_queued_frames || c->max_queued_bytes)
+        avfilter_link_set_queue_limits(link, c->max_queued_frames,
+                                       c->max_queued_bytes);
     return 0;
 }
 
@@ -188,7 +188,12 @@ int av_buffersrc_add_frame(AVFilterContext *ctx, AVFrame *frame);
  * @param frame       a frame, or NULL to mark EOF
  * @param flags       a combination of AV_BUFFERSRC_FLAG_*
  * @return            >= 0 in case of success, a negative AVERROR code
- *                    in case of failure
+ *                    in case of failure;
+ *                    AVERROR(EAGAIN) if the queue of the output link is
+ *                    full (see the max_queued_frames and max_queued_bytes
+ *                    options) and the graph can not make progress without
+ *                    frames being read from its sinks; the frame is then
+ *                    left untouched
  */
 av_warn_unused_result
 int av_buffersrc_add_frame_flags(AVFilterContext *buffer_src,
@@ -173,6 +173,18 @@ void ff_copy_rectangle(uint8_t *dst[4], int dst_linesize[4],
     }
 }
 
+static void blend_row_8(uint8_t *dst, const uint8_t *mask, int w,
+                        unsigned src, unsigned alpha)
+{
+    int x;
+
+    for (x = 0; x < w; x++) {
+        unsigned a = mask[x] * alpha;
+        if (a)
+            dst[x] = ((0x1010101 - a) * dst[x] + a * src) >> 24;
+    }
+}
+
 int ff_draw_init(FFDrawContext *draw, enum AVPixelFormat format, unsigned flags)
 {
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
@@ -532,7 +544,10 @@ static void blend_pixel16(uint8_t *dst, unsigned src, unsigned alpha,
         }
         mask += mask_linesize;
     }
-    alpha = (t >> shift) * alpha;
+    t >>= shift;
+    if (!t)
+        return;
+    alpha = t * alpha;
     AV_WL16(dst, ((0x10001 - alpha) * value + alpha * src) >> 16);
 }
 
@@ -555,7 +570,10 @@ static void blend_pixel(uint8_t *dst, unsigned src, unsigned alpha,
         }
         mask += mask_linesize;
     }
-    alpha = (t >> shift) * alpha;
+    t >>= shift;
+    if (!t)
+        return;
+    alpha = t * alpha;
     *dst = ((0x1010101 - alpha) * *dst + alpha * src) >> 24;
 }
 
@@ -666,7 +684,16 @@ void ff_blend_mask(FFDrawContext *draw, FFDrawColor *color,
                 p += dst_linesize[plane];
                 m += top * mask_linesize;
             }
-            if (depth <= 8) {
+            if (depth <= 8 && l2depth == 3 && draw->pixelstep[plane] == 1 &&
+                !draw->hsub[plane] && !draw->vsub[plane]) {
+                for (y = 0; y < h_sub; y++) {
+                    const uint8_t src = color->comp[plane].u8[comp];
+
+                    blend_row_8(p, m + xm0, w_sub, src, alpha);
+                    p += dst_linesize[plane];
+                    m += mask_linesize;
+                }
+            } else if (depth <= 8) {
                 for (y = 0; y < h_sub; y++) {
                     blend_line_hv(p, draw->pixelstep[plane],
                                   color->comp[plane].u8[comp], alpha,
@@ -706,6 +733,27 @@ void ff_blend_mask(FFDrawContext *draw, FFDrawColor *color,
     }
 }
 
+void ff_combine_mask(uint8_t *dst, int dst_linesize,
+                     const uint8_t *mask, int mask_linesize, int mask_w, int mask_h,
+                     int l2depth)
+{
+    unsigned xmshf = 3 - l2depth;
+    unsigned xmmod = 7 >> l2depth;
+    unsigned mbits = (1 << (1 << l2depth)) - 1;
+    unsigned mmult = 255 / mbits;
+    int x, y;
+
+    for (y = 0; y < mask_h; y++) {
+        for (x = 0; x < mask_w; x++) {
+            unsigned v = ((mask[x >> xmshf] >> ((~x & xmmod) << l2depth)) & mbits)
+                         * mmult;
+            dst[x] += v - (dst[x] * v + 127) / 255;
+        }
+        dst  += dst_linesize;
+        mask += mask_linesize;
+    }
+}
+
 int ff_draw_round_to_sub(FFDrawContext *draw, int sub_dir, int round_dir,
                          int value)
 {
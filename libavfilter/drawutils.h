@@ -139,6 +139,31 @@ void ff_blend_mask(FFDrawContext *draw, FFDrawColor *color,
                    const uint8_t *mask, int mask_linesize, int mask_w, int mask_h,
                    int l2depth, unsigned endianness, int x0, int y0);
 
+/**
+ * Combine an alpha mask into an 8-bit coverage mask.
+ *
+ * Each destination value becomes the coverage of the two masks blended one
+ * after the other, so that blending the result with ff_blend_mask() gives,
+ * up to rounding, the same image as blending every combined mask in turn.
+ * This only holds for planes without subsampling: on a subsampled plane,
+ * ff_blend_mask() averages the coverage of all the samples under one chroma
+ * sample. If two masks cover different samples under the same chroma sample,
+ * with average coverages a1 and a2, that chroma sample is blended with
+ * a1 + a2 instead of a1 + a2 - a1 * a2, i.e. it is moved further towards the
+ * color by about a1 * a2 * (color - original value).
+ *
+ * @param dst            destination 8-bit mask
+ * @param dst_linesize   line stride of the destination
+ * @param mask           mask
+ * @param mask_linesize  line stride of the mask
+ * @param mask_w         width of the mask
+ * @param mask_h         height of the mask
+ * @param l2depth        log2 of depth of the mask (0 for 1bpp, 3 for 8bpp)
+ */
+void ff_combine_mask(uint8_t *dst, int dst_linesize,
+                     const uint8_t *mask, int mask_linesize, int mask_w, int mask_h,
+                     int l2depth);
+
 /**
  * Round a dimension according to subsampling.
  *
@@ -84,6 +84,11 @@ int ff_dualinput_request_frame(FFDualInputContext *s, AVFilterLink *outlink)
     return ff_framesync_request_frame(&s->fs, outlink);
 }
 
+int ff_dualinput_activate(FFDualInputContext *s)
+{
+    return ff_framesync_activate(&s->fs);
+}
+
 void ff_dualinput_uninit(FFDualInputContext *s)
 {
     ff_framesync_uninit(&s->fs);
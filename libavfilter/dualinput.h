@@ -41,6 +41,7 @@ typedef struct {
 int ff_dualinput_init(AVFilterContext *ctx, FFDualInputContext *s);
 int ff_dualinput_filter_frame(FFDualInputContext *s, AVFilterLink *inlink, AVFrame *in);
 int ff_dualinput_request_frame(FFDualInputContext *s, AVFilterLink *outlink);
+int ff_dualinput_activate(FFDualInputContext *s);
 void ff_dualinput_uninit(FFDualInputContext *s);
 
 #endif /* AVFILTER_DUALINPUT_H */
@@ -34,10 +34,10 @@
 #include "libavutil/channel_layout.h"
 #include "libavutil/dict.h"
 #include "libavutil/ffmath.h"
+#include "libavutil/mem.h"
 #include "libavutil/xga_font_data.h"
 #include "libavutil/opt.h"
 #include "libavutil/timestamp.h"
-#include "libswresample/swresample.h"
 #include "audio.h"
 #include "avfilter.h"
 #include "formats.h"
@@ -59,6 +59,27 @@
 #define RLB_A1 -1.99004745483398
 #define RLB_A2  0.99007225036621
 
+#define TP_TAPS   12                ///< number of taps per phase of the true-peak interpolator
+#define TP_PHASES  4                ///< over-sampling factor of the true-peak interpolator
+
+/* ITU-R BS.1770-4 Annex 2, one row per phase, applied to x[i], x[i-1], ... */
+static const double tp_coeffs[TP_PHASES][TP_TAPS] = {
+    {  0.0017089843750,  0.0109863281250, -0.0196533203125,  0.0332031250000,
+      -0.0594482421875,  0.1373291015625,  0.9721679687500, -0.1022949218750,
+       0.0476074218750, -0.0266113281250,  0.0148925781250, -0.0083007812500 },
+    { -0.0291748046875,  0.0292968750000, -0.0517578125000,  0.0891113281250,
+      -0.1665039062500,  0.4650878906250,  0.7797851562500, -0.2003173828125,
+       0.1015625000000, -0.0582275390625,  0.0330810546875, -0.0189208984375 },
+    { -0.0189208984375,  0.0330810546875, -0.0582275390625,  0.1015625000000,
+      -0.2003173828125,  0.7797851562500,  0.4650878906250, -0.1665039062500,
+       0.0891113281250, -0.0517578125000,  0.0292968750000, -0.0291748046875 },
+    { -0.0083007812500,  0.0148925781250, -0.0266113281250,  0.0476074218750,
+      -0.1022949218750,  0.9721679687500,  0.1373291015625, -0.0594482421875,
+       0.0332031250000, -0.0196533203125,  0.0109863281250,  0.0017089843750 },
+};
+
+#define BLOCK_SIZE 256              ///< max number of samples K-weighted at once
+
 #define ABS_THRES    -70            ///< silence gate: we discard anything below this absolute (LUFS) threshold
 #define ABS_UP_THRES  10            ///< upper loud limit to consider (ABS_THRES being the minimum)
 #define HIST_GRAIN   100            ///< defines histogram precision
@@ -83,6 +104,8 @@ struct integrator {
     double sum[MAX_CHANNELS];       ///< sum of the last N ms filtered samples (cache content)
     int filled;                     ///< 1 if the cache is completely filled, 0 otherwise
     double rel_threshold;           ///< relative threshold
+    int gate_hist_pos;              ///< position of the relative threshold in the histogram
+    int dirty;                      ///< 1 if the histogram changed since the last I or LRA computation
     double sum_kept_powers;         ///< sum of the powers (weighted sums) above absolute threshold
     int nb_kept_powers;             ///< number of sum above absolute threshold
     struct hist_entry *histogram;   ///< histogram of the powers, used to compute LRA and I
@@ -98,11 +121,7 @@ typedef struct {
     double *true_peaks;             ///< true peaks per channel
     double *sample_peaks;           ///< sample peaks per channel
     double *true_peaks_per_frame;   ///< true peaks in a frame per channel
-#if CONFIG_SWRESAMPLE
-    SwrContext *swr_ctx;            ///< over-sampling context for true peak metering
-    double *swr_buf;                ///< resampled audio data for true peak metering
-    int swr_linesize;
-#endif
+    double *tp_buf;                 ///< history and head of the frame for true peak metering
 
     /* video  */
     int do_video;                   ///< 1 if video output enabled, 0 otherwise
@@ -121,11 +140,10 @@ typedef struct {
     double *ch_weighting;           ///< channel weighting mapping
     int sample_count;               ///< sample count used for refresh frequency, reset at refresh
 
-    /* Filter caches.
-     * The mult by 3 in the following is for X[i], X[i-1] and X[i-2] */
-    double x[MAX_CHANNELS * 3];     ///< 3 input samples cache for each channel
-    double y[MAX_CHANNELS * 3];     ///< 3 pre-filter samples cache for each channel
-    double z[MAX_CHANNELS * 3];     ///< 3 RLB-filter samples cache for each channel
+    /* Filter caches: the rows x[-1], x[-2], y[-1], y[-2], z[-1], z[-2] of
+     * the K-weighting filter, each holding one value per channel */
+    double kw_state[MAX_CHANNELS * 6];
+    double *bins;                   ///< K-weighted squared samples of the current block
 
 #define I400_BINS  (48000 * 4 / 10)
 #define I3000_BINS (48000 * 3)
@@ -159,6 +177,7 @@ static const AVOption ebur128_options[] = {
     { "size",  "set video size",   OFFSET(w), AV_OPT_TYPE_IMAGE_SIZE, {.str = "640x480"}, 0, 0, V|F },
     { "meter", "set scale meter (+9 to +18)",  OFFSET(meter), AV_OPT_TYPE_INT, {.i64 = 9}, 9, 18, V|F },
     { "framelog", "force frame logging level", OFFSET(loglevel), AV_OPT_TYPE_INT, {.i64 = -1},   INT_MIN, INT_MAX, A|V|F, "level" },
+        { "quiet",   "disable frame logging",     0, AV_OPT_TYPE_CONST, {.i64 = AV_LOG_QUIET},   INT_MIN, INT_MAX, A|V|F, "level" },
         { "info",    "information logging level", 0, AV_OPT_TYPE_CONST, {.i64 = AV_LOG_INFO},    INT_MIN, INT_MAX, A|V|F, "level" },
         { "verbose", "verbose logging level",     0, AV_OPT_TYPE_CONST, {.i64 = AV_LOG_VERBOSE}, INT_MIN, INT_MAX, A|V|F, "level" },
     { "metadata", "inject metadata in the filtergraph", OFFSET(metadata), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, A|V|F },
@@ -352,10 +371,8 @@ static int config_audio_input(AVFilterLink *inlink)
 
     /* Force 100ms framing in case of metadata injection: the frames must have
      * a granularity of the window overlap to be accurately exploited.
-     * As for the true peaks mode, it just simplifies the resampling buffer
-     * allocation and the lookup in it (since sample buffers differ in size, it
-     * can be more complex to integrate in the one-sample loop of
-     * filter_frame()). */
+     * As for the true peaks mode, it keeps the per-frame true peak aligned
+     * with the 100ms logging. */
     if (ebur128->metadata || (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS))
         inlink->min_samples =
         inlink->max_samples =
@@ -401,31 +418,18 @@ static int config_audio_output(AVFilterLink *outlink)
             return AVERROR(ENOMEM);
     }
 
-#if CONFIG_SWRESAMPLE
-    if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS) {
-        int ret;
+    ebur128->bins = av_malloc_array(nb_channels, BLOCK_SIZE * sizeof(*ebur128->bins));
+    if (!ebur128->bins)
+        return AVERROR(ENOMEM);
 
-        ebur128->swr_buf    = av_malloc_array(nb_channels, 19200 * sizeof(double));
+    if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS) {
+        ebur128->tp_buf     = av_calloc(nb_channels, 2 * (TP_TAPS - 1) * sizeof(*ebur128->tp_buf));
         ebur128->true_peaks = av_calloc(nb_channels, sizeof(*ebur128->true_peaks));
         ebur128->true_peaks_per_frame = av_calloc(nb_channels, sizeof(*ebur128->true_peaks_per_frame));
-        ebur128->swr_ctx    = swr_alloc();
-        if (!ebur128->swr_buf || !ebur128->true_peaks ||
-            !ebur128->true_peaks_per_frame || !ebur128->swr_ctx)
+        if (!ebur128->tp_buf || !ebur128->true_peaks ||
+            !ebur128->true_peaks_per_frame)
             return AVERROR(ENOMEM);
-
-        av_opt_set_int(ebur128->swr_ctx, "in_channel_layout",    outlink->channel_layout, 0);
-        av_opt_set_int(ebur128->swr_ctx, "in_sample_rate",       outlink->sample_rate, 0);
-        av_opt_set_sample_fmt(ebur128->swr_ctx, "in_sample_fmt", outlink->format, 0);
-
-        av_opt_set_int(ebur128->swr_ctx, "out_channel_layout",    outlink->channel_layout, 0);
-        av_opt_set_int(ebur128->swr_ctx, "out_sample_rate",       192000, 0);
-        av_opt_set_sample_fmt(ebur128->swr_ctx, "out_sample_fmt", outlink->format, 0);
-
-        ret = swr_init(ebur128->swr_ctx);
-        if (ret < 0)
-            return ret;
     }
-#endif
 
     if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS) {
         ebur128->sample_peaks = av_calloc(nb_channels, sizeof(*ebur128->sample_peaks));
@@ -459,7 +463,8 @@ static av_cold int init(AVFilterContext *ctx)
     EBUR128Context *ebur128 = ctx->priv;
     AVFilterPad pad;
 
-    if (ebur128->loglevel != AV_LOG_INFO &&
+    if (ebur128->loglevel != AV_LOG_QUIET &&
+        ebur128->loglevel != AV_LOG_INFO &&
         ebur128->loglevel != AV_LOG_VERBOSE) {
         if (ebur128->do_video || ebur128->metadata)
             ebur128->loglevel = AV_LOG_VERBOSE;
@@ -467,12 +472,6 @@ static av_cold int init(AVFilterContext *ctx)
             ebur128->loglevel = AV_LOG_INFO;
     }
 
-    if (!CONFIG_SWRESAMPLE && (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS)) {
-        av_log(ctx, AV_LOG_ERROR,
-               "True-peak mode requires libswresample to be performed\n");
-        return AVERROR(EINVAL);
-    }
-
     // if meter is  +9 scale, scale range is from -18 LU to  +9 LU (or 3*9)
     // if meter is +18 scale, scale range is from -36 LU to +18 LU (or 3*18)
     ebur128->scale_range = 3 * ebur128->meter;
@@ -515,12 +514,11 @@ static av_cold int init(AVFilterContext *ctx)
 
 /* loudness and power should be set such as loudness = -0.691 +
  * 10*log10(power), we just avoid doing that calculus two times */
-static int gate_update(struct integrator *integ, double power,
-                       double loudness, int gate_thres)
+static void gate_update(struct integrator *integ, double power,
+                        double loudness, int gate_thres)
 {
     int ipower;
     double relative_threshold;
-    int gate_hist_pos;
 
     /* update powers histograms by incrementing current power count */
     ipower = av_clip(HIST_POS(loudness), 0, HIST_SIZE - 1);
@@ -533,104 +531,257 @@ static int gate_update(struct integrator *integ, double power,
     if (!relative_threshold)
         relative_threshold = 1e-12;
     integ->rel_threshold = LOUDNESS(relative_threshold) + gate_thres;
-    gate_hist_pos = av_clip(HIST_POS(integ->rel_threshold), 0, HIST_SIZE - 1);
+    integ->gate_hist_pos = av_clip(HIST_POS(integ->rel_threshold), 0, HIST_SIZE - 1);
+    integ->dirty = 1;
+}
+
+/* Integrated loudness */
+#define I_GATE_THRES -10  // initially defined to -8 LU in the first EBU standard
+
+static void update_integrated_loudness(EBUR128Context *ebur128)
+{
+    struct integrator *integ = &ebur128->i400;
+    double integrated_sum = 0;
+    int nb_integrated = 0;
+    int i;
+
+    if (!integ->dirty)
+        return;
+    integ->dirty = 0;
+
+    /* compute integrated loudness by summing the histogram values
+     * above the relative threshold */
+    for (i = integ->gate_hist_pos; i < HIST_SIZE; i++) {
+        const int nb_v = integ->histogram[i].count;
+        nb_integrated  += nb_v;
+        integrated_sum += nb_v * integ->histogram[i].energy;
+    }
+    if (nb_integrated) {
+        ebur128->integrated_loudness = LOUDNESS(integrated_sum / nb_integrated);
+        /* dual-mono correction */
+        if (ebur128->nb_channels == 1 && ebur128->dual_mono) {
+            ebur128->integrated_loudness -= ebur128->pan_law;
+        }
+    }
+}
 
-    return gate_hist_pos;
+/* LRA */
+#define LRA_GATE_THRES -20
+#define LRA_LOWER_PRC   10
+#define LRA_HIGHER_PRC  95
+
+static void update_loudness_range(EBUR128Context *ebur128)
+{
+    struct integrator *integ = &ebur128->i3000;
+    int nb_powers = 0;
+    int i;
+
+    if (!integ->dirty)
+        return;
+    integ->dirty = 0;
+
+    for (i = integ->gate_hist_pos; i < HIST_SIZE; i++)
+        nb_powers += integ->histogram[i].count;
+    if (nb_powers) {
+        int n, nb_pow;
+
+        /* get lower loudness to consider */
+        n = 0;
+        nb_pow = LRA_LOWER_PRC  * nb_powers / 100. + 0.5;
+        for (i = integ->gate_hist_pos; i < HIST_SIZE; i++) {
+            n += integ->histogram[i].count;
+            if (n >= nb_pow) {
+                ebur128->lra_low = integ->histogram[i].loudness;
+                break;
+            }
+        }
+
+        /* get higher loudness to consider */
+        n = nb_powers;
+        nb_pow = LRA_HIGHER_PRC * nb_powers / 100. + 0.5;
+        for (i = HIST_SIZE - 1; i >= 0; i--) {
+            n -= integ->histogram[i].count;
+            if (n < nb_pow) {
+                ebur128->lra_high = integ->histogram[i].loudness;
+                break;
+            }
+        }
+
+        // XXX: show low & high on the graph?
+        ebur128->loudness_range = ebur128->lra_high - ebur128->lra_low;
+    }
+}
+
+/* Over-sample the interleaved input 4 times and update the absolute peak of
+ * each channel. src is preceded by TP_TAPS - 1 samples of history. */
+static void true_peak(double *peaks, const double *src, int nb_channels, int len)
+{
+    int ch, i, p, k;
+
+    for (ch = 0; ch < nb_channels; ch++) {
+        double peak = peaks[ch];
+
+        for (i = 0; i < len; i++) {
+            const double *x = src + i * nb_channels + ch;
+
+            for (p = 0; p < TP_PHASES; p++) {
+                double v = 0;
+
+                for (k = 0; k < TP_TAPS; k++)
+                    v += tp_coeffs[p][k] * x[-k * nb_channels];
+                peak = FFMAX(peak, fabs(v));
+            }
+        }
+        peaks[ch] = peak;
+    }
+}
+
+static void update_true_peaks(EBUR128Context *ebur128, const double *samples,
+                              int nb_samples)
+{
+    const int nb_channels = ebur128->nb_channels;
+    const int hist = (TP_TAPS - 1) * nb_channels;
+    const int head = FFMIN(nb_samples, TP_TAPS - 1);
+    double *buf = ebur128->tp_buf;
+    int ch;
+
+    for (ch = 0; ch < nb_channels; ch++)
+        ebur128->true_peaks_per_frame[ch] = 0.0;
+
+    /* the first samples need the history of the previous frame, the
+     * following ones find it in the frame itself */
+    memcpy(buf + hist, samples, head * nb_channels * sizeof(*buf));
+    true_peak(ebur128->true_peaks_per_frame, buf + hist, nb_channels, head);
+    if (nb_samples > head)
+        true_peak(ebur128->true_peaks_per_frame, samples + hist,
+                  nb_channels, nb_samples - head);
+
+    if (nb_samples >= TP_TAPS - 1)
+        memcpy(buf, samples + (nb_samples - head) * nb_channels, hist * sizeof(*buf));
+    else
+        memmove(buf, buf + head * nb_channels, hist * sizeof(*buf));
+
+    for (ch = 0; ch < nb_channels; ch++)
+        ebur128->true_peaks[ch] = FFMAX(ebur128->true_peaks[ch],
+                                        ebur128->true_peaks_per_frame[ch]);
+}
+
+/* Apply the pre-filter and the RLB filter to the interleaved input and store
+ * the squared output in bins. */
+static void kweight(double *bins, const double *src, double *state,
+                    int nb_channels, int len)
+{
+    int ch, i;
+
+    for (ch = 0; ch < nb_channels; ch++) {
+        double x1 = state[0 * nb_channels + ch], x2 = state[1 * nb_channels + ch];
+        double y1 = state[2 * nb_channels + ch], y2 = state[3 * nb_channels + ch];
+        double z1 = state[4 * nb_channels + ch], z2 = state[5 * nb_channels + ch];
+
+        for (i = 0; i < len; i++) {
+            const double x0 = src[i * nb_channels + ch];
+            const double y0 = x0*PRE_B0 + x1*PRE_B1 + x2*PRE_B2 - y1*PRE_A1 - y2*PRE_A2;
+            const double z0 = y0*RLB_B0 + y1*RLB_B1 + y2*RLB_B2 - z1*RLB_A1 - z2*RLB_A2;
+
+            bins[i * nb_channels + ch] = z0 * z0;
+            x2 = x1; x1 = x0;
+            y2 = y1; y1 = y0;
+            z2 = z1; z1 = z0;
+        }
+
+        state[0 * nb_channels + ch] = x1; state[1 * nb_channels + ch] = x2;
+        state[2 * nb_channels + ch] = y1; state[3 * nb_channels + ch] = y2;
+        state[4 * nb_channels + ch] = z1; state[5 * nb_channels + ch] = z2;
+    }
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
 {
-    int i, ch, idx_insample;
+    int i, ch, idx_insample, len;
     AVFilterContext *ctx = inlink->dst;
     EBUR128Context *ebur128 = ctx->priv;
     const int nb_channels = ebur128->nb_channels;
     const int nb_samples  = insamples->nb_samples;
     const double *samples = (double *)insamples->data[0];
     AVFrame *pic = ebur128->outpicref;
+    /* without any consumer of the per-frame values, I and LRA are only
+     * computed for the summary */
+    const int need_values = ebur128->do_video || ebur128->metadata ||
+                            ebur128->loglevel != AV_LOG_QUIET;
 
-#if CONFIG_SWRESAMPLE
-    if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS) {
-        const double *swr_samples = ebur128->swr_buf;
-        int ret = swr_convert(ebur128->swr_ctx, (uint8_t**)&ebur128->swr_buf, 19200,
-                              (const uint8_t **)insamples->data, nb_samples);
-        if (ret < 0)
-            return ret;
-        for (ch = 0; ch < nb_channels; ch++)
-            ebur128->true_peaks_per_frame[ch] = 0.0;
-        for (idx_insample = 0; idx_insample < ret; idx_insample++) {
-            for (ch = 0; ch < nb_channels; ch++) {
-                ebur128->true_peaks[ch] = FFMAX(ebur128->true_peaks[ch], fabs(*swr_samples));
-                ebur128->true_peaks_per_frame[ch] = FFMAX(ebur128->true_peaks_per_frame[ch],
-                                                          fabs(*swr_samples));
-                swr_samples++;
-            }
-        }
-    }
-#endif
+    if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS)
+        update_true_peaks(ebur128, samples, nb_samples);
 
-    for (idx_insample = 0; idx_insample < nb_samples; idx_insample++) {
+    for (idx_insample = 0; idx_insample < nb_samples; idx_insample += len) {
         const int bin_id_400  = ebur128->i400.cache_pos;
         const int bin_id_3000 = ebur128->i3000.cache_pos;
+        const double *bins = ebur128->bins;
+
+        /* The cache sizes are multiples of 4800 samples, so a block ending at
+         * the latest on the next 100ms boundary never wraps around them. */
+        len = FFMIN3(nb_samples - idx_insample, 4800 - ebur128->sample_count,
+                     BLOCK_SIZE);
+
+        if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS) {
+            for (i = 0; i < len; i++)
+                for (ch = 0; ch < nb_channels; ch++)
+                    ebur128->sample_peaks[ch] = FFMAX(ebur128->sample_peaks[ch],
+                                                      fabs(samples[i * nb_channels + ch]));
+        }
 
-#define MOVE_TO_NEXT_CACHED_ENTRY(time) do {                \
-    ebur128->i##time.cache_pos++;                           \
-    if (ebur128->i##time.cache_pos == I##time##_BINS) {     \
-        ebur128->i##time.filled    = 1;                     \
-        ebur128->i##time.cache_pos = 0;                     \
-    }                                                       \
-} while (0)
-
-        MOVE_TO_NEXT_CACHED_ENTRY(400);
-        MOVE_TO_NEXT_CACHED_ENTRY(3000);
+        kweight(ebur128->bins, samples, ebur128->kw_state, nb_channels, len);
+        samples += len * nb_channels;
 
         for (ch = 0; ch < nb_channels; ch++) {
-            double bin;
-
-            if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS)
-                ebur128->sample_peaks[ch] = FFMAX(ebur128->sample_peaks[ch], fabs(*samples));
-
-            ebur128->x[ch * 3] = *samples++; // set X[i]
+            double *cache_400, *cache_3000;
+            double sum_400, sum_3000;
 
             if (!ebur128->ch_weighting[ch])
                 continue;
 
-            /* Y[i] = X[i]*b0 + X[i-1]*b1 + X[i-2]*b2 - Y[i-1]*a1 - Y[i-2]*a2 */
-#define FILTER(Y, X, name) do {                                                 \
-            double *dst = ebur128->Y + ch*3;                                    \
-            double *src = ebur128->X + ch*3;                                    \
-            dst[2] = dst[1];                                                    \
-            dst[1] = dst[0];                                                    \
-            dst[0] = src[0]*name##_B0 + src[1]*name##_B1 + src[2]*name##_B2     \
-                                      - dst[1]*name##_A1 - dst[2]*name##_A2;    \
-} while (0)
+            cache_400  = ebur128->i400.cache [ch] + bin_id_400;
+            cache_3000 = ebur128->i3000.cache[ch] + bin_id_3000;
+            sum_400    = ebur128->i400.sum [ch];
+            sum_3000   = ebur128->i3000.sum[ch];
 
-            // TODO: merge both filters in one?
-            FILTER(y, x, PRE);  // apply pre-filter
-            ebur128->x[ch * 3 + 2] = ebur128->x[ch * 3 + 1];
-            ebur128->x[ch * 3 + 1] = ebur128->x[ch * 3    ];
-            FILTER(z, y, RLB);  // apply RLB-filter
+            for (i = 0; i < len; i++) {
+                const double bin = bins[i * nb_channels + ch];
 
-            bin = ebur128->z[ch * 3] * ebur128->z[ch * 3];
+                /* add the new value, and limit the sum to the cache size
+                 * (400ms or 3s) by removing the oldest one */
+                sum_400  = sum_400  + bin - cache_400 [i];
+                sum_3000 = sum_3000 + bin - cache_3000[i];
 
-            /* add the new value, and limit the sum to the cache size (400ms or 3s)
-             * by removing the oldest one */
-            ebur128->i400.sum [ch] = ebur128->i400.sum [ch] + bin - ebur128->i400.cache [ch][bin_id_400];
-            ebur128->i3000.sum[ch] = ebur128->i3000.sum[ch] + bin - ebur128->i3000.cache[ch][bin_id_3000];
+                /* override old cache entry with the new value */
+                cache_400 [i] = bin;
+                cache_3000[i] = bin;
+            }
 
-            /* override old cache entry with the new value */
-            ebur128->i400.cache [ch][bin_id_400 ] = bin;
-            ebur128->i3000.cache[ch][bin_id_3000] = bin;
+            ebur128->i400.sum [ch] = sum_400;
+            ebur128->i3000.sum[ch] = sum_3000;
         }
 
+#define MOVE_TO_NEXT_CACHED_ENTRIES(time) do {              \
+    ebur128->i##time.cache_pos += len;                      \
+    if (ebur128->i##time.cache_pos == I##time##_BINS) {     \
+        ebur128->i##time.filled    = 1;                     \
+        ebur128->i##time.cache_pos = 0;                     \
+    }                                                       \
+} while (0)
+
+        MOVE_TO_NEXT_CACHED_ENTRIES(400);
+        MOVE_TO_NEXT_CACHED_ENTRIES(3000);
+
         /* For integrated loudness, gating blocks are 400ms long with 75%
          * overlap (see BS.1770-2 p5), so a re-computation is needed each 100ms
          * (4800 samples at 48kHz). */
-        if (++ebur128->sample_count == 4800) {
+        ebur128->sample_count += len;
+        if (ebur128->sample_count == 4800) {
             double loudness_400, loudness_3000;
             double power_400 = 1e-12, power_3000 = 1e-12;
             AVFilterLink *outlink = ctx->outputs[0];
             const int64_t pts = insamples->pts +
-                av_rescale_q(idx_insample, (AVRational){ 1, inlink->sample_rate },
+                av_rescale_q(idx_insample + len - 1, (AVRational){ 1, inlink->sample_rate },
                              outlink->time_base);
 
             ebur128->sample_count = 0;
@@ -648,73 +799,17 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
             COMPUTE_LOUDNESS(M,  400);
             COMPUTE_LOUDNESS(S, 3000);
 
-            /* Integrated loudness */
-#define I_GATE_THRES -10  // initially defined to -8 LU in the first EBU standard
-
-            if (loudness_400 >= ABS_THRES) {
-                double integrated_sum = 0;
-                int nb_integrated = 0;
-                int gate_hist_pos = gate_update(&ebur128->i400, power_400,
-                                                loudness_400, I_GATE_THRES);
-
-                /* compute integrated loudness by summing the histogram values
-                 * above the relative threshold */
-                for (i = gate_hist_pos; i < HIST_SIZE; i++) {
-                    const int nb_v = ebur128->i400.histogram[i].count;
-                    nb_integrated  += nb_v;
-                    integrated_sum += nb_v * ebur128->i400.histogram[i].energy;
-                }
-                if (nb_integrated) {
-                    ebur128->integrated_loudness = LOUDNESS(integrated_sum / nb_integrated);
-                    /* dual-mono correction */
-                    if (nb_channels == 1 && ebur128->dual_mono) {
-                        ebur128->integrated_loudness -= ebur128->pan_law;
-                    }
-                }
-            }
-
-            /* LRA */
-#define LRA_GATE_THRES -20
-#define LRA_LOWER_PRC   10
-#define LRA_HIGHER_PRC  95
+            if (loudness_400 >= ABS_THRES)
+                gate_update(&ebur128->i400, power_400, loudness_400, I_GATE_THRES);
 
             /* XXX: example code in EBU 3342 is ">=" but formula in BS.1770
              * specs is ">" */
-            if (loudness_3000 >= ABS_THRES) {
-                int nb_powers = 0;
-                int gate_hist_pos = gate_update(&ebur128->i3000, power_3000,
-                                                loudness_3000, LRA_GATE_THRES);
-
-                for (i = gate_hist_pos; i < HIST_SIZE; i++)
-                    nb_powers += ebur128->i3000.histogram[i].count;
-                if (nb_powers) {
-                    int n, nb_pow;
-
-                    /* get lower loudness to consider */
-                    n = 0;
-                    nb_pow = LRA_LOWER_PRC  * nb_powers / 100. + 0.5;
-                    for (i = gate_hist_pos; i < HIST_SIZE; i++) {
-                        n += ebur128->i3000.histogram[i].count;
-                        if (n >= nb_pow) {
-                            ebur128->lra_low = ebur128->i3000.histogram[i].loudness;
-                            break;
-                        }
-                    }
-
-                    /* get higher loudness to consider */
-                    n = nb_powers;
-                    nb_pow = LRA_HIGHER_PRC * nb_powers / 100. + 0.5;
-                    for (i = HIST_SIZE - 1; i >= 0; i--) {
-                        n -= ebur128->i3000.histogram[i].count;
-                        if (n < nb_pow) {
-                            ebur128->lra_high = ebur128->i3000.histogram[i].loudness;
-                            break;
-                        }
-                    }
-
-                    // XXX: show low & high on the graph?
-                    ebur128->loudness_range = ebur128->lra_high - ebur128->lra_low;
-                }
+            if (loudness_3000 >= ABS_THRES)
+                gate_update(&ebur128->i3000, power_3000, loudness_3000, LRA_GATE_THRES);
+
+            if (need_values) {
+                update_integrated_loudness(ebur128);
+                update_loudness_range(ebur128);
             }
 
             /* dual-mono correction */
@@ -797,6 +892,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
                 SET_META_PEAK(true,   TRUE);
             }
 
+            if (ebur128->loglevel == AV_LOG_QUIET)
+                continue;
+
             av_log(ctx, ebur128->loglevel, "t: %-10s " LOG_FMT,
                    av_ts2timestr(pts, &outlink->time_base),
                    loudness_400, loudness_3000,
@@ -868,6 +966,11 @@ static av_cold void uninit(AVFilterContext *ctx)
     int i;
     EBUR128Context *ebur128 = ctx->priv;
 
+    if (ebur128->i400.histogram && ebur128->i3000.histogram) {
+        update_integrated_loudness(ebur128);
+        update_loudness_range(ebur128);
+    }
+
     /* dual-mono correction */
     if (ebur128->nb_channels == 1 && ebur128->dual_mono) {
         ebur128->i400.rel_threshold -= ebur128->pan_law;
@@ -911,6 +1014,8 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&ebur128->true_peaks);
     av_freep(&ebur128->sample_peaks);
     av_freep(&ebur128->true_peaks_per_frame);
+    av_freep(&ebur128->tp_buf);
+    av_freep(&ebur128->bins);
     av_freep(&ebur128->i400.histogram);
     av_freep(&ebur128->i3000.histogram);
     for (i = 0; i < ebur128->nb_channels; i++) {
@@ -920,10 +1025,6 @@ static av_cold void uninit(AVFilterContext *ctx)
     for (i = 0; i < ctx->nb_outputs; i++)
         av_freep(&ctx->output_pads[i].name);
     av_frame_free(&ebur128->outpicref);
-#if CONFIG_SWRESAMPLE
-    av_freep(&ebur128->swr_buf);
-    swr_free(&ebur128->swr_ctx);
-#endif
 }
 
 static const AVFilterPad ebur128_inputs[] = {
@@ -21,6 +21,7 @@
 #include "libavutil/avassert.h"
 #include "avfilter.h"
 #include "bufferqueue.h"
+#include "framequeue.h"
 #include "framesync.h"
 #include "internal.h"
 
@@ -311,6 +312,31 @@ int ff_framesync_filter_frame(FFFrameSync *fs, AVFilterLink *inlink,
     return 0;
 }
 
+static int framesync_hold_input(void *opaque, unsigned in)
+{
+    FFFrameSync *fs = opaque;
+    AVFilterContext *ctx = fs->parent;
+    FFFrameSyncIn *fsin = &fs->in[in];
+    uint64_t bytes;
+    unsigned i;
+
+    /* an input without a next frame is the one requested, never hold it */
+    if (!fsin->have_next)
+        return 0;
+    if (ff_bufqueue_is_full(&fsin->queue))
+        return 1;
+    bytes = fsin->frame_next ? ff_framequeue_frame_size(fsin->frame_next) : 0;
+    for (i = 0; i < fsin->queue.available; i++)
+        bytes += ff_framequeue_frame_size(ff_bufqueue_peek(&fsin->queue, i));
+    return ff_link_queue_limit_reached(ctx->inputs[in],
+                                       fsin->queue.available + 1, bytes);
+}
+
+int ff_framesync_activate(FFFrameSync *fs)
+{
+    return ff_filter_activate_default_hold(fs->parent, framesync_hold_input, fs);
+}
+
 int ff_framesync_request_frame(FFFrameSync *fs, AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
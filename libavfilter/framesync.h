@@ -294,4 +294,15 @@ int ff_framesync_filter_frame(FFFrameSync *fs, AVFilterLink *inlink,
  */
 int ff_framesync_request_frame(FFFrameSync *fs, AVFilterLink *outlink);
 
+/**
+ * Activate a filter using framesync.
+ *
+ * This function can be the complete implementation of the activate method
+ * of a filter using ff_framesync_filter_frame() and
+ * ff_framesync_request_frame(). It stops taking frames from an input once
+ * the frames queued for it reach the queue limits of the input link, or
+ * fill the queue.
+ */
+int ff_framesync_activate(FFFrameSync *fs);
+
 #endif /* AVFILTER_FRAMESYNC_H */
@@ -152,11 +152,68 @@ static void avfilter_graph_dump_to_buf(AVBPrint *buf, AVFilterGraph *graph)
     }
 }
 
+static void avfilter_graph_dump_profile(AVBPrint *buf, AVFilterGraph *graph)
+{
+    unsigned i, j, max_name = strlen("filter");
+    int64_t total = 0;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        max_name = FFMAX(max_name, strlen(filter->name));
+        for (j = 0; j < filter->nb_inputs; j++) {
+            AVFilterLink *l = filter->inputs[j];
+            max_name = FFMAX(max_name, 2 + strlen(l->src->name) + 1 +
+                                       strlen(l->srcpad->name));
+        }
+    }
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterProfile p;
+        avfilter_get_profile(graph->filters[i], &p, sizeof(p));
+        total += p.time;
+    }
+
+    av_bprintf(buf, "%-*s %12s %6s %10s %10s %10s %8s %8s\n",
+               max_name, "filter", "time (ms)", "%", "activ.",
+               "frames in", "frames out", "queued", "allocs");
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        AVFilterProfile p;
+
+        avfilter_get_profile(filter, &p, sizeof(p));
+        av_bprintf(buf, "%-*s %12.3f %6.2f %10"PRId64" %10"PRId64" %10"PRId64
+                   " %8"PRId64" %8"PRId64"\n",
+                   max_name, filter->name, p.time / 1000.0,
+                   total ? 100.0 * p.time / total : 0.0, p.nb_activations,
+                   p.frames_in, p.frames_out, p.queued_frames,
+                   p.nb_allocated_frames);
+        /* detail the queues of filters with several inputs */
+        if (filter->nb_inputs < 2)
+            continue;
+        for (j = 0; j < filter->nb_inputs; j++) {
+            AVFilterLink *l = filter->inputs[j];
+            unsigned e = buf->len + max_name;
+            av_bprintf(buf, "  %s:%s", l->src->name, l->srcpad->name);
+            av_bprint_chars(buf, ' ', e - buf->len);
+            av_bprintf(buf, " %52s %8"SIZE_SPECIFIER"\n", "",
+                       avfilter_link_get_queued_frames(l));
+        }
+    }
+}
+
 char *avfilter_graph_dump(AVFilterGraph *graph, const char *options)
 {
     AVBPrint buf;
     char *dump;
 
+    if (options && !strcmp(options, "profile")) {
+        av_bprint_init(&buf, 0, AV_BPRINT_SIZE_UNLIMITED);
+        avfilter_graph_dump_profile(&buf, graph);
+        if (av_bprint_finalize(&buf, &dump) < 0)
+            return NULL;
+        return dump;
+    }
+
     av_bprint_init(&buf, 0, 0);
     avfilter_graph_dump_to_buf(&buf, graph);
     av_bprint_init(&buf, buf.len + 1, buf.len + 1);
@@ -25,6 +25,7 @@
  */
 
 #include "libavutil/internal.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "avfiltergraph.h"
 #include "formats.h"
@@ -147,10 +148,68 @@ struct AVFilterPad {
 struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
+
+    /**
+     * Threads used to activate several filters concurrently, if
+     * AVFILTER_THREAD_PIPELINE is enabled.
+     */
+    void *pipeline;
+
+    /**
+     * Set while filters are being activated concurrently; the ready
+     * status of the filters must then be updated under ready_lock.
+     */
+    int pipeline_running;
+    AVMutex ready_lock;
+
+    /**
+     * Filters activated concurrently and their return values.
+     */
+    AVFilterContext **pipeline_wave;
+    int *pipeline_rets;
+
+    /**
+     * Video frame pools shared by all the links of the graph, most
+     * recently used first; see ff_default_get_video_buffer().
+     */
+    struct FFVideoFramePool **frame_pools;
+    int nb_frame_pools;
+    AVMutex frame_pool_lock;
+
+    /**
+     * Cache of format negotiation results set by the user, not owned.
+     */
+    AVFilterFormatsCache *formats_cache;
+
+    /**
+     * Set if some links of the graph have a bounded queue; filters with a
+     * full output are then skipped by the scheduler.
+     */
+    int bounded_queues;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+
+    /**
+     * Ready status of the filter.
+     * A non-0 value means that the filter needs activating;
+     * a higher value suggests a more urgent activation.
+     */
+    unsigned ready;
+
+    /**
+     * Processing statistics, see avfilter_get_profile().
+     */
+    int64_t profile_time;
+    int64_t nb_activations;
+    int64_t nb_allocated_frames;
+
+    /**
+     * Set if the filter is part of the filters being activated
+     * concurrently.
+     */
+    int pipeline_selected;
 };
 
 /**
@@ -334,8 +393,6 @@ int ff_poll_frame(AVFilterLink *link);
  */
 int ff_request_frame(AVFilterLink *link);
 
-int ff_request_frame_to_filter(AVFilterLink *link);
-
 #define AVFILTER_DEFINE_CLASS(fname)            \
     static const AVClass fname##_class = {      \
         .class_name = #fname,                   \
@@ -361,6 +418,9 @@ int ff_request_frame_to_filter(AVFilterLink *link);
  *              receiving filter will free this reference when it no longer
  *              needs it or pass it on to the next filter.
  *
+ * The frame is queued on the link and processed later, when the
+ * destination filter is activated.
+ *
  * @return >= 0 on success, a negative AVERROR on error. The receiving filter
  * is responsible for unreferencing frame in case of error.
  */
@@ -383,9 +443,77 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
 
 /**
  * Run one round of processing on a filter graph.
+ *
+ * The filter with the highest ready status is activated.
+ *
+ * @return  >= 0 if a filter was activated,
+ *          AVERROR(EAGAIN) if no filter is ready,
+ *          another negative AVERROR code on error
  */
 int ff_filter_graph_run_once(AVFilterGraph *graph);
 
+/**
+ * Mark a filter ready and schedule it for activation.
+ *
+ * This is automatically done when something happens to the filter (queued
+ * frame, status change, request on output).
+ * Filters implementing the activate callback can call it directly to
+ * perform one more round of processing later.
+ * It is also useful for filters reacting to external or asynchronous
+ * events.
+ */
+void ff_filter_set_ready(AVFilterContext *filter, unsigned priority);
+
+/**
+ * Account for a frame allocated on a link in the statistics of its source
+ * filter.
+ */
+void ff_filter_count_allocation(AVFilterLink *link);
+
+/**
+ * Perform one step of processing on a filter: filter one queued frame,
+ * forward a status change or forward a request for frames, in that order.
+ *
+ * @return  >= 0 on success (including when there was nothing to do),
+ *          a negative AVERROR code on error
+ */
+int ff_filter_activate(AVFilterContext *filter);
+
+/**
+ * Activate a filter implementing the legacy filter_frame() and
+ * request_frame() methods; see ff_filter_activate().
+ * Can be used by filters with an activate callback that only need to
+ * alter the default behaviour in some cases.
+ */
+int ff_filter_activate_default(AVFilterContext *filter);
+
+/**
+ * Same as ff_filter_activate_default(), but leave the frames queued on the
+ * inputs for which hold() returns nonzero, so that they count against the
+ * queue limits of the link instead of piling up inside the filter.
+ *
+ * Filters buffering frames internally use it to stop consuming from an
+ * input once they hold enough frames from it. hold() must not return
+ * nonzero for an input the filter is about to request frames from, or the
+ * filter would be activated again and again without progress.
+ */
+int ff_filter_activate_default_hold(AVFilterContext *filter,
+                                    int (*hold)(void *opaque, unsigned in),
+                                    void *opaque);
+
+/**
+ * Check if the queue of a link has reached one of its limits.
+ */
+int ff_link_queue_full(AVFilterLink *link);
+
+/**
+ * Check if the given number of frames and bytes reach one of the queue
+ * limits of a link. Used by filters to apply the limits of an input to the
+ * frames they took from it and buffer internally.
+ */
+int ff_link_queue_limit_reached(AVFilterLink *link, uint64_t frames,
+                                uint64_t bytes);
+
 /**
  * Normalize the qscale factor
  * FIXME the H264 qscale is a log based scale, mpeg1/2 is not, the code below
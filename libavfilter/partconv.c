@@ -0,0 +1,218 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "partconv.h"
+
+/*
+ * Spectra are stored planar, the real parts of bins 0 to block_size - 1
+ * followed by their imaginary parts, so that the complex multiplications
+ * map onto AVFloatDSPContext.vector_fmul_add(). As in the packed av_rdft_calc()
+ * output, the real Nyquist bin takes the place of the imaginary part of the
+ * DC bin. Kernel spectra additionally store the negated imaginary parts.
+ */
+
+static void deinterleave(float *re, float *im, const float *src, int n)
+{
+    int k;
+
+    for (k = 0; k < n; k++) {
+        re[k] = src[2*k];
+        im[k] = src[2*k+1];
+    }
+}
+
+static void interleave(float *dst, const float *re, const float *im, int n)
+{
+    int k;
+
+    for (k = 0; k < n; k++) {
+        dst[2*k]   = re[k];
+        dst[2*k+1] = im[k];
+    }
+}
+
+/* sum += t * c */
+static void cmul_add(PartConvContext *s, float *sum, const float *t, const float *c)
+{
+    const int n = s->block_size;
+    float dc  = sum[0] + t[0] * c[0];
+    float nyq = sum[n] + t[n] * c[n];
+
+    s->fdsp->vector_fmul_add(sum,     t,     c,         sum,     n);
+    s->fdsp->vector_fmul_add(sum,     t + n, c + 2 * n, sum,     n);
+    s->fdsp->vector_fmul_add(sum + n, t,     c + n,     sum + n, n);
+    s->fdsp->vector_fmul_add(sum + n, t + n, c,         sum + n, n);
+    sum[0] = dc;
+    sum[n] = nyq;
+}
+
+static void update_sum(PartConvContext *s, PartConvChannel *c, const float *kernel)
+{
+    const int n = s->block_size;
+    int p;
+
+    memset(c->sum, 0, 2 * n * sizeof(*c->sum));
+    for (p = 1; p < s->nb_parts; p++) {
+        int idx = (c->idx - p + s->nb_parts) % s->nb_parts;
+        cmul_add(s, c->sum, c->fdl + idx * 2 * n, kernel + p * 3 * n);
+    }
+    c->sum_valid = 1;
+}
+
+int ff_partconv_init(PartConvContext *s, int block_bits, int max_len,
+                     int nb_kernels, int nb_channels)
+{
+    int n, ch;
+
+    av_assert0(block_bits >= 4 && block_bits <= 15);
+    memset(s, 0, sizeof(*s));
+    n = s->block_size  = 1 << block_bits;
+    s->nb_parts    = FFMAX((max_len + n - 1) / n, 1);
+    s->nb_kernels  = nb_kernels;
+    s->nb_channels = nb_channels;
+
+    s->rdft  = av_rdft_init(block_bits + 1, DFT_R2C);
+    s->irdft = av_rdft_init(block_bits + 1, IDFT_C2R);
+    s->fdsp  = avpriv_float_dsp_alloc(0);
+    s->kernel = av_calloc(nb_kernels * s->nb_parts, 3 * n * sizeof(*s->kernel));
+    s->tmp    = av_malloc_array(2 * n, sizeof(*s->tmp));
+    s->ch     = av_calloc(nb_channels, sizeof(*s->ch));
+    if (!s->rdft || !s->irdft || !s->fdsp || !s->kernel || !s->tmp || !s->ch)
+        goto fail;
+
+    for (ch = 0; ch < nb_channels; ch++) {
+        PartConvChannel *c = &s->ch[ch];
+
+        c->input = av_calloc(2 * n, sizeof(*c->input));
+        c->fdl   = av_calloc(s->nb_parts, 2 * n * sizeof(*c->fdl));
+        c->sum   = av_malloc_array(2 * n, sizeof(*c->sum));
+        c->out   = av_malloc_array(2 * n, sizeof(*c->out));
+        c->buf   = av_malloc_array(2 * n, sizeof(*c->buf));
+        if (!c->input || !c->fdl || !c->sum || !c->out || !c->buf)
+            goto fail;
+    }
+
+    return 0;
+fail:
+    ff_partconv_uninit(s);
+    return AVERROR(ENOMEM);
+}
+
+void ff_partconv_set_kernel(PartConvContext *s, int k, const float *h, int len)
+{
+    const int n = s->block_size;
+    float *kernel = s->kernel + k * s->nb_parts * 3 * n;
+    int p, i;
+
+    av_assert0(len <= s->nb_parts * n);
+    for (p = 0; p < s->nb_parts; p++) {
+        float *re = kernel + p * 3 * n;
+        int taps = av_clip(len - p * n, 0, n);
+
+        memcpy(s->tmp, h + p * n, taps * sizeof(*s->tmp));
+        memset(s->tmp + taps, 0, (2 * n - taps) * sizeof(*s->tmp));
+        av_rdft_calc(s->rdft, s->tmp);
+        deinterleave(re, re + n, s->tmp, n);
+        for (i = 0; i < n; i++)
+            re[2 * n + i] = -re[n + i];
+    }
+
+    for (i = 0; i < s->nb_channels; i++)
+        s->ch[i].sum_valid = 0;
+}
+
+/* filter nb_samples samples, not crossing the end of the current block */
+static void filter_block(PartConvContext *s, PartConvChannel *c, const float *kernel,
+                         float *dst, const float *src, int nb_samples)
+{
+    const int n = s->block_size;
+    float *x = c->fdl + c->idx * 2 * n;
+
+    if (!c->sum_valid)
+        update_sum(s, c, kernel);
+
+    memcpy(c->input + n + c->pos, src, nb_samples * sizeof(*src));
+    memcpy(c->buf, c->input, 2 * n * sizeof(*c->buf));
+    av_rdft_calc(s->rdft, c->buf);
+    deinterleave(x, x + n, c->buf, n);
+
+    memcpy(c->out, c->sum, 2 * n * sizeof(*c->out));
+    cmul_add(s, c->out, x, kernel);
+    interleave(c->buf, c->out, c->out + n, n);
+    av_rdft_calc(s->irdft, c->buf);
+    memcpy(dst, c->buf + n + c->pos, nb_samples * sizeof(*dst));
+
+    c->pos += nb_samples;
+    if (c->pos == n) {
+        memcpy(c->input, c->input + n, n * sizeof(*c->input));
+        memset(c->input + n, 0, n * sizeof(*c->input));
+        c->pos = 0;
+        c->idx = (c->idx + 1) % s->nb_parts;
+        update_sum(s, c, kernel);
+    }
+}
+
+void ff_partconv_filter(PartConvContext *s, int ch, int k,
+                        float *dst, const float *src, int nb_samples)
+{
+    PartConvChannel *c = &s->ch[ch];
+    const float *kernel = s->kernel + k * s->nb_parts * 3 * s->block_size;
+
+    if (c->kernel != k) {
+        c->kernel    = k;
+        c->sum_valid = 0;
+    }
+
+    while (nb_samples > 0) {
+        int len = FFMIN(nb_samples, s->block_size - c->pos);
+
+        filter_block(s, c, kernel, dst, src, len);
+        dst += len;
+        src += len;
+        nb_samples -= len;
+    }
+}
+
+void ff_partconv_uninit(PartConvContext *s)
+{
+    int ch;
+
+    if (s->ch) {
+        for (ch = 0; ch < s->nb_channels; ch++) {
+            PartConvChannel *c = &s->ch[ch];
+
+            av_freep(&c->input);
+            av_freep(&c->fdl);
+            av_freep(&c->sum);
+            av_freep(&c->out);
+            av_freep(&c->buf);
+        }
+    }
+    av_rdft_end(s->rdft);
+    av_rdft_end(s->irdft);
+    av_freep(&s->fdsp);
+    av_freep(&s->kernel);
+    av_freep(&s->tmp);
+    av_freep(&s->ch);
+    memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,93 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Uniformly partitioned convolution with long FIR kernels.
+ *
+ * The kernels are split into partitions of block_size taps which are
+ * convolved in the frequency domain with the spectra of the last input
+ * blocks (overlap-save). Input may be fed in chunks of any size; the output
+ * has no additional latency compared to direct convolution.
+ */
+
+#ifndef AVFILTER_PARTCONV_H
+#define AVFILTER_PARTCONV_H
+
+#include "libavutil/float_dsp.h"
+#include "libavcodec/avfft.h"
+
+typedef struct PartConvChannel {
+    float *input;   ///< previous and current input block, 2 * block_size samples
+    float *fdl;     ///< spectra of the last nb_parts input windows
+    float *sum;     ///< contribution of the past windows to the current block
+    float *out;     ///< spectrum of the current output block
+    float *buf;     ///< (i)rdft buffer
+    int pos;        ///< number of samples of the current block already filtered
+    int idx;        ///< index of the current window in fdl
+    int kernel;     ///< kernel sum was computed with
+    int sum_valid;
+} PartConvChannel;
+
+typedef struct PartConvContext {
+    int block_size;
+    int nb_parts;
+    int nb_kernels;
+    int nb_channels;
+
+    RDFTContext *rdft;
+    RDFTContext *irdft;
+    AVFloatDSPContext *fdsp;
+
+    float *kernel;          ///< spectra of the kernel partitions
+    float *tmp;
+    PartConvChannel *ch;
+} PartConvContext;
+
+/**
+ * Initialize the convolution engine.
+ *
+ * @param block_bits  log2 of the partition size, between 4 and 15
+ * @param max_len     maximum length of the kernels
+ * @param nb_kernels  number of kernels, all zero until set
+ * @param nb_channels number of independently filtered channels
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int ff_partconv_init(PartConvContext *s, int block_bits, int max_len,
+                     int nb_kernels, int nb_channels);
+
+/**
+ * Set kernel k. Like with any av_rdft_calc() based convolution, the taps
+ * must be scaled by 1 / block_size to get unity gain.
+ * The new kernel is used starting with the next filtered sample.
+ *
+ * @param len number of taps, not larger than the max_len given on init
+ */
+void ff_partconv_set_kernel(PartConvContext *s, int k, const float *h, int len);
+
+/**
+ * Filter nb_samples samples of channel ch with kernel k.
+ * dst may be equal to src. Like with ff_partconv_set_kernel(), switching
+ * a channel to another kernel takes effect with the next filtered sample.
+ */
+void ff_partconv_filter(PartConvContext *s, int ch, int k,
+                        float *dst, const float *src, int nb_samples);
+
+void ff_partconv_uninit(PartConvContext *s);
+
+#endif /* AVFILTER_PARTCONV_H */
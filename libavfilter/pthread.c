@@ -49,6 +49,8 @@ typedef struct ThreadContext {
     pthread_cond_t last_job_cond;
     pthread_cond_t current_job_cond;
     pthread_mutex_t current_job_lock;
+    /* serializes the executes of filters running concurrently */
+    pthread_mutex_t execute_lock;
     int current_job;
     unsigned int current_execute;
     int done;
@@ -101,6 +103,7 @@ static void slice_thread_uninit(ThreadContext *c)
          pthread_join(c->workers[i], NULL);
 
     pthread_mutex_destroy(&c->current_job_lock);
+    pthread_mutex_destroy(&c->execute_lock);
     pthread_cond_destroy(&c->current_job_cond);
     pthread_cond_destroy(&c->last_job_cond);
     av_freep(&c->workers);
@@ -113,15 +116,16 @@ static void slice_thread_park_workers(ThreadContext *c)
     pthread_mutex_unlock(&c->current_job_lock);
 }
 
-static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
-                          void *arg, int *ret, int nb_jobs)
+static int thread_execute_internal(ThreadContext *c, AVFilterContext *ctx,
+                                   avfilter_action_func *func,
+                                   void *arg, int *ret, int nb_jobs)
 {
-    ThreadContext *c = ctx->graph->internal->thread;
     int dummy_ret;
 
     if (nb_jobs <= 0)
         return 0;
 
+    pthread_mutex_lock(&c->execute_lock);
     pthread_mutex_lock(&c->current_job_lock);
 
     c->current_job = c->nb_threads;
@@ -141,10 +145,25 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
     pthread_cond_broadcast(&c->current_job_cond);
 
     slice_thread_park_workers(c);
+    pthread_mutex_unlock(&c->execute_lock);
 
     return 0;
 }
 
+static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                          void *arg, int *ret, int nb_jobs)
+{
+    return thread_execute_internal(ctx->graph->internal->thread, ctx,
+                                   func, arg, ret, nb_jobs);
+}
+
+int ff_graph_pipeline_execute(AVFilterGraph *graph, avfilter_action_func *func,
+                              void *arg, int *ret, int nb_jobs)
+{
+    return thread_execute_internal(graph->internal->pipeline, NULL,
+                                   func, arg, ret, nb_jobs);
+}
+
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
     int i, ret;
@@ -174,6 +193,7 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
     pthread_cond_init(&c->last_job_cond,    NULL);
 
     pthread_mutex_init(&c->current_job_lock, NULL);
+    pthread_mutex_init(&c->execute_lock, NULL);
     pthread_mutex_lock(&c->current_job_lock);
     for (i = 0; i < nb_threads; i++) {
         ret = pthread_create(&c->workers[i], NULL, worker, c);
@@ -218,6 +238,19 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
     graph->internal->thread_execute = thread_execute;
 
+    if (graph->thread_type & AVFILTER_THREAD_PIPELINE) {
+        graph->internal->pipeline = av_mallocz(sizeof(ThreadContext));
+        if (!graph->internal->pipeline)
+            return AVERROR(ENOMEM);
+
+        ret = thread_init_internal(graph->internal->pipeline, graph->nb_threads);
+        if (ret <= 1) {
+            av_freep(&graph->internal->pipeline);
+            graph->thread_type &= ~AVFILTER_THREAD_PIPELINE;
+            return (ret < 0) ? ret : 0;
+        }
+    }
+
     return 0;
 }
 
@@ -226,4 +259,7 @@ void ff_graph_thread_free(AVFilterGraph *graph)
     if (graph->internal->thread)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
+    if (graph->internal->pipeline)
+        slice_thread_uninit(graph->internal->pipeline);
+    av_freep(&graph->internal->pipeline);
 }
@@ -17,10 +17,84 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
+#include "libavutil/common.h"
 #include "libavutil/pixdesc.h"
 #include "libavfilter/drawutils.h"
 
+#define W 16
+#define H 4
+
+/* an 8-bit glyph and a 1-bit glyph next to it, 3 pixels wide each */
+static const uint8_t glyph8[] = { 0x40, 0xc0, 0xff,
+                                  0x80, 0xff, 0x80 };
+static const uint8_t glyph1[] = { 0xa0,
+                                  0xe0 };
+
+static void print_image(FFDrawContext *draw, uint8_t *data[], int linesize[])
+{
+    int plane, x, y;
+
+    for (plane = 0; plane < draw->nb_planes; plane++) {
+        for (y = 0; y < AV_CEIL_RSHIFT(H, draw->vsub[plane]); y++) {
+            printf("    %d:", plane);
+            for (x = 0; x < AV_CEIL_RSHIFT(W, draw->hsub[plane]); x++)
+                printf(" %02x", data[plane][y * linesize[plane] + x]);
+            printf("\n");
+        }
+    }
+}
+
+/* Draw the two glyphs side by side at an odd row, once with a blend per glyph and once
+ * combined into a single mask, and print the difference. On subsampled chroma
+ * the glyphs share a chroma sample, and the results are expected to differ
+ * there. */
+static void test_blend_mask(enum AVPixelFormat f)
+{
+    static uint8_t buf[2][3][W * H];
+    uint8_t *data[2][4] = { { buf[0][0], buf[0][1], buf[0][2] },
+                            { buf[1][0], buf[1][1], buf[1][2] } };
+    int linesize[4] = { W, W, W };
+    uint8_t block[6 * 2] = { 0 };
+    FFDrawContext draw;
+    FFDrawColor black, red;
+    int plane, i, x, y;
+
+    printf("Blending %s\n", av_get_pix_fmt_name(f));
+    if (ff_draw_init(&draw, f, 0) < 0)
+        return;
+    ff_draw_color(&draw, &black, (uint8_t[]) { 0, 0, 0, 255 });
+    ff_draw_color(&draw, &red,   (uint8_t[]) { 255, 0, 0, 255 });
+
+    for (i = 0; i < 2; i++)
+        ff_fill_rectangle(&draw, &black, data[i], linesize, 0, 0, W, H);
+
+    ff_blend_mask(&draw, &red, data[0], linesize, W, H,
+                  glyph8, 3, 3, 2, 3, 0, 6, 1);
+    ff_blend_mask(&draw, &red, data[0], linesize, W, H,
+                  glyph1, 1, 3, 2, 0, 0, 9, 1);
+
+    ff_combine_mask(block,     6, glyph8, 3, 3, 2, 3);
+    ff_combine_mask(block + 3, 6, glyph1, 1, 3, 2, 0);
+    ff_blend_mask(&draw, &red, data[1], linesize, W, H,
+                  block, 6, 6, 2, 3, 0, 6, 1);
+
+    printf("  one blend per glyph:\n");
+    print_image(&draw, data[0], linesize);
+    printf("  combined mask:\n");
+    print_image(&draw, data[1], linesize);
+    for (plane = 0; plane < draw.nb_planes; plane++) {
+        int diff = 0;
+
+        for (y = 0; y < AV_CEIL_RSHIFT(H, draw.vsub[plane]); y++)
+            for (x = 0; x < AV_CEIL_RSHIFT(W, draw.hsub[plane]); x++)
+                diff = FFMAX(diff, FFABS(data[1][plane][y * W + x] -
+                                         data[0][plane][y * W + x]));
+        printf("  plane %d: max difference %d\n", plane, diff);
+    }
+}
+
 int main(void)
 {
     enum AVPixelFormat f;
@@ -52,5 +126,8 @@ int main(void)
         }
         printf("ok\n");
     }
+
+    test_blend_mask(AV_PIX_FMT_YUV444P);
+    test_blend_mask(AV_PIX_FMT_YUV420P);
     return 0;
 }
@@ -25,4 +25,11 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Run nb_jobs calls of func concurrently on the pipeline threads of the
+ * graph; func is called with a NULL filter context.
+ */
+int ff_graph_pipeline_execute(AVFilterGraph *graph, avfilter_action_func *func,
+                              void *arg, int *ret, int nb_jobs);
+
 #endif /* AVFILTER_THREAD_H */
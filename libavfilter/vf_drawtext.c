@@ -128,6 +128,17 @@ enum var_name {
     VAR_VARS_NB
 };
 
+/**
+ * Coverage of all the glyphs of the text, composited into a single 8-bit
+ * mask so it can be blended with one call per color.
+ */
+typedef struct TextBlock {
+    uint8_t *mask;
+    unsigned int mask_size;
+    int x, y;                       ///< position relative to the text origin
+    int w, h;
+} TextBlock;
+
 enum expansion_mode {
     EXP_NONE,
     EXP_NORMAL,
@@ -193,6 +204,9 @@ typedef struct DrawTextContext {
     int text_shaping;               ///< 1 to shape the text before drawing it
 #endif
     AVDictionary *metadata;
+    char *layout_text;              ///< expanded text the cached layout was computed for
+    TextBlock text_block;           ///< cached coverage of the glyphs
+    TextBlock border_block;         ///< cached coverage of the glyph borders
 } DrawTextContext;
 
 #define OFFSET(x) offsetof(DrawTextContext, x)
@@ -710,7 +724,10 @@ static av_cold void uninit(AVFilterContext *ctx)
     s->x_pexpr = s->y_pexpr = NULL;
     av_freep(&s->positions);
     s->nb_positions = 0;
-
+    av_freep(&s->layout_text);
+    av_freep(&s->text_block.mask);
+    av_freep(&s->border_block.mask);
+    s->text_block.mask_size = s->border_block.mask_size = 0;
 
     av_tree_enumerate(s->glyphs, NULL, NULL, glyph_enu_free);
     av_tree_destroy(s->glyphs);
@@ -1070,49 +1087,92 @@ static int expand_text(AVFilterContext *ctx, char *text, AVBPrint *bp)
     return 0;
 }
 
-static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
-                       int width, int height,
-                       FFDrawColor *color,
-                       int x, int y, int borderw)
+static int build_text_block(DrawTextContext *s, TextBlock *b, int borderw)
 {
     char *text = s->expanded_text.str;
     uint32_t code = 0;
-    int i, x1, y1;
+    int i, pass;
+    int x_min = INT_MAX, y_min = INT_MAX, x_max = INT_MIN, y_max = INT_MIN;
     uint8_t *p;
     Glyph *glyph = NULL;
 
-    for (i = 0, p = text; *p; i++) {
-        FT_Bitmap bitmap;
-        Glyph dummy = { 0 };
-        GET_UTF8(code, *p++, continue;);
-
-        /* skip new line chars, just go to new line */
-        if (code == '\n' || code == '\r' || code == '\t')
-            continue;
-
-        dummy.code = code;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-
-        bitmap = borderw ? glyph->border_bitmap : glyph->bitmap;
-
-        if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
-            glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
-            return AVERROR(EINVAL);
+    b->w = b->h = 0;
+
+    /* the first pass computes the bounding box, the second one composites
+     * the glyphs into the mask */
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0, p = text; *p; i++) {
+            FT_Bitmap bitmap;
+            Glyph dummy = { 0 };
+            int x1, y1;
+            GET_UTF8(code, *p++, continue;);
+
+            /* skip new line chars, just go to new line */
+            if (code == '\n' || code == '\r' || code == '\t')
+                continue;
+
+            dummy.code = code;
+            glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+
+            bitmap = borderw ? glyph->border_bitmap : glyph->bitmap;
+
+            if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
+                glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
+                return AVERROR(EINVAL);
+
+            x1 = s->positions[i].x - borderw;
+            y1 = s->positions[i].y - borderw;
+
+            if (!pass) {
+                if (!bitmap.width || !bitmap.rows)
+                    continue;
+                x_min = FFMIN(x_min, x1);
+                y_min = FFMIN(y_min, y1);
+                x_max = FFMAX(x_max, x1 + (int)bitmap.width);
+                y_max = FFMAX(y_max, y1 + (int)bitmap.rows);
+                continue;
+            }
 
-        x1 = s->positions[i].x+s->x+x - borderw;
-        y1 = s->positions[i].y+s->y+y - borderw;
+            /* overlapping glyphs combine like successive blends, glyphs
+             * that only share a subsampled chroma sample do not, see
+             * ff_combine_mask() */
+            ff_combine_mask(b->mask + (y1 - b->y) * b->w + x1 - b->x, b->w,
+                            bitmap.buffer, bitmap.pitch,
+                            bitmap.width, bitmap.rows,
+                            bitmap.pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3);
+        }
 
-        ff_blend_mask(&s->dc, color,
-                      frame->data, frame->linesize, width, height,
-                      bitmap.buffer, bitmap.pitch,
-                      bitmap.width, bitmap.rows,
-                      bitmap.pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3,
-                      0, x1, y1);
+        if (!pass) {
+            if (x_min >= x_max || y_min >= y_max)
+                return 0;
+            b->x = x_min;
+            b->y = y_min;
+            b->w = x_max - x_min;
+            b->h = y_max - y_min;
+            av_fast_malloc(&b->mask, &b->mask_size, b->w * b->h);
+            if (!b->mask) {
+                b->w = b->h = 0;
+                return AVERROR(ENOMEM);
+            }
+            memset(b->mask, 0, b->w * b->h);
+        }
     }
 
     return 0;
 }
 
+static void draw_text_block(DrawTextContext *s, AVFrame *frame,
+                            int width, int height, FFDrawColor *color,
+                            const TextBlock *b, int x, int y)
+{
+    if (!b->w)
+        return;
+
+    ff_blend_mask(&s->dc, color,
+                  frame->data, frame->linesize, width, height,
+                  b->mask, b->w, b->w, b->h, 3, 0,
+                  s->x + x + b->x, s->y + y + b->y);
+}
 
 static void update_color_with_alpha(DrawTextContext *s, FFDrawColor *color, const FFDrawColor incolor)
 {
@@ -1184,7 +1244,7 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
 
     if (s->tc_opt_string) {
         char tcbuf[AV_TIMECODE_STR_SIZE];
-        av_timecode_make_string(&s->tc, tcbuf, inlink->frame_count);
+        av_timecode_make_string(&s->tc, tcbuf, inlink->frame_count_out);
         av_bprint_clear(bp);
         av_bprintf(bp, "%s%s", s->text, tcbuf);
     }
@@ -1213,6 +1273,10 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
         ff_draw_color(&s->dc, &s->fontcolor, s->fontcolor.rgba);
     }
 
+    /* the layout and the glyph coverage only depend on the text */
+    if (s->layout_text && !strcmp(s->layout_text, text))
+        goto draw;
+
     x = 0;
     y = 0;
 
@@ -1286,6 +1350,14 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
 
     s->var_values[VAR_LINE_H] = s->var_values[VAR_LH] = s->max_glyph_h;
 
+    av_freep(&s->layout_text);
+    if ((ret = build_text_block(s, &s->text_block, 0)) < 0 ||
+        (s->borderw && (ret = build_text_block(s, &s->border_block, s->borderw)) < 0))
+        return ret;
+    if (!(s->layout_text = av_strdup(text)))
+        return AVERROR(ENOMEM);
+
+draw:
     s->x = s->var_values[VAR_X] = av_expr_eval(s->x_pexpr, s->var_values, &s->prng);
     s->y = s->var_values[VAR_Y] = av_expr_eval(s->y_pexpr, s->var_values, &s->prng);
     s->x = s->var_values[VAR_X] = av_expr_eval(s->x_pexpr, s->var_values, &s->prng);
@@ -1296,8 +1368,8 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
     update_color_with_alpha(s, &bordercolor, s->bordercolor);
     update_color_with_alpha(s, &boxcolor   , s->boxcolor   );
 
-    box_w = FFMIN(width - 1 , max_text_line_w);
-    box_h = FFMIN(height - 1, y + s->max_glyph_h);
+    box_w = FFMIN(width - 1 , s->var_values[VAR_TEXT_W]);
+    box_h = FFMIN(height - 1, s->var_values[VAR_TEXT_H]);
 
     /* draw box */
     if (s->draw_box)
@@ -1306,20 +1378,16 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
                            s->x - s->boxborderw, s->y - s->boxborderw,
                            box_w + s->boxborderw * 2, box_h + s->boxborderw * 2);
 
-    if (s->shadowx || s->shadowy) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &shadowcolor, s->shadowx, s->shadowy, 0)) < 0)
-            return ret;
-    }
+    if (s->shadowx || s->shadowy)
+        draw_text_block(s, frame, width, height, &shadowcolor,
+                        &s->text_block, s->shadowx, s->shadowy);
 
-    if (s->borderw) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &bordercolor, 0, 0, s->borderw)) < 0)
-            return ret;
-    }
-    if ((ret = draw_glyphs(s, frame, width, height,
-                           &fontcolor, 0, 0, 0)) < 0)
-        return ret;
+    if (s->borderw)
+        draw_text_block(s, frame, width, height, &bordercolor,
+                        &s->border_block, 0, 0);
+
+    draw_text_block(s, frame, width, height, &fontcolor,
+                    &s->text_block, 0, 0);
 
     return 0;
 }
@@ -1345,7 +1413,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 #endif
     }
 
-    s->var_values[VAR_N] = inlink->frame_count+s->start_number;
+    s->var_values[VAR_N] = inlink->frame_count_out+s->start_number;
     s->var_values[VAR_T] = frame->pts == AV_NOPTS_VALUE ?
         NAN : frame->pts * av_q2d(inlink->time_base);
 
@@ -258,14 +258,15 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     const AVPixFmtDescriptor *desc;
     int i;
 
-    out = ff_get_video_buffer(outlink, inlink->w, inlink->h);
-    if (!out)
+    out = ff_get_video_buffer_inplace(outlink, in);
+    if (!out) {
+        av_frame_free(&in);
         return AVERROR(ENOMEM);
+    }
 
-    av_frame_copy_props(out, in);
     desc = av_pix_fmt_desc_get(inlink->format);
 
-    eq->var_values[VAR_N]   = inlink->frame_count;
+    eq->var_values[VAR_N]   = inlink->frame_count_out;
     eq->var_values[VAR_POS] = pos == -1 ? NAN : pos;
     eq->var_values[VAR_T]   = TS2T(in->pts, inlink->time_base);
 
@@ -288,12 +289,13 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         if (eq->param[i].adjust)
             eq->param[i].adjust(&eq->param[i], out->data[i], out->linesize[i],
                                  in->data[i], in->linesize[i], w, h);
-        else
+        else if (out != in)
             av_image_copy_plane(out->data[i], out->linesize[i],
                                 in->data[i], in->linesize[i], w, h);
     }
 
-    av_frame_free(&in);
+    if (out != in)
+        av_frame_free(&in);
     return ff_filter_frame(outlink, out);
 }
 
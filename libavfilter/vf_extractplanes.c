@@ -245,7 +245,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
         const int idx = s->map[i];
         AVFrame *out;
 
-        if (outlink->status)
+        if (outlink->status_out)
             continue;
 
         out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
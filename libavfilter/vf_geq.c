@@ -33,14 +33,20 @@
 #include "libavutil/pixdesc.h"
 #include "internal.h"
 
+#define MAX_NB_THREADS 32
+
 typedef struct {
     const AVClass *class;
-    AVExpr *e[4];               ///< expressions for each plane
+    AVExpr *e[4][MAX_NB_THREADS]; ///< expressions for each plane and thread
     char *expr_str[4+3];        ///< expression strings for each plane
     AVFrame *picref;            ///< current input buffer
     int hsub, vsub;             ///< chroma subsampling
     int planes;                 ///< number of planes
     int is_rgb;
+    int is_stateless;           ///< no expression carries state between pixels
+    int nb_threads;             ///< number of parsed copies of each expression
+    double *xs;                 ///< X coordinates of a line
+    double *line[MAX_NB_THREADS]; ///< results of a line for each thread
 } GEQContext;
 
 enum { Y = 0, U, V, A, G, B, R };
@@ -101,6 +107,19 @@ static double alpha(void *priv, double x, double y) { return getpix(priv, x, y,
 static const char *const var_names[] = {   "X",   "Y",   "W",   "H",   "N",   "SW",   "SH",   "T",        NULL };
 enum                                   { VAR_X, VAR_Y, VAR_W, VAR_H, VAR_N, VAR_SW, VAR_SH, VAR_T, VAR_VARS_NB };
 
+static int parse_expr(AVFilterContext *ctx, int plane, int thread)
+{
+    GEQContext *geq = ctx->priv;
+    static double (*p[])(void *, double, double) = { lum, cb, cr, alpha };
+    static const char *const func2_yuv_names[]    = { "lum", "cb", "cr", "alpha", "p", NULL };
+    static const char *const func2_rgb_names[]    = { "g", "b", "r", "alpha", "p", NULL };
+    const char *const *func2_names       = geq->is_rgb ? func2_rgb_names : func2_yuv_names;
+    double (*func2[])(void *, double, double) = { lum, cb, cr, alpha, p[plane], NULL };
+
+    return av_expr_parse(&geq->e[plane][thread], geq->expr_str[plane < 3 && geq->is_rgb ? plane+4 : plane], var_names,
+                         NULL, NULL, func2_names, func2, 0, ctx);
+}
+
 static av_cold int geq_init(AVFilterContext *ctx)
 {
     GEQContext *geq = ctx->priv;
@@ -146,17 +165,13 @@ static av_cold int geq_init(AVFilterContext *ctx)
         goto end;
     }
 
+    geq->nb_threads = 1;
+    geq->is_stateless = 1;
     for (plane = 0; plane < 4; plane++) {
-        static double (*p[])(void *, double, double) = { lum, cb, cr, alpha };
-        static const char *const func2_yuv_names[]    = { "lum", "cb", "cr", "alpha", "p", NULL };
-        static const char *const func2_rgb_names[]    = { "g", "b", "r", "alpha", "p", NULL };
-        const char *const *func2_names       = geq->is_rgb ? func2_rgb_names : func2_yuv_names;
-        double (*func2[])(void *, double, double) = { lum, cb, cr, alpha, p[plane], NULL };
-
-        ret = av_expr_parse(&geq->e[plane], geq->expr_str[plane < 3 && geq->is_rgb ? plane+4 : plane], var_names,
-                            NULL, NULL, func2_names, func2, 0, ctx);
+        ret = parse_expr(ctx, plane, 0);
         if (ret < 0)
             break;
+        geq->is_stateless &= av_expr_is_stateless(geq->e[plane][0]);
     }
 
 end:
@@ -190,26 +205,98 @@ static int geq_query_formats(AVFilterContext *ctx)
 
 static int geq_config_props(AVFilterLink *inlink)
 {
-    GEQContext *geq = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
+    GEQContext *geq = ctx->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    int nb_threads = FFMIN(ff_filter_get_nb_threads(ctx), MAX_NB_THREADS);
+    int plane, i, ret;
+
+    /* the output of st(), random() and the like would depend on the slicing */
+    if (!geq->is_stateless)
+        nb_threads = 1;
 
     av_assert0(desc);
 
     geq->hsub = desc->log2_chroma_w;
     geq->vsub = desc->log2_chroma_h;
     geq->planes = desc->nb_components;
+
+    /* every thread needs its own copy of the expressions, they hold the
+     * variables and the scratch space of the evaluator */
+    for (; geq->nb_threads < nb_threads; geq->nb_threads++) {
+        for (plane = 0; plane < 4; plane++) {
+            ret = parse_expr(ctx, plane, geq->nb_threads);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    av_freep(&geq->xs);
+    geq->xs = av_malloc_array(inlink->w, sizeof(*geq->xs));
+    if (!geq->xs)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < inlink->w; i++)
+        geq->xs[i] = i;
+
+    for (i = 0; i < geq->nb_threads; i++) {
+        av_freep(&geq->line[i]);
+        geq->line[i] = av_malloc_array(inlink->w, sizeof(*geq->line[i]));
+        if (!geq->line[i])
+            return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+typedef struct ThreadData {
+    uint8_t *dst;
+    int linesize;
+    int plane;
+    int w, h;
+    double values[VAR_VARS_NB];
+} ThreadData;
+
+static int slice_geq_filter(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    GEQContext *geq = ctx->priv;
+    ThreadData *td = arg;
+    const int slice_start = (td->h *  jobnr   ) / nb_jobs;
+    const int slice_end   = (td->h * (jobnr+1)) / nb_jobs;
+    const double *arrays[VAR_VARS_NB] = { [VAR_X] = geq->xs };
+    AVExpr *e = geq->e[td->plane][jobnr];
+    double *line = geq->line[jobnr];
+    uint8_t *dst = td->dst + slice_start * td->linesize;
+    double values[VAR_VARS_NB];
+    int x, y, ret;
+
+    memcpy(values, td->values, sizeof(values));
+
+    for (y = slice_start; y < slice_end; y++) {
+        values[VAR_Y] = y;
+        ret = av_expr_eval_array(e, line, td->w, values, arrays, geq);
+        if (ret < 0)
+            return ret;
+        for (x = 0; x < td->w; x++)
+            dst[x] = line[x];
+        dst += td->linesize;
+    }
+
     return 0;
 }
 
 static int geq_filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
-    int plane;
-    GEQContext *geq = inlink->dst->priv;
-    AVFilterLink *outlink = inlink->dst->outputs[0];
+    int plane, nb_jobs, i;
+    int jobs_ret[MAX_NB_THREADS];
+    AVFilterContext *ctx = inlink->dst;
+    GEQContext *geq = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out;
-    double values[VAR_VARS_NB] = {
-        [VAR_N] = inlink->frame_count,
-        [VAR_T] = in->pts == AV_NOPTS_VALUE ? NAN : in->pts * av_q2d(inlink->time_base),
+    ThreadData td = {
+        .values = {
+            [VAR_N] = inlink->frame_count_out,
+            [VAR_T] = in->pts == AV_NOPTS_VALUE ? NAN : in->pts * av_q2d(inlink->time_base),
+        },
     };
 
     geq->picref = in;
@@ -221,24 +308,27 @@ static int geq_filter_frame(AVFilterLink *inlink, AVFrame *in)
     av_frame_copy_props(out, in);
 
     for (plane = 0; plane < geq->planes && out->data[plane]; plane++) {
-        int x, y;
-        uint8_t *dst = out->data[plane];
-        const int linesize = out->linesize[plane];
         const int w = (plane == 1 || plane == 2) ? AV_CEIL_RSHIFT(inlink->w, geq->hsub) : inlink->w;
         const int h = (plane == 1 || plane == 2) ? AV_CEIL_RSHIFT(inlink->h, geq->vsub) : inlink->h;
 
-        values[VAR_W]  = w;
-        values[VAR_H]  = h;
-        values[VAR_SW] = w / (double)inlink->w;
-        values[VAR_SH] = h / (double)inlink->h;
-
-        for (y = 0; y < h; y++) {
-            values[VAR_Y] = y;
-            for (x = 0; x < w; x++) {
-                values[VAR_X] = x;
-                dst[x] = av_expr_eval(geq->e[plane], values, geq);
+        td.dst      = out->data[plane];
+        td.linesize = out->linesize[plane];
+        td.plane    = plane;
+        td.w        = w;
+        td.h        = h;
+        td.values[VAR_W]  = w;
+        td.values[VAR_H]  = h;
+        td.values[VAR_SW] = w / (double)inlink->w;
+        td.values[VAR_SH] = h / (double)inlink->h;
+
+        nb_jobs = FFMIN(h, geq->nb_threads);
+        ctx->internal->execute(ctx, slice_geq_filter, &td, jobs_ret, nb_jobs);
+        for (i = 0; i < nb_jobs; i++) {
+            if (jobs_ret[i] < 0) {
+                av_frame_free(&geq->picref);
+                av_frame_free(&out);
+                return jobs_ret[i];
             }
-            dst += linesize;
         }
     }
 
@@ -248,11 +338,15 @@ static int geq_filter_frame(AVFilterLink *inlink, AVFrame *in)
 
 static av_cold void geq_uninit(AVFilterContext *ctx)
 {
-    int i;
+    int i, j;
     GEQContext *geq = ctx->priv;
 
     for (i = 0; i < FF_ARRAY_ELEMS(geq->e); i++)
-        av_expr_free(geq->e[i]);
+        for (j = 0; j < MAX_NB_THREADS; j++)
+            av_expr_free(geq->e[i][j]);
+    for (j = 0; j < MAX_NB_THREADS; j++)
+        av_freep(&geq->line[j]);
+    av_freep(&geq->xs);
 }
 
 static const AVFilterPad geq_inputs[] = {
@@ -283,5 +377,5 @@ AVFilter ff_vf_geq = {
     .inputs        = geq_inputs,
     .outputs       = geq_outputs,
     .priv_class    = &geq_class,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
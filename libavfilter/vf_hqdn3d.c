@@ -120,16 +120,126 @@ static void denoise_spatial(HQDN3DContext *s,
     }
 }
 
+/**
+ * Filter the rows [y0, y1) of the columns [x0, x1) of a plane.
+ *
+ * Both the horizontal and the vertical low-pass are recursive, so a block
+ * needs the block on its left and the one above it to be done: line_ant
+ * carries the state down the columns and pixel_ant[y] the state of row y
+ * across the band edges.
+ */
+av_always_inline
+static void denoise_spatial_block(uint8_t *src, uint8_t *dst,
+                                  uint16_t *line_ant, uint16_t *frame_ant,
+                                  uint32_t *pixel_ant_edge,
+                                  int x0, int x1, int y0, int y1, int w,
+                                  int sstride, int dstride,
+                                  int16_t *spatial, int16_t *temporal, int depth)
+{
+    long x, y;
+    uint32_t pixel_ant;
+    uint32_t tmp;
+
+    spatial  += 256 << LUT_BITS;
+    temporal += 256 << LUT_BITS;
+
+    src       += y0 * sstride;
+    dst       += y0 * dstride;
+    frame_ant += y0 * w;
+
+    for (y = y0; y < y1; y++) {
+        pixel_ant = x0 ? pixel_ant_edge[y] : LOAD(0);
+        if (!y) {
+            /* First line has no top neighbor. Only left one for each tmp and
+             * last frame */
+            for (x = x0; x < x1; x++) {
+                line_ant[x] = tmp = pixel_ant = lowpass(pixel_ant, LOAD(x), spatial, depth);
+                frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+                STORE(x, tmp);
+            }
+        } else {
+            for (x = x0; x < x1; x++) {
+                line_ant[x] = tmp = lowpass(line_ant[x], pixel_ant, spatial, depth);
+                if (x < w - 1)
+                    pixel_ant = lowpass(pixel_ant, LOAD(x+1), spatial, depth);
+                frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+                STORE(x, tmp);
+            }
+        }
+        pixel_ant_edge[y] = pixel_ant;
+        src += sstride;
+        dst += dstride;
+        frame_ant += w;
+    }
+}
+
+typedef struct ThreadData {
+    uint8_t *src, *dst;
+    uint16_t *line_ant, *frame_ant;
+    uint32_t *pixel_ant;
+    int w, h, sstride, dstride;
+    int16_t *spatial, *temporal;
+    int rows;                       ///< number of rows of a block
+    int wave;                       ///< index of the current anti-diagonal of blocks
+} ThreadData;
+
+av_always_inline
+static void denoise_slice(ThreadData *td, int jobnr, int nb_jobs, int depth)
+{
+    if (td->spatial[0]) {
+        /* blocks on the same anti-diagonal are independent */
+        const int y0 = (td->wave - jobnr) * td->rows;
+        const int y1 = FFMIN(y0 + td->rows, td->h);
+
+        if (y0 < 0 || y0 >= td->h)
+            return;
+        denoise_spatial_block(td->src, td->dst, td->line_ant, td->frame_ant,
+                              td->pixel_ant,
+                              (td->w *  jobnr   ) / nb_jobs,
+                              (td->w * (jobnr+1)) / nb_jobs,
+                              y0, y1, td->w, td->sstride, td->dstride,
+                              td->spatial, td->temporal, depth);
+    } else {
+        const int y0 = (td->h *  jobnr   ) / nb_jobs;
+        const int y1 = (td->h * (jobnr+1)) / nb_jobs;
+
+        denoise_temporal(td->src + y0 * td->sstride, td->dst + y0 * td->dstride,
+                         td->frame_ant + y0 * td->w,
+                         td->w, y1 - y0, td->sstride, td->dstride,
+                         td->temporal, depth);
+    }
+}
+
+#define DENOISE_SLICE(depth)                                                  \
+static int denoise_slice_##depth(AVFilterContext *ctx, void *arg,             \
+                                 int jobnr, int nb_jobs)                      \
+{                                                                             \
+    denoise_slice(arg, jobnr, nb_jobs, depth);                                \
+    return 0;                                                                 \
+}
+
+DENOISE_SLICE(8)
+DENOISE_SLICE(9)
+DENOISE_SLICE(10)
+DENOISE_SLICE(16)
+
 av_always_inline
-static int denoise_depth(HQDN3DContext *s,
+static int denoise_depth(AVFilterContext *ctx,
                          uint8_t *src, uint8_t *dst,
                          uint16_t *line_ant, uint16_t **frame_ant_ptr,
+                         uint32_t *pixel_ant,
                          int w, int h, int sstride, int dstride,
                          int16_t *spatial, int16_t *temporal, int depth)
 {
     // FIXME: For 16-bit depth, frame_ant could be a pointer to the previous
     // filtered frame rather than a separate buffer.
+    HQDN3DContext *s = ctx->priv;
+    int (*slice_fn)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs) =
+        depth ==  8 ? denoise_slice_8  :
+        depth ==  9 ? denoise_slice_9  :
+        depth == 10 ? denoise_slice_10 : denoise_slice_16;
     long x, y;
+    int nb_jobs;
     uint16_t *frame_ant = *frame_ant_ptr;
     if (!frame_ant) {
         uint8_t *frame_src = src;
@@ -144,11 +254,38 @@ static int denoise_depth(HQDN3DContext *s,
     }
 
     if (spatial[0])
-        denoise_spatial(s, src, dst, line_ant, frame_ant,
-                        w, h, sstride, dstride, spatial, temporal, depth);
+        nb_jobs = FFMIN(s->nb_threads, w / 32);
     else
-        denoise_temporal(src, dst, frame_ant,
-                         w, h, sstride, dstride, temporal, depth);
+        nb_jobs = FFMIN(s->nb_threads, h);
+
+    if (nb_jobs <= 1) {
+        if (spatial[0])
+            denoise_spatial(s, src, dst, line_ant, frame_ant,
+                            w, h, sstride, dstride, spatial, temporal, depth);
+        else
+            denoise_temporal(src, dst, frame_ant,
+                             w, h, sstride, dstride, temporal, depth);
+    } else {
+        ThreadData td = {
+            .src = src, .dst = dst,
+            .line_ant = line_ant, .frame_ant = frame_ant, .pixel_ant = pixel_ant,
+            .w = w, .h = h, .sstride = sstride, .dstride = dstride,
+            .spatial = spatial, .temporal = temporal,
+        };
+
+        if (spatial[0]) {
+            /* the columns are split in nb_jobs bands and the rows in groups,
+             * every call processes one anti-diagonal of blocks; use enough
+             * groups to keep the jobs busy most of the time */
+            const int nb_groups = FFMIN(h, 8 * nb_jobs);
+
+            td.rows = (h + nb_groups - 1) / nb_groups;
+            for (td.wave = 0; td.wave < (h + td.rows - 1) / td.rows + nb_jobs - 1; td.wave++)
+                ctx->internal->execute(ctx, slice_fn, &td, NULL, nb_jobs);
+        } else {
+            ctx->internal->execute(ctx, slice_fn, &td, NULL, nb_jobs);
+        }
+    }
     emms_c();
     return 0;
 }
@@ -227,6 +364,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->frame_prev[0]);
     av_freep(&s->frame_prev[1]);
     av_freep(&s->frame_prev[2]);
+    av_freep(&s->pixel_ant);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -261,7 +399,8 @@ static int query_formats(AVFilterContext *ctx)
 
 static int config_input(AVFilterLink *inlink)
 {
-    HQDN3DContext *s = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
+    HQDN3DContext *s = ctx->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     int i;
 
@@ -271,8 +410,11 @@ static int config_input(AVFilterLink *inlink)
     s->vsub  = desc->log2_chroma_h;
     s->depth = desc->comp[0].depth;
 
-    s->line = av_malloc_array(inlink->w, sizeof(*s->line));
-    if (!s->line)
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+
+    s->line      = av_malloc_array(inlink->w, sizeof(*s->line));
+    s->pixel_ant = av_malloc_array(inlink->h, sizeof(*s->pixel_ant));
+    if (!s->line || !s->pixel_ant)
         return AVERROR(ENOMEM);
 
     for (i = 0; i < 4; i++) {
@@ -309,8 +451,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     }
 
     for (c = 0; c < 3; c++) {
-        denoise(s, in->data[c], out->data[c],
-                s->line, &s->frame_prev[c],
+        denoise(ctx, in->data[c], out->data[c],
+                s->line, &s->frame_prev[c], s->pixel_ant,
                 AV_CEIL_RSHIFT(in->width,  (!!c * s->hsub)),
                 AV_CEIL_RSHIFT(in->height, (!!c * s->vsub)),
                 in->linesize[c], out->linesize[c],
@@ -370,5 +512,5 @@ AVFilter ff_vf_hqdn3d = {
     .query_formats = query_formats,
     .inputs        = avfilter_vf_hqdn3d_inputs,
     .outputs       = avfilter_vf_hqdn3d_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -72,6 +72,10 @@ typedef struct LutContext {
     int negate_alpha; /* only used by negate */
 } LutContext;
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
 #define Y 0
 #define U 1
 #define V 2
@@ -332,40 +336,30 @@ static int config_props(AVFilterLink *inlink)
     return 0;
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+static int lut_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    AVFilterContext *ctx = inlink->dst;
     LutContext *s = ctx->priv;
-    AVFilterLink *outlink = ctx->outputs[0];
-    AVFrame *out;
-    int i, j, plane, direct = 0;
-
-    if (av_frame_is_writable(in)) {
-        direct = 1;
-        out = in;
-    } else {
-        out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
-        if (!out) {
-            av_frame_free(&in);
-            return AVERROR(ENOMEM);
-        }
-        av_frame_copy_props(out, in);
-    }
+    AVFilterLink *inlink = ctx->inputs[0];
+    ThreadData *td = arg;
+    AVFrame *in  = td->in;
+    AVFrame *out = td->out;
+    int i, j, plane;
 
     if (s->is_rgb && s->is_16bit && !s->is_planar) {
         /* packed, 16-bit */
         uint16_t *inrow, *outrow, *inrow0, *outrow0;
         const int w = inlink->w;
-        const int h = in->height;
+        const int slice_start = (in->height *  jobnr     ) / nb_jobs;
+        const int slice_end   = (in->height * (jobnr + 1)) / nb_jobs;
         const uint16_t (*tab)[256*256] = (const uint16_t (*)[256*256])s->lut;
         const int in_linesize  =  in->linesize[0] / 2;
         const int out_linesize = out->linesize[0] / 2;
         const int step = s->step;
 
-        inrow0  = (uint16_t*) in ->data[0];
-        outrow0 = (uint16_t*) out->data[0];
+        inrow0  = (uint16_t*) in ->data[0] + slice_start * in_linesize;
+        outrow0 = (uint16_t*) out->data[0] + slice_start * out_linesize;
 
-        for (i = 0; i < h; i ++) {
+        for (i = slice_start; i < slice_end; i++) {
             inrow  = inrow0;
             outrow = outrow0;
             for (j = 0; j < w; j++) {
@@ -393,16 +387,17 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         /* packed */
         uint8_t *inrow, *outrow, *inrow0, *outrow0;
         const int w = inlink->w;
-        const int h = in->height;
+        const int slice_start = (in->height *  jobnr     ) / nb_jobs;
+        const int slice_end   = (in->height * (jobnr + 1)) / nb_jobs;
         const uint16_t (*tab)[256*256] = (const uint16_t (*)[256*256])s->lut;
         const int in_linesize  =  in->linesize[0];
         const int out_linesize = out->linesize[0];
         const int step = s->step;
 
-        inrow0  = in ->data[0];
-        outrow0 = out->data[0];
+        inrow0  = in ->data[0] + slice_start * in_linesize;
+        outrow0 = out->data[0] + slice_start * out_linesize;
 
-        for (i = 0; i < h; i ++) {
+        for (i = slice_start; i < slice_end; i++) {
             inrow  = inrow0;
             outrow = outrow0;
             for (j = 0; j < w; j++) {
@@ -427,14 +422,16 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
             int hsub = plane == 1 || plane == 2 ? s->hsub : 0;
             int h = AV_CEIL_RSHIFT(inlink->h, vsub);
             int w = AV_CEIL_RSHIFT(inlink->w, hsub);
+            int slice_start = (h *  jobnr     ) / nb_jobs;
+            int slice_end   = (h * (jobnr + 1)) / nb_jobs;
             const uint16_t *tab = s->lut[plane];
             const int in_linesize  =  in->linesize[plane] / 2;
             const int out_linesize = out->linesize[plane] / 2;
 
-            inrow  = (uint16_t *)in ->data[plane];
-            outrow = (uint16_t *)out->data[plane];
+            inrow  = (uint16_t *)in ->data[plane] + slice_start * in_linesize;
+            outrow = (uint16_t *)out->data[plane] + slice_start * out_linesize;
 
-            for (i = 0; i < h; i++) {
+            for (i = slice_start; i < slice_end; i++) {
                 for (j = 0; j < w; j++) {
 #if HAVE_BIGENDIAN
                     outrow[j] = av_bswap16(tab[av_bswap16(inrow[j])]);
@@ -455,14 +452,16 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
             int hsub = plane == 1 || plane == 2 ? s->hsub : 0;
             int h = AV_CEIL_RSHIFT(inlink->h, vsub);
             int w = AV_CEIL_RSHIFT(inlink->w, hsub);
+            int slice_start = (h *  jobnr     ) / nb_jobs;
+            int slice_end   = (h * (jobnr + 1)) / nb_jobs;
             const uint16_t *tab = s->lut[plane];
             const int in_linesize  =  in->linesize[plane];
             const int out_linesize = out->linesize[plane];
 
-            inrow  = in ->data[plane];
-            outrow = out->data[plane];
+            inrow  = in ->data[plane] + slice_start * in_linesize;
+            outrow = out->data[plane] + slice_start * out_linesize;
 
-            for (i = 0; i < h; i++) {
+            for (i = slice_start; i < slice_end; i++) {
                 for (j = 0; j < w; j++)
                     outrow[j] = tab[inrow[j]];
                 inrow  += in_linesize;
@@ -471,6 +470,34 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         }
     }
 
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVFrame *out;
+    ThreadData td;
+    int direct = 0;
+
+    if (av_frame_is_writable(in)) {
+        direct = 1;
+        out = in;
+    } else {
+        out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out) {
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
+        av_frame_copy_props(out, in);
+    }
+
+    td.in  = in;
+    td.out = out;
+    ctx->internal->execute(ctx, lut_slice, &td, NULL,
+                           FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
+
     if (!direct)
         av_frame_free(&in);
 
@@ -503,7 +530,8 @@ static const AVFilterPad outputs[] = {
         .query_formats = query_formats,                                 \
         .inputs        = inputs,                                        \
         .outputs       = outputs,                                       \
-        .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,        \
+        .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC |       \
+                         AVFILTER_FLAG_SLICE_THREADS,                   \
     }
 
 #if CONFIG_LUT_FILTER
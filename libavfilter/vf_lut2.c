@@ -62,11 +62,15 @@ typedef struct LUT2Context {
     int nb_planes;
     int depth, depthx, depthy;
 
-    void (*lut2)(struct LUT2Context *s, AVFrame *dst, AVFrame *srcx, AVFrame *srcy);
+    int (*lut2)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
 
     FFFrameSync fs;
 } LUT2Context;
 
+typedef struct ThreadData {
+    AVFrame *out, *srcx, *srcy;
+} ThreadData;
+
 #define OFFSET(x) offsetof(LUT2Context, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
 
@@ -148,20 +152,27 @@ static int config_inputy(AVFilterLink *inlink)
     return 0;
 }
 
-static void lut2_8bit(struct LUT2Context *s, AVFrame *out, AVFrame *srcx, AVFrame *srcy)
+static int lut2_8bit(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    LUT2Context *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *out  = td->out;
+    AVFrame *srcx = td->srcx;
+    AVFrame *srcy = td->srcy;
     int p, y, x;
 
     for (p = 0; p < s->nb_planes; p++) {
+        const int slice_start = (s->height[p] *  jobnr     ) / nb_jobs;
+        const int slice_end   = (s->height[p] * (jobnr + 1)) / nb_jobs;
         const uint16_t *lut = s->lut[p];
         const uint8_t *srcxx, *srcyy;
         uint8_t *dst;
 
-        dst   = out->data[p];
-        srcxx = srcx->data[p];
-        srcyy = srcy->data[p];
+        dst   = out->data[p]  + slice_start * out->linesize[p];
+        srcxx = srcx->data[p] + slice_start * srcx->linesize[p];
+        srcyy = srcy->data[p] + slice_start * srcy->linesize[p];
 
-        for (y = 0; y < s->height[p]; y++) {
+        for (y = slice_start; y < slice_end; y++) {
             for (x = 0; x < s->width[p]; x++) {
                 dst[x] = lut[(srcyy[x] << s->depthx) | srcxx[x]];
             }
@@ -171,22 +182,30 @@ static void lut2_8bit(struct LUT2Context *s, AVFrame *out, AVFrame *srcx, AVFram
             srcyy += srcy->linesize[p];
         }
     }
+    return 0;
 }
 
-static void lut2_16bit(struct LUT2Context *s, AVFrame *out, AVFrame *srcx, AVFrame *srcy)
+static int lut2_16bit(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    LUT2Context *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *out  = td->out;
+    AVFrame *srcx = td->srcx;
+    AVFrame *srcy = td->srcy;
     int p, y, x;
 
     for (p = 0; p < s->nb_planes; p++) {
+        const int slice_start = (s->height[p] *  jobnr     ) / nb_jobs;
+        const int slice_end   = (s->height[p] * (jobnr + 1)) / nb_jobs;
         const uint16_t *lut = s->lut[p];
         const uint16_t *srcxx, *srcyy;
         uint16_t *dst;
 
-        dst   = (uint16_t *)out->data[p];
-        srcxx = (uint16_t *)srcx->data[p];
-        srcyy = (uint16_t *)srcy->data[p];
+        dst   = (uint16_t *)(out->data[p]  + slice_start * out->linesize[p]);
+        srcxx = (uint16_t *)(srcx->data[p] + slice_start * srcx->linesize[p]);
+        srcyy = (uint16_t *)(srcy->data[p] + slice_start * srcy->linesize[p]);
 
-        for (y = 0; y < s->height[p]; y++) {
+        for (y = slice_start; y < slice_end; y++) {
             for (x = 0; x < s->width[p]; x++) {
                 dst[x] = lut[(srcyy[x] << s->depthx) | srcxx[x]];
             }
@@ -196,6 +215,7 @@ static void lut2_16bit(struct LUT2Context *s, AVFrame *out, AVFrame *srcx, AVFra
             srcyy += srcy->linesize[p] / 2;
         }
     }
+    return 0;
 }
 
 static int process_frame(FFFrameSync *fs)
@@ -204,6 +224,7 @@ static int process_frame(FFFrameSync *fs)
     LUT2Context *s = fs->opaque;
     AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out, *srcx, *srcy;
+    ThreadData td;
     int ret;
 
     if ((ret = ff_framesync_get_frame(&s->fs, 0, &srcx, 0)) < 0 ||
@@ -220,7 +241,11 @@ static int process_frame(FFFrameSync *fs)
             return AVERROR(ENOMEM);
         av_frame_copy_props(out, srcx);
 
-        s->lut2(s, out, srcx, srcy);
+        td.out  = out;
+        td.srcx = srcx;
+        td.srcy = srcy;
+        ctx->internal->execute(ctx, s->lut2, &td, NULL,
+                               FFMIN(s->height[1], ff_filter_get_nb_threads(ctx)));
     }
 
     out->pts = av_rescale_q(s->fs.pts, s->fs.time_base, outlink->time_base);
@@ -375,5 +400,5 @@ AVFilter ff_vf_lut2 = {
     .query_formats = query_formats,
     .inputs        = inputs,
     .outputs       = outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -331,6 +331,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
         }
     }
 
+    emms_c();
+
     return ff_filter_frame(ctx->outputs[0], out);
 }
 
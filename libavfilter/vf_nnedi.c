@@ -31,6 +31,8 @@
 #include "internal.h"
 #include "video.h"
 
+#define INPUT_SIZE 512
+
 typedef struct FrameData {
     uint8_t *paddedp[3];
     int padded_stride[3];
@@ -43,8 +45,8 @@ typedef struct FrameData {
     int field[3];
 
     int32_t *lcount[3];
-    float *input;
-    float *temp;
+    float *input;               ///< INPUT_SIZE floats per thread
+    float *temp;                ///< temp_size bytes per thread
 } FrameData;
 
 typedef struct NNEDIContext {
@@ -59,6 +61,8 @@ typedef struct NNEDIContext {
     int64_t cur_pts;
 
     AVFloatDSPContext *fdsp;
+    int nb_threads;
+    size_t temp_size;
     int nb_planes;
     int linesize[4];
     int planeheight[4];
@@ -84,8 +88,8 @@ typedef struct NNEDIContext {
     int max_value;
 
     void (*copy_pad)(const AVFrame *, FrameData *, struct NNEDIContext *, int);
-    void (*evalfunc_0)(struct NNEDIContext *, FrameData *);
-    void (*evalfunc_1)(struct NNEDIContext *, FrameData *);
+    void (*evalfunc_0)(struct NNEDIContext *, FrameData *, int, int);
+    void (*evalfunc_1)(struct NNEDIContext *, FrameData *, int, int);
 
     // Functions used in evalfunc_0
     void (*readpixels)(const uint8_t *, const int, float *);
@@ -161,6 +165,17 @@ static int config_input(AVFilterLink *inlink)
     s->planeheight[1] = s->planeheight[2] = AV_CEIL_RSHIFT(inlink->h, desc->log2_chroma_h);
     s->planeheight[0] = s->planeheight[3] = inlink->h;
 
+    // evalfunc_0 requires at least padded_width[0] bytes.
+    // evalfunc_1 requires at least 512 floats.
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    s->temp_size  = FFALIGN(FFMAX(s->linesize[0] + 64, INPUT_SIZE * sizeof(float)), 64);
+    av_freep(&s->frame_data.input);
+    av_freep(&s->frame_data.temp);
+    s->frame_data.input = av_malloc_array(s->nb_threads, INPUT_SIZE * sizeof(float));
+    s->frame_data.temp  = av_malloc_array(s->nb_threads, s->temp_size);
+    if (!s->frame_data.input || !s->frame_data.temp)
+        return AVERROR(ENOMEM);
+
     return 0;
 }
 
@@ -415,11 +430,24 @@ static void compute_network0new(NNEDIContext *s, const float *datai, const float
     ((int *)d)[0] = mask;
 }
 
-static void evalfunc_0(NNEDIContext *s, FrameData *frame_data)
+/**
+ * Get the rows of a plane of height dst_height processed by a slice,
+ * cut on pairs of rows so that each slice has both fields.
+ */
+static void get_slice(int dst_height, int jobnr, int nb_jobs,
+                      int *slice_start, int *slice_end)
 {
-    float *input = frame_data->input;
+    const int pairs = (dst_height + 1) / 2;
+
+    *slice_start = 2 * (pairs *  jobnr      / nb_jobs);
+    *slice_end   = FFMIN(2 * (pairs * (jobnr + 1) / nb_jobs), dst_height);
+}
+
+static void evalfunc_0(NNEDIContext *s, FrameData *frame_data, int jobnr, int nb_jobs)
+{
+    float *input = frame_data->input + jobnr * INPUT_SIZE;
     const float *weights0 = s->weights0;
-    float *temp = frame_data->temp;
+    float *temp = (float *)((uint8_t *)frame_data->temp + jobnr * s->temp_size);
     uint8_t *tempu = (uint8_t *)temp;
     int plane, x, y;
 
@@ -434,21 +462,23 @@ static void evalfunc_0(NNEDIContext *s, FrameData *frame_data)
         uint8_t *dstp = (uint8_t *)frame_data->dstp[plane];
         const int dst_stride = frame_data->dst_stride[plane] / sizeof(uint8_t);
         const uint8_t *src3p;
-        int ystart, ystop;
+        int ystart, ystop, slice_start, slice_end;
         int32_t *lcount;
 
         if (!(s->process_plane & (1 << plane)))
             continue;
 
-        for (y = 1 - frame_data->field[plane]; y < height - 12; y += 2) {
+        get_slice(height - 12, jobnr, nb_jobs, &slice_start, &slice_end);
+
+        for (y = slice_start + 1 - frame_data->field[plane]; y < slice_end; y += 2) {
             memcpy(dstp + y * dst_stride,
                    srcp + 32 + (6 + y) * src_stride,
                    (width - 64) * sizeof(uint8_t));
 
         }
 
-        ystart = 6 + frame_data->field[plane];
-        ystop = height - 6;
+        ystart = 6 + frame_data->field[plane] + slice_start;
+        ystop = 6 + slice_end;
         srcp += ystart * src_stride;
         dstp += (ystart - 6) * dst_stride - 32;
         src3p = srcp - src_stride * 3;
@@ -575,10 +605,10 @@ static void weighted_avg_elliott_mul5_m16(const float *w, const int n, float *ms
 }
 
 
-static void evalfunc_1(NNEDIContext *s, FrameData *frame_data)
+static void evalfunc_1(NNEDIContext *s, FrameData *frame_data, int jobnr, int nb_jobs)
 {
-    float *input = frame_data->input;
-    float *temp = frame_data->temp;
+    float *input = frame_data->input + jobnr * INPUT_SIZE;
+    float *temp = (float *)((uint8_t *)frame_data->temp + jobnr * s->temp_size);
     float **weights1 = s->weights1;
     const int qual = s->qual;
     const int asize = s->asize;
@@ -599,13 +629,15 @@ static void evalfunc_1(NNEDIContext *s, FrameData *frame_data)
         uint8_t *dstp = (uint8_t *)frame_data->dstp[plane];
         const int dst_stride = frame_data->dst_stride[plane] / sizeof(uint8_t);
 
-        const int ystart = frame_data->field[plane];
-        const int ystop = height - 12;
+        int ystart, ystop;
         const uint8_t *srcpp;
 
         if (!(s->process_plane & (1 << plane)))
             continue;
 
+        get_slice(height - 12, jobnr, nb_jobs, &ystart, &ystop);
+        ystart += frame_data->field[plane];
+
         srcp += (ystart + 6) * src_stride;
         dstp += ystart * dst_stride - 32;
         srcpp = srcp - (ydia - 1) * src_stride - xdiad2m1;
@@ -686,6 +718,19 @@ static int modnpf(const int m, const int n)
     return m + n - (m % n);
 }
 
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    NNEDIContext *s = ctx->priv;
+
+    // Handles prescreening and the cubic interpolation.
+    s->evalfunc_0(s, &s->frame_data, jobnr, nb_jobs);
+
+    // The rest.
+    s->evalfunc_1(s, &s->frame_data, jobnr, nb_jobs);
+
+    return 0;
+}
+
 static int get_frame(AVFilterContext *ctx, int is_second)
 {
     NNEDIContext *s = ctx->priv;
@@ -693,7 +738,6 @@ static int get_frame(AVFilterContext *ctx, int is_second)
     AVFrame *src = s->src;
     FrameData *frame_data;
     int effective_field = s->field;
-    size_t temp_size;
     int field_n;
     int plane;
 
@@ -765,28 +809,11 @@ static int get_frame(AVFilterContext *ctx, int is_second)
         frame_data->field[plane] = field_n;
     }
 
-    if (!frame_data->input) {
-        frame_data->input = av_malloc(512 * sizeof(float));
-        if (!frame_data->input)
-            return AVERROR(ENOMEM);
-    }
-    // evalfunc_0 requires at least padded_width[0] bytes.
-    // evalfunc_1 requires at least 512 floats.
-    if (!frame_data->temp) {
-        temp_size = FFMAX(frame_data->padded_width[0], 512 * sizeof(float));
-        frame_data->temp = av_malloc(temp_size);
-        if (!frame_data->temp)
-            return AVERROR(ENOMEM);
-    }
-
     // Copy src to a padded "frame" in frame_data and mirror the edges.
     s->copy_pad(src, frame_data, s, field_n);
 
-    // Handles prescreening and the cubic interpolation.
-    s->evalfunc_0(s, frame_data);
-
-    // The rest.
-    s->evalfunc_1(s, frame_data);
+    ctx->internal->execute(ctx, filter_slice, NULL, NULL,
+                           FFMIN(s->planeheight[0], s->nb_threads));
 
     return 0;
 }
@@ -1207,5 +1234,5 @@ AVFilter ff_vf_nnedi = {
     .query_formats = query_formats,
     .inputs        = inputs,
     .outputs       = outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL | AVFILTER_FLAG_SLICE_THREADS,
 };
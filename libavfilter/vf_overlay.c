@@ -98,6 +98,12 @@ enum EvalMode {
     EVAL_MODE_NB
 };
 
+enum AlphaFormat {
+    ALPHA_FORMAT_STRAIGHT,
+    ALPHA_FORMAT_PREMULTIPLIED,
+    ALPHA_FORMAT_NB
+};
+
 enum OverlayFormat {
     OVERLAY_FORMAT_YUV420,
     OVERLAY_FORMAT_YUV422,
@@ -133,7 +139,18 @@ typedef struct OverlayContext {
 
     AVExpr *x_pexpr, *y_pexpr;
 
-    void (*blend_image)(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y);
+    int alpha_format;           ///< AlphaFormat of the overlay
+
+    /**
+     * Blend a row of one plane of the overlay on top of a main picture
+     * without alpha, indexed by plane. a is the row of the overlay alpha
+     * plane, at the luma resolution. When subsampled, the alpha of the
+     * pixel following the last one and the row of alpha below must be
+     * readable.
+     */
+    void (*blend_row[3])(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                         int w, ptrdiff_t alinesize);
+    int (*blend_slice)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
 } OverlayContext;
 
 static av_cold void uninit(AVFilterContext *ctx)
@@ -380,16 +397,22 @@ static int config_output(AVFilterLink *outlink)
 // ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)) is a faster version of: 255 * (x + y)
 #define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
 
+typedef struct ThreadData {
+    AVFrame *dst;
+    const AVFrame *src;
+} ThreadData;
+
 /**
  * Blend image in src to destination buffer dst at position (x, y).
  */
 
-static void blend_image_packed_rgb(AVFilterContext *ctx,
-                                   AVFrame *dst, const AVFrame *src,
-                                   int x, int y)
+static av_always_inline void blend_slice_packed_rgb(AVFilterContext *ctx,
+                                                    AVFrame *dst, const AVFrame *src,
+                                                    int x, int y, int straight,
+                                                    int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
-    int i, imax, j, jmax;
+    int i, imin, imax, j, jmax;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
@@ -406,13 +429,20 @@ static void blend_image_packed_rgb(AVFilterContext *ctx,
     const int sa = s->overlay_rgba_map[A];
     const int sstep = s->overlay_pix_step[0];
     const int main_has_alpha = s->main_has_alpha;
+    int slice_start, slice_end;
     uint8_t *S, *sp, *d, *dp;
 
-    i = FFMAX(-y, 0);
-    sp = src->data[0] + i     * src->linesize[0];
-    dp = dst->data[0] + (y+i) * dst->linesize[0];
+    imin = FFMAX(-y, 0);
+    imax = FFMIN(-y + dst_h, src_h);
+    if (imax <= imin)
+        return;
+    slice_start = imin + (imax - imin) *  jobnr      / nb_jobs;
+    slice_end   = imin + (imax - imin) * (jobnr + 1) / nb_jobs;
 
-    for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+    sp = src->data[0] + slice_start     * src->linesize[0];
+    dp = dst->data[0] + (y+slice_start) * dst->linesize[0];
+
+    for (i = slice_start; i < slice_end; i++) {
         j = FFMAX(-x, 0);
         S = sp + j     * sstep;
         d = dp + (x+j) * dstep;
@@ -438,9 +468,16 @@ static void blend_image_packed_rgb(AVFilterContext *ctx,
             default:
                 // main_value = main_value * (1 - alpha) + overlay_value * alpha
                 // since alpha is in the range 0-255, the result must divided by 255
-                d[dr] = FAST_DIV255(d[dr] * (255 - alpha) + S[sr] * alpha);
-                d[dg] = FAST_DIV255(d[dg] * (255 - alpha) + S[sg] * alpha);
-                d[db] = FAST_DIV255(d[db] * (255 - alpha) + S[sb] * alpha);
+                if (straight) {
+                    d[dr] = FAST_DIV255(d[dr] * (255 - alpha) + S[sr] * alpha);
+                    d[dg] = FAST_DIV255(d[dg] * (255 - alpha) + S[sg] * alpha);
+                    d[db] = FAST_DIV255(d[db] * (255 - alpha) + S[sb] * alpha);
+                } else {
+                    // the overlay values are already multiplied by alpha
+                    d[dr] = av_clip_uint8(FAST_DIV255(d[dr] * (255 - alpha)) + S[sr]);
+                    d[dg] = av_clip_uint8(FAST_DIV255(d[dg] * (255 - alpha)) + S[sg]);
+                    d[db] = av_clip_uint8(FAST_DIV255(d[db] * (255 - alpha)) + S[sb]);
+                }
             }
             if (main_has_alpha) {
                 switch (alpha) {
@@ -462,35 +499,55 @@ static void blend_image_packed_rgb(AVFilterContext *ctx,
     }
 }
 
+/**
+ * Blend the rows slice_start to slice_end - 1 of plane i of the overlay.
+ */
 static av_always_inline void blend_plane(AVFilterContext *ctx,
                                          AVFrame *dst, const AVFrame *src,
                                          int src_w, int src_h,
                                          int dst_w, int dst_h,
                                          int i, int hsub, int vsub,
                                          int x, int y,
-                                         int main_has_alpha)
+                                         int main_has_alpha, int straight,
+                                         int slice_start, int slice_end)
 {
+    OverlayContext *octx = ctx->priv;
     int src_wp = AV_CEIL_RSHIFT(src_w, hsub);
     int src_hp = AV_CEIL_RSHIFT(src_h, vsub);
     int dst_wp = AV_CEIL_RSHIFT(dst_w, hsub);
-    int dst_hp = AV_CEIL_RSHIFT(dst_h, vsub);
     int yp = y>>vsub;
     int xp = x>>hsub;
-    uint8_t *s, *sp, *d, *dp, *a, *ap;
-    int jmax, j, k, kmax;
-
-    j = FFMAX(-yp, 0);
-    sp = src->data[i] + j         * src->linesize[i];
-    dp = dst->data[i] + (yp+j)    * dst->linesize[i];
-    ap = src->data[3] + (j<<vsub) * src->linesize[3];
-
-    for (jmax = FFMIN(-yp + dst_hp, src_hp); j < jmax; j++) {
-        k = FFMAX(-xp, 0);
+    uint8_t *s, *sp, *d, *dp, *a, *ap, *da, *dap;
+    int j, k, kmin, kmax, krow;
+
+    kmin = FFMAX(-xp, 0);
+    kmax = FFMIN(-xp + dst_wp, src_wp);
+    sp  = src->data[i] + slice_start         * src->linesize[i];
+    dp  = dst->data[i] + (yp+slice_start)    * dst->linesize[i];
+    ap  = src->data[3] + (slice_start<<vsub) * src->linesize[3];
+    dap = main_has_alpha ? dst->data[3] + ((yp+slice_start)<<vsub) * dst->linesize[3] : NULL;
+
+    for (j = slice_start; j < slice_end; j++) {
+        k = kmin;
         d = dp + xp+k;
         s = sp + k;
         a = ap + (k<<hsub);
+        da = main_has_alpha ? dap + ((xp+k)<<hsub) : NULL;
+
+        // blend the pixels whose alpha is averaged over all their samples
+        // with the row function, the others are blended below
+        if (!main_has_alpha && (!vsub || j+1 < src_hp)) {
+            krow = hsub ? FFMIN(kmax, src_wp - 1) : kmax;
+            if (krow > k) {
+                octx->blend_row[i](d, s, a, krow - k, src->linesize[3]);
+                d += krow - k;
+                s += krow - k;
+                a += (krow - k) << hsub;
+                k = krow;
+            }
+        }
 
-        for (kmax = FFMIN(-xp + dst_wp, src_wp); k < kmax; k++) {
+        for (; k < kmax; k++) {
             int alpha_v, alpha_h, alpha;
 
             // average alpha for color components, improve quality
@@ -510,44 +567,53 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
             if (main_has_alpha && alpha != 0 && alpha != 255) {
                 // average alpha for color components, improve quality
                 uint8_t alpha_d;
-                if (hsub && vsub && j+1 < src_hp && k+1 < src_wp) {
-                    alpha_d = (d[0] + d[src->linesize[3]] +
-                               d[1] + d[src->linesize[3]+1]) >> 2;
+                int avg_h = hsub && k+1 < src_wp && ((xp+k)<<hsub) + 1 < dst_w;
+                int avg_v = vsub && j+1 < src_hp && ((yp+j)<<vsub) + 1 < dst_h;
+                if (avg_h && avg_v) {
+                    alpha_d = (da[0] + da[dst->linesize[3]] +
+                               da[1] + da[dst->linesize[3]+1]) >> 2;
                 } else if (hsub || vsub) {
-                    alpha_h = hsub && k+1 < src_wp ?
-                        (d[0] + d[1]) >> 1 : d[0];
-                    alpha_v = vsub && j+1 < src_hp ?
-                        (d[0] + d[src->linesize[3]]) >> 1 : d[0];
+                    alpha_h = avg_h ? (da[0] + da[1]) >> 1 : da[0];
+                    alpha_v = avg_v ? (da[0] + da[dst->linesize[3]]) >> 1 : da[0];
                     alpha_d = (alpha_v + alpha_h) >> 1;
                 } else
-                    alpha_d = d[0];
+                    alpha_d = da[0];
                 alpha = UNPREMULTIPLY_ALPHA(alpha, alpha_d);
             }
-            *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);
+            if (straight)
+                *d = FAST_DIV255(*d * (255 - alpha) + *s * alpha);
+            else if (i)
+                *d = av_clip_uint8(FAST_DIV255((*d - 128) * (255 - alpha)) + *s);
+            else
+                *d = av_clip_uint8(FAST_DIV255(*d * (255 - alpha)) + *s);
             s++;
             d++;
             a += 1 << hsub;
+            if (main_has_alpha)
+                da += 1 << hsub;
         }
         dp += dst->linesize[i];
         sp += src->linesize[i];
         ap += (1 << vsub) * src->linesize[3];
+        if (main_has_alpha)
+            dap += (1 << vsub) * dst->linesize[3];
     }
 }
 
 static inline void alpha_composite(const AVFrame *src, const AVFrame *dst,
                                    int src_w, int src_h,
                                    int dst_w, int dst_h,
-                                   int x, int y)
+                                   int x, int y,
+                                   int slice_start, int slice_end)
 {
     uint8_t alpha;          ///< the amount of overlay to blend on to main
     uint8_t *s, *sa, *d, *da;
-    int i, imax, j, jmax;
+    int i, j, jmax;
 
-    i = FFMAX(-y, 0);
-    sa = src->data[3] + i     * src->linesize[3];
-    da = dst->data[3] + (y+i) * dst->linesize[3];
+    sa = src->data[3] + slice_start     * src->linesize[3];
+    da = dst->data[3] + (y+slice_start) * dst->linesize[3];
 
-    for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+    for (i = slice_start; i < slice_end; i++) {
         j = FFMAX(-x, 0);
         s = sa + j;
         d = da + x+j;
@@ -576,44 +642,145 @@ static inline void alpha_composite(const AVFrame *src, const AVFrame *dst,
     }
 }
 
-static av_always_inline void blend_image_yuv(AVFilterContext *ctx,
+static av_always_inline void blend_slice_yuv(AVFilterContext *ctx,
                                              AVFrame *dst, const AVFrame *src,
                                              int hsub, int vsub,
-                                             int main_has_alpha,
-                                             int x, int y)
+                                             int main_has_alpha, int straight,
+                                             int x, int y,
+                                             int jobnr, int nb_jobs)
 {
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
     const int dst_h = dst->height;
-
+    const int yp = y >> vsub;
+    const int jmin = FFMAX(-yp, 0);
+    const int jmax = FFMIN(-yp + AV_CEIL_RSHIFT(dst_h, vsub), AV_CEIL_RSHIFT(src_h, vsub));
+    int slice_start, slice_end, luma_start, luma_end;
+
+    if (jmax <= jmin)
+        return;
+    // slice the chroma rows, so that a slice owns all the luma and alpha
+    // rows its chroma rows are computed from
+    slice_start = jmin + (jmax - jmin) *  jobnr      / nb_jobs;
+    slice_end   = jmin + (jmax - jmin) * (jobnr + 1) / nb_jobs;
+    luma_start  = slice_start << vsub;
+    luma_end    = FFMIN3(slice_end << vsub, -y + dst_h, src_h);
+
+    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha, straight, luma_start,  luma_end);
+    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha, straight, slice_start, slice_end);
+    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha, straight, slice_start, slice_end);
+
+    // the main alpha is only updated once all the planes of the slice
+    // have been blended with its previous value
     if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y);
+        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y, luma_start, luma_end);
+}
+
+static int blend_slice_yuv420(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
 
-    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha);
-    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha);
-    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha);
+    blend_slice_yuv(ctx, td->dst, td->src, 1, 1, s->main_has_alpha,
+                    s->alpha_format == ALPHA_FORMAT_STRAIGHT, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_yuv420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuv422(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
 
-    blend_image_yuv(ctx, dst, src, 1, 1, s->main_has_alpha, x, y);
+    blend_slice_yuv(ctx, td->dst, td->src, 1, 0, s->main_has_alpha,
+                    s->alpha_format == ALPHA_FORMAT_STRAIGHT, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_yuv422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_yuv444(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
 
-    blend_image_yuv(ctx, dst, src, 1, 0, s->main_has_alpha, x, y);
+    blend_slice_yuv(ctx, td->dst, td->src, 0, 0, s->main_has_alpha,
+                    s->alpha_format == ALPHA_FORMAT_STRAIGHT, s->x, s->y, jobnr, nb_jobs);
+    return 0;
 }
 
-static void blend_image_yuv444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static int blend_slice_packed_rgb_straight(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
 
-    blend_image_yuv(ctx, dst, src, 0, 0, s->main_has_alpha, x, y);
+    blend_slice_packed_rgb(ctx, td->dst, td->src, s->x, s->y, 1, jobnr, nb_jobs);
+    return 0;
+}
+
+static int blend_slice_packed_rgb_premultiplied(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+
+    blend_slice_packed_rgb(ctx, td->dst, td->src, s->x, s->y, 0, jobnr, nb_jobs);
+    return 0;
+}
+
+static av_always_inline void blend_row_c(uint8_t *d, const uint8_t *s,
+                                         const uint8_t *a, int w,
+                                         ptrdiff_t alinesize,
+                                         int hsub, int vsub,
+                                         int straight, int chroma)
+{
+    int k, alpha;
+
+    for (k = 0; k < w; k++) {
+        if (hsub && vsub)
+            alpha = (a[0] + a[alinesize] + a[1] + a[alinesize + 1]) >> 2;
+        else if (hsub)
+            alpha = (a[0] + ((a[0] + a[1]) >> 1)) >> 1;
+        else
+            alpha = a[0];
+        if (straight)
+            d[k] = FAST_DIV255(d[k] * (255 - alpha) + s[k] * alpha);
+        else if (chroma)
+            d[k] = av_clip_uint8(FAST_DIV255((d[k] - 128) * (255 - alpha)) + s[k]);
+        else
+            d[k] = av_clip_uint8(FAST_DIV255(d[k] * (255 - alpha)) + s[k]);
+        a += 1 << hsub;
+    }
+}
+
+#define DEFINE_BLEND_ROW(name, hsub, vsub, straight, chroma)                   \
+static void blend_row_##name##_c(uint8_t *d, const uint8_t *s,                 \
+                                 const uint8_t *a, int w, ptrdiff_t alinesize) \
+{                                                                              \
+    blend_row_c(d, s, a, w, alinesize, hsub, vsub, straight, chroma);          \
+}
+
+DEFINE_BLEND_ROW(straight_44,  0, 0, 1, 0)
+DEFINE_BLEND_ROW(straight_22,  1, 0, 1, 0)
+DEFINE_BLEND_ROW(straight_20,  1, 1, 1, 0)
+DEFINE_BLEND_ROW(premul_44,    0, 0, 0, 0)
+DEFINE_BLEND_ROW(premulc_44,   0, 0, 0, 1)
+DEFINE_BLEND_ROW(premulc_22,   1, 0, 0, 1)
+DEFINE_BLEND_ROW(premulc_20,   1, 1, 0, 1)
+
+static av_cold void init_blend_row(OverlayContext *s)
+{
+    const int hsub = s->hsub, vsub = s->vsub;
+
+    if (s->alpha_format == ALPHA_FORMAT_STRAIGHT) {
+        s->blend_row[0] = blend_row_straight_44_c;
+        s->blend_row[1] = hsub && vsub ? blend_row_straight_20_c :
+                          hsub         ? blend_row_straight_22_c :
+                                         blend_row_straight_44_c;
+    } else {
+        s->blend_row[0] = blend_row_premul_44_c;
+        s->blend_row[1] = hsub && vsub ? blend_row_premulc_20_c :
+                          hsub         ? blend_row_premulc_22_c :
+                                         blend_row_premulc_44_c;
+    }
+    s->blend_row[2] = s->blend_row[1];
 }
 
 static int config_input_main(AVFilterLink *inlink)
@@ -631,18 +798,22 @@ static int config_input_main(AVFilterLink *inlink)
     s->main_has_alpha = ff_fmt_is_in(inlink->format, alpha_pix_fmts);
     switch (s->format) {
     case OVERLAY_FORMAT_YUV420:
-        s->blend_image = blend_image_yuv420;
+        s->blend_slice = blend_slice_yuv420;
         break;
     case OVERLAY_FORMAT_YUV422:
-        s->blend_image = blend_image_yuv422;
+        s->blend_slice = blend_slice_yuv422;
         break;
     case OVERLAY_FORMAT_YUV444:
-        s->blend_image = blend_image_yuv444;
+        s->blend_slice = blend_slice_yuv444;
         break;
     case OVERLAY_FORMAT_RGB:
-        s->blend_image = blend_image_packed_rgb;
+        s->blend_slice = s->alpha_format == ALPHA_FORMAT_STRAIGHT ?
+                         blend_slice_packed_rgb_straight :
+                         blend_slice_packed_rgb_premultiplied;
         break;
     }
+    if (s->format != OVERLAY_FORMAT_RGB)
+        init_blend_row(s);
     return 0;
 }
 
@@ -655,7 +826,7 @@ static AVFrame *do_blend(AVFilterContext *ctx, AVFrame *mainpic,
     if (s->eval_mode == EVAL_MODE_FRAME) {
         int64_t pos = av_frame_get_pkt_pos(mainpic);
 
-        s->var_values[VAR_N] = inlink->frame_count;
+        s->var_values[VAR_N] = inlink->frame_count_out;
         s->var_values[VAR_T] = mainpic->pts == AV_NOPTS_VALUE ?
             NAN : mainpic->pts * av_q2d(inlink->time_base);
         s->var_values[VAR_POS] = pos == -1 ? NAN : pos;
@@ -673,8 +844,13 @@ static AVFrame *do_blend(AVFilterContext *ctx, AVFrame *mainpic,
     }
 
     if (s->x < mainpic->width  && s->x + second->width  >= 0 ||
-        s->y < mainpic->height && s->y + second->height >= 0)
-        s->blend_image(ctx, mainpic, second, s->x, s->y);
+        s->y < mainpic->height && s->y + second->height >= 0) {
+        ThreadData td = { .dst = mainpic, .src = second };
+
+        ctx->internal->execute(ctx, s->blend_slice, &td, NULL,
+                               FFMIN(AV_CEIL_RSHIFT(second->height, s->vsub),
+                                     ff_filter_get_nb_threads(ctx)));
+    }
     return mainpic;
 }
 
@@ -691,6 +867,12 @@ static int request_frame(AVFilterLink *outlink)
     return ff_dualinput_request_frame(&s->dinput, outlink);
 }
 
+static int activate(AVFilterContext *ctx)
+{
+    OverlayContext *s = ctx->priv;
+    return ff_dualinput_activate(&s->dinput);
+}
+
 static av_cold int init(AVFilterContext *ctx)
 {
     OverlayContext *s = ctx->priv;
@@ -736,6 +918,9 @@ static const AVOption overlay_options[] = {
         { "yuv444", "", 0, AV_OPT_TYPE_CONST, {.i64=OVERLAY_FORMAT_YUV444}, .flags = FLAGS, .unit = "format" },
         { "rgb",    "", 0, AV_OPT_TYPE_CONST, {.i64=OVERLAY_FORMAT_RGB},    .flags = FLAGS, .unit = "format" },
     { "repeatlast", "repeat overlay of the last overlay frame", OFFSET(dinput.repeatlast), AV_OPT_TYPE_BOOL, {.i64=1}, 0, 1, FLAGS },
+    { "alpha", "alpha format of the overlay", OFFSET(alpha_format), AV_OPT_TYPE_INT, {.i64=ALPHA_FORMAT_STRAIGHT}, 0, ALPHA_FORMAT_NB-1, FLAGS, "alpha_format" },
+        { "straight",      "", 0, AV_OPT_TYPE_CONST, {.i64=ALPHA_FORMAT_STRAIGHT},      .flags = FLAGS, .unit = "alpha_format" },
+        { "premultiplied", "", 0, AV_OPT_TYPE_CONST, {.i64=ALPHA_FORMAT_PREMULTIPLIED}, .flags = FLAGS, .unit = "alpha_format" },
     { NULL }
 };
 
@@ -776,8 +961,10 @@ AVFilter ff_vf_overlay = {
     .priv_size     = sizeof(OverlayContext),
     .priv_class    = &overlay_class,
     .query_formats = query_formats,
+    .activate      = activate,
     .process_command = process_command,
     .inputs        = avfilter_vf_overlay_inputs,
     .outputs       = avfilter_vf_overlay_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -29,6 +29,7 @@
 #include "libavutil/qsort.h"
 #include "dualinput.h"
 #include "avfilter.h"
+#include "internal.h"
 
 enum dithering_mode {
     DITHERING_NONE,
@@ -73,15 +74,30 @@ struct cache_node {
     int nb_entries;
 };
 
+struct color_cache {
+    struct cache_node nodes[CACHE_SIZE];
+    uint64_t nb_lookups;
+    uint64_t nb_misses;
+};
+
 struct PaletteUseContext;
 
-typedef int (*set_frame_func)(struct PaletteUseContext *s, AVFrame *out, AVFrame *in,
+typedef int (*set_frame_func)(struct PaletteUseContext *s, struct color_cache *cache,
+                              AVFrame *out, AVFrame *in,
                               int x_start, int y_start, int width, int height);
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int x_start, y_start;
+    int width, height;
+} ThreadData;
+
 typedef struct PaletteUseContext {
     const AVClass *class;
     FFDualInputContext dinput;
-    struct cache_node cache[CACHE_SIZE];    /* lookup cache */
+    struct color_cache *caches;             /* lookup caches, one per thread */
+    int *jobs_ret;
+    int nb_threads;
     struct color_node map[AVPALETTE_COUNT]; /* 3D-Tree (KD-Tree with K=3) for reverse colormap */
     uint32_t palette[AVPALETTE_COUNT];
     int palette_loaded;
@@ -100,6 +116,7 @@ typedef struct PaletteUseContext {
     int calc_mean_err;
     uint64_t total_mean_err;
     int debug_accuracy;
+    int debug_cache;
 } PaletteUseContext;
 
 #define OFFSET(x) offsetof(PaletteUseContext, x)
@@ -123,6 +140,7 @@ static const AVOption paletteuse_options[] = {
         { "bruteforce",    "brute-force into the palette", 0, AV_OPT_TYPE_CONST, {.i64=COLOR_SEARCH_BRUTEFORCE},    INT_MIN, INT_MAX, FLAGS, "search" },
     { "mean_err", "compute and print mean error", OFFSET(calc_mean_err), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
     { "debug_accuracy", "test color search accuracy", OFFSET(debug_accuracy), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
+    { "debug_cache", "print color lookup cache statistics", OFFSET(debug_cache), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
     { "new", "take new palette for each output frame", OFFSET(new), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
     { NULL }
 };
@@ -321,7 +339,7 @@ end:
  * Note: r, g, and b are the component of c but are passed as well to avoid
  * recomputing them (they are generally computed by the caller for other uses).
  */
-static av_always_inline int color_get(struct cache_node *cache, uint32_t color,
+static av_always_inline int color_get(struct color_cache *cache, uint32_t color,
                                       uint8_t r, uint8_t g, uint8_t b,
                                       const struct color_node *map,
                                       const uint32_t *palette,
@@ -333,7 +351,7 @@ static av_always_inline int color_get(struct cache_node *cache, uint32_t color,
     const uint8_t ghash = g & ((1<<NBITS)-1);
     const uint8_t bhash = b & ((1<<NBITS)-1);
     const unsigned hash = rhash<<(NBITS*2) | ghash<<NBITS | bhash;
-    struct cache_node *node = &cache[hash];
+    struct cache_node *node = &cache->nodes[hash];
     struct cached_color *e;
 
     for (i = 0; i < node->nb_entries; i++) {
@@ -342,6 +360,7 @@ static av_always_inline int color_get(struct cache_node *cache, uint32_t color,
             return e->pal_entry;
     }
 
+    cache->nb_misses++;
     e = av_dynarray2_add((void**)&node->entries, &node->nb_entries,
                          sizeof(*node->entries), NULL);
     if (!e)
@@ -351,7 +370,7 @@ static av_always_inline int color_get(struct cache_node *cache, uint32_t color,
     return e->pal_entry;
 }
 
-static av_always_inline int get_dst_color_err(struct cache_node *cache,
+static av_always_inline int get_dst_color_err(struct color_cache *cache,
                                               uint32_t c, const struct color_node *map,
                                               const uint32_t *palette,
                                               int *er, int *eg, int *eb,
@@ -368,14 +387,14 @@ static av_always_inline int get_dst_color_err(struct cache_node *cache,
     return dstx;
 }
 
-static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFrame *in,
+static av_always_inline int set_frame(PaletteUseContext *s, struct color_cache *cache,
+                                      AVFrame *out, AVFrame *in,
                                       int x_start, int y_start, int w, int h,
                                       enum dithering_mode dither,
                                       const enum color_search_method search_method)
 {
     int x, y;
     const struct color_node *map = s->map;
-    struct cache_node *cache = s->cache;
     const uint32_t *palette = s->palette;
     const int src_linesize = in ->linesize[0] >> 2;
     const int dst_linesize = out->linesize[0];
@@ -853,11 +872,25 @@ static void set_processing_window(enum diff_mode diff_mode,
     *hp = height;
 }
 
+static int set_frame_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PaletteUseContext *s = ctx->priv;
+    ThreadData *td = arg;
+    struct color_cache *cache = &s->caches[jobnr];
+    const int slice_start = td->y_start + (td->height *  jobnr     ) / nb_jobs;
+    const int slice_end   = td->y_start + (td->height * (jobnr + 1)) / nb_jobs;
+
+    cache->nb_lookups += (uint64_t)td->width * (slice_end - slice_start);
+    return s->set_frame(s, cache, td->out, td->in, td->x_start, slice_start,
+                        td->width, slice_end - slice_start);
+}
+
 static AVFrame *apply_palette(AVFilterLink *inlink, AVFrame *in)
 {
-    int x, y, w, h;
+    int i, x, y, w, h, nb_jobs;
     AVFilterContext *ctx = inlink->dst;
     PaletteUseContext *s = ctx->priv;
+    ThreadData td;
     AVFilterLink *outlink = inlink->dst->outputs[0];
 
     AVFrame *out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
@@ -883,17 +916,44 @@ static AVFrame *apply_palette(AVFilterLink *inlink, AVFrame *in)
     ff_dlog(ctx, "%dx%d rect: (%d;%d) -> (%d,%d) [area:%dx%d]\n",
             w, h, x, y, x+w, y+h, in->width, in->height);
 
-    if (s->set_frame(s, out, in, x, y, w, h) < 0) {
-        av_frame_free(&out);
-        return NULL;
+    /* error diffusion propagates through the whole window, the other
+     * ditherings work on each pixel independently */
+    nb_jobs = s->dither == DITHERING_NONE || s->dither == DITHERING_BAYER ?
+              FFMIN(h, s->nb_threads) : 1;
+    td.in      = in;
+    td.out     = out;
+    td.x_start = x;
+    td.y_start = y;
+    td.width   = w;
+    td.height  = h;
+    ctx->internal->execute(ctx, set_frame_slice, &td, s->jobs_ret, nb_jobs);
+    for (i = 0; i < nb_jobs; i++) {
+        if (s->jobs_ret[i] < 0) {
+            av_frame_free(&out);
+            return NULL;
+        }
     }
     memcpy(out->data[1], s->palette, AVPALETTE_SIZE);
     if (s->calc_mean_err)
-        debug_mean_error(s, in, out, inlink->frame_count);
+        debug_mean_error(s, in, out, inlink->frame_count_out);
     av_frame_free(&in);
     return out;
 }
 
+static void reset_caches(PaletteUseContext *s)
+{
+    int i, j;
+
+    for (j = 0; j < s->nb_threads; j++) {
+        struct color_cache *cache = &s->caches[j];
+
+        for (i = 0; i < CACHE_SIZE; i++) {
+            av_freep(&cache->nodes[i].entries);
+            cache->nodes[i].nb_entries = 0;
+        }
+    }
+}
+
 static int config_output(AVFilterLink *outlink)
 {
     int ret;
@@ -906,6 +966,17 @@ static int config_output(AVFilterLink *outlink)
     outlink->time_base = ctx->inputs[0]->time_base;
     if ((ret = ff_dualinput_init(ctx, &s->dinput)) < 0)
         return ret;
+
+    if (s->caches)
+        reset_caches(s);
+    av_freep(&s->caches);
+    av_freep(&s->jobs_ret);
+
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    s->caches   = av_calloc(s->nb_threads, sizeof(*s->caches));
+    s->jobs_ret = av_calloc(s->nb_threads, sizeof(*s->jobs_ret));
+    if (!s->caches || !s->jobs_ret)
+        return AVERROR(ENOMEM);
     return 0;
 }
 
@@ -933,9 +1004,7 @@ static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
     if (s->new) {
         memset(s->palette, 0, sizeof(s->palette));
         memset(s->map, 0, sizeof(s->map));
-        for (i = 0; i < CACHE_SIZE; i++)
-            av_freep(&s->cache[i].entries);
-        memset(s->cache, 0, sizeof(s->cache));
+        reset_caches(s);
     }
 
     i = 0;
@@ -969,10 +1038,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 }
 
 #define DEFINE_SET_FRAME(color_search, name, value)                             \
-static int set_frame_##name(PaletteUseContext *s, AVFrame *out, AVFrame *in,    \
+static int set_frame_##name(PaletteUseContext *s, struct color_cache *cache,    \
+                            AVFrame *out, AVFrame *in,                          \
                             int x_start, int y_start, int w, int h)             \
 {                                                                               \
-    return set_frame(s, out, in, x_start, y_start, w, h, value, color_search);  \
+    return set_frame(s, cache, out, in, x_start, y_start, w, h, value,          \
+                     color_search);                                             \
 }
 
 #define DEFINE_SET_FRAME_COLOR_SEARCH(color_search, color_search_macro)                                 \
@@ -1042,8 +1113,22 @@ static av_cold void uninit(AVFilterContext *ctx)
     PaletteUseContext *s = ctx->priv;
 
     ff_dualinput_uninit(&s->dinput);
-    for (i = 0; i < CACHE_SIZE; i++)
-        av_freep(&s->cache[i].entries);
+    if (s->caches) {
+        if (s->debug_cache) {
+            uint64_t nb_lookups = 0, nb_misses = 0;
+
+            for (i = 0; i < s->nb_threads; i++) {
+                nb_lookups += s->caches[i].nb_lookups;
+                nb_misses  += s->caches[i].nb_misses;
+            }
+            av_log(ctx, AV_LOG_INFO, "Color cache: %"PRIu64" lookups, %"PRIu64" misses, "
+                   "hit rate %.2f%%\n", nb_lookups, nb_misses,
+                   nb_lookups ? 100. * (nb_lookups - nb_misses) / nb_lookups : 0.);
+        }
+        reset_caches(s);
+    }
+    av_freep(&s->caches);
+    av_freep(&s->jobs_ret);
     av_frame_free(&s->last_in);
     av_frame_free(&s->last_out);
 }
@@ -1083,4 +1168,5 @@ AVFilter ff_vf_paletteuse = {
     .inputs        = paletteuse_inputs,
     .outputs       = paletteuse_outputs,
     .priv_class    = &paletteuse_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -58,7 +58,9 @@ typedef struct SSIMContext {
     uint8_t rgba_map[4];
     int planewidth[4];
     int planeheight[4];
-    int *temp;
+    int **temp;
+    float *score[4];
+    int nb_threads;
     int is_rgb;
     SSIMDSPContext dsp;
 } SSIMContext;
@@ -147,31 +149,58 @@ static float ssim_endn(const int (*sum0)[4], const int (*sum1)[4], int width)
     return ssim;
 }
 
-static float ssim_plane(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp)
+typedef struct ThreadData {
+    const uint8_t *main_data[4];
+    const uint8_t *ref_data[4];
+    int main_linesize[4];
+    int ref_linesize[4];
+    int planewidth[4];
+    int planeheight[4];
+    float **score;
+    int **temp;
+    int nb_components;
+    SSIMDSPContext *dsp;
+} ThreadData;
+
+/*
+ * Every job stores the score of each of its rows of 4x4 blocks; the rows
+ * are summed afterwards in the same order as a single-threaded pass, so
+ * the result does not depend on the number of jobs.
+ */
+static int ssim_plane(AVFilterContext *ctx, void *arg,
+                      int jobnr, int nb_jobs)
 {
-    int z = 0, y;
-    float ssim = 0.0;
-    int (*sum0)[4] = temp;
-    int (*sum1)[4] = sum0 + (width >> 2) + 3;
-
-    width >>= 2;
-    height >>= 2;
-
-    for (y = 1; y < height; y++) {
-        for (; z <= y; z++) {
-            FFSWAP(void*, sum0, sum1);
-            dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
-                               &ref[4 * z * ref_stride], ref_stride,
-                               sum0, width);
-        }
+    ThreadData *td = arg;
+    int c;
+
+    for (c = 0; c < td->nb_components; c++) {
+        const uint8_t *main = td->main_data[c];
+        const uint8_t *ref = td->ref_data[c];
+        const int main_stride = td->main_linesize[c];
+        const int ref_stride = td->ref_linesize[c];
+        const int width = td->planewidth[c] >> 2;
+        const int height = td->planeheight[c] >> 2;
+        const int slice_start = 1 + ((height - 1) * jobnr) / nb_jobs;
+        const int slice_end = 1 + ((height - 1) * (jobnr+1)) / nb_jobs;
+        int (*sum0)[4] = (int (*)[4])td->temp[jobnr];
+        int (*sum1)[4] = sum0 + width + 3;
+        int z = slice_start - 1, y;
+
+        for (y = slice_start; y < slice_end; y++) {
+            for (; z <= y; z++) {
+                FFSWAP(void*, sum0, sum1);
+                td->dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
+                                       &ref[4 * z * ref_stride], ref_stride,
+                                       sum0, width);
+            }
 
-        ssim += dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+            td->score[c][y] = td->dsp->ssim_end_line((const int (*)[4])sum0,
+                                                     (const int (*)[4])sum1,
+                                                     width - 1);
+        }
     }
 
-    return ssim / ((height - 1) * (width - 1));
+    return 0;
 }
 
 static double ssim_db(double ssim, double weight)
@@ -185,14 +214,35 @@ static AVFrame *do_ssim(AVFilterContext *ctx, AVFrame *main,
     AVDictionary **metadata = avpriv_frame_get_metadatap(main);
     SSIMContext *s = ctx->priv;
     float c[4], ssimv = 0.0;
-    int i;
+    ThreadData td;
+    int i, y;
 
     s->nb_frames++;
 
+    td.nb_components = s->nb_components;
+    td.dsp = &s->dsp;
+    td.score = s->score;
+    td.temp = s->temp;
     for (i = 0; i < s->nb_components; i++) {
-        c[i] = ssim_plane(&s->dsp, main->data[i], main->linesize[i],
-                          ref->data[i], ref->linesize[i],
-                          s->planewidth[i], s->planeheight[i], s->temp);
+        td.main_data[i] = main->data[i];
+        td.ref_data[i] = ref->data[i];
+        td.main_linesize[i] = main->linesize[i];
+        td.ref_linesize[i] = ref->linesize[i];
+        td.planewidth[i] = s->planewidth[i];
+        td.planeheight[i] = s->planeheight[i];
+    }
+
+    ctx->internal->execute(ctx, ssim_plane, &td, NULL,
+                           FFMIN((s->planeheight[1] + 3) >> 2, s->nb_threads));
+
+    for (i = 0; i < s->nb_components; i++) {
+        const int width = s->planewidth[i] >> 2;
+        const int height = s->planeheight[i] >> 2;
+        float ssim = 0.0;
+
+        for (y = 1; y < height; y++)
+            ssim += s->score[i][y];
+        c[i] = ssim / ((height - 1) * (width - 1));
         ssimv += s->coefs[i] * c[i];
         s->ssim[i] += c[i];
     }
@@ -297,10 +347,23 @@ static int config_input_ref(AVFilterLink *inlink)
     for (i = 0; i < s->nb_components; i++)
         s->coefs[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
 
-    s->temp = av_malloc((2 * inlink->w + 12) * sizeof(*s->temp));
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    s->temp = av_calloc(s->nb_threads, sizeof(*s->temp));
     if (!s->temp)
         return AVERROR(ENOMEM);
 
+    for (i = 0; i < s->nb_threads; i++) {
+        s->temp[i] = av_malloc((2 * inlink->w + 12) * sizeof(**s->temp));
+        if (!s->temp[i])
+            return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < s->nb_components; i++) {
+        s->score[i] = av_calloc(FFMAX(s->planeheight[i] >> 2, 1), sizeof(*s->score[i]));
+        if (!s->score[i])
+            return AVERROR(ENOMEM);
+    }
+
     s->dsp.ssim_4x4_line = ssim_4x4xn;
     s->dsp.ssim_end_line = ssim_endn;
     if (ARCH_X86)
@@ -343,10 +406,10 @@ static int request_frame(AVFilterLink *outlink)
 static av_cold void uninit(AVFilterContext *ctx)
 {
     SSIMContext *s = ctx->priv;
+    int i;
 
     if (s->nb_frames > 0) {
         char buf[256];
-        int i;
         buf[0] = 0;
         for (i = 0; i < s->nb_components; i++) {
             int c = s->is_rgb ? s->rgba_map[i] : i;
@@ -362,6 +425,10 @@ static av_cold void uninit(AVFilterContext *ctx)
     if (s->stats_file && s->stats_file != stdout)
         fclose(s->stats_file);
 
+    for (i = 0; i < 4; i++)
+        av_freep(&s->score[i]);
+    for (i = 0; s->temp && i < s->nb_threads; i++)
+        av_freep(&s->temp[i]);
     av_freep(&s->temp);
 }
 
@@ -399,4 +466,5 @@ AVFilter ff_vf_ssim = {
     .priv_class    = &ssim_class,
     .inputs        = ssim_inputs,
     .outputs       = ssim_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -48,16 +48,61 @@
 #include "unsharp.h"
 #include "unsharp_opencl.h"
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
+/* one step of the horizontal sums: buf[x] += buf[x + 1] */
+static void hsum(uint32_t *buf, int len)
+{
+    int x;
+
+    for (x = 0; x < len; x++)
+        buf[x] += buf[x + 1];
+}
+
+/* run a row of horizontal sums through nb_stages vertical stages, the state
+   of stage z being stored at sc + z * sc_stride */
+static void vsum(uint32_t *buf, uint32_t *sc, ptrdiff_t sc_stride, int nb_stages, int width)
+{
+    int x, z;
+
+    for (x = 0; x < width; x++) {
+        uint32_t sum = buf[x];
+
+        for (z = 0; z < nb_stages; z++) {
+            uint32_t tmp = sc[x + z * sc_stride];
+            sc[x + z * sc_stride] = sum;
+            sum += tmp;
+        }
+        buf[x] = sum;
+    }
+}
+
+/* combine a source row with its blurred sums */
+static void sharpen(uint8_t *dst, const uint8_t *src, const uint32_t *buf,
+                    int width, int amount, int scalebits, uint32_t halfscale)
+{
+    int x;
+
+    for (x = 0; x < width; x++) {
+        int32_t res = (int32_t)src[x] + ((((int32_t)src[x] - (int32_t)((buf[x] + halfscale) >> scalebits)) * amount) >> 16);
+        dst[x] = av_clip_uint8(res);
+    }
+}
+
+/**
+ * Filter the rows [slice_start, slice_end) of a plane. The horizontal and
+ * vertical sums are binomial filters of 2 * steps + 1 taps, so each slice
+ * starts from steps_y rows above it and runs steps_y rows past its end, with
+ * the rows outside the plane replicated from the edges.
+ */
 static void apply_unsharp(      uint8_t *dst, int dst_stride,
                           const uint8_t *src, int src_stride,
-                          int width, int height, UnsharpFilterParam *fp)
+                          int width, int height, int slice_start, int slice_end,
+                          UnsharpFilterParam *fp, uint32_t *sr, uint32_t *sc)
 {
-    uint32_t **sc = fp->sc;
-    uint32_t sr[MAX_MATRIX_SIZE - 1], tmp1, tmp2;
-
-    int32_t res;
     int x, y, z;
-    const uint8_t *src2 = NULL;  //silence a warning
     const int amount = fp->amount;
     const int steps_x = fp->steps_x;
     const int steps_y = fp->steps_y;
@@ -65,47 +110,40 @@ static void apply_unsharp(      uint8_t *dst, int dst_stride,
     const int32_t halfscale = fp->halfscale;
 
     if (!amount) {
-        av_image_copy_plane(dst, dst_stride, src, src_stride, width, height);
+        av_image_copy_plane(dst + slice_start * dst_stride, dst_stride,
+                            src + slice_start * src_stride, src_stride,
+                            width, slice_end - slice_start);
         return;
     }
 
-    for (y = 0; y < 2 * steps_y; y++)
-        memset(sc[y], 0, sizeof(sc[y][0]) * (width + 2 * steps_x));
-
-    for (y = -steps_y; y < height + steps_y; y++) {
-        if (y < height)
-            src2 = src;
-
-        memset(sr, 0, sizeof(sr[0]) * (2 * steps_x - 1));
-        for (x = -steps_x; x < width + steps_x; x++) {
-            tmp1 = x <= 0 ? src2[0] : x >= width ? src2[width-1] : src2[x];
-            for (z = 0; z < steps_x * 2; z += 2) {
-                tmp2 = sr[z + 0] + tmp1; sr[z + 0] = tmp1;
-                tmp1 = sr[z + 1] + tmp2; sr[z + 1] = tmp2;
-            }
-            for (z = 0; z < steps_y * 2; z += 2) {
-                tmp2 = sc[z + 0][x + steps_x] + tmp1; sc[z + 0][x + steps_x] = tmp1;
-                tmp1 = sc[z + 1][x + steps_x] + tmp2; sc[z + 1][x + steps_x] = tmp2;
-            }
-            if (x >= steps_x && y >= steps_y) {
-                const uint8_t *srx = src - steps_y * src_stride + x - steps_x;
-                uint8_t *dsx       = dst - steps_y * dst_stride + x - steps_x;
-
-                res = (int32_t)*srx + ((((int32_t) * srx - (int32_t)((tmp1 + halfscale) >> scalebits)) * amount) >> 16);
-                *dsx = av_clip_uint8(res);
-            }
-        }
-        if (y >= 0) {
-            dst += dst_stride;
-            src += src_stride;
+    memset(sc, 0, sizeof(*sc) * fp->sc_stride * 2 * steps_y);
+
+    for (y = slice_start - steps_y; y < slice_end + steps_y; y++) {
+        const uint8_t *src2 = src + av_clip(y, 0, height - 1) * src_stride;
+
+        for (x = 0; x < steps_x; x++) {
+            sr[x]                     = src2[0];
+            sr[x + steps_x + width]   = src2[width - 1];
         }
+        for (x = 0; x < width; x++)
+            sr[x + steps_x] = src2[x];
+
+        for (z = 0; z < 2 * steps_x; z++)
+            hsum(sr, width + 2 * steps_x - 1 - z);
+        vsum(sr, sc, fp->sc_stride, 2 * steps_y, width);
+
+        if (y >= slice_start + steps_y)
+            sharpen(dst + (y - steps_y) * dst_stride, src + (y - steps_y) * src_stride,
+                    sr, width, amount, scalebits, halfscale);
     }
 }
 
-static int apply_unsharp_c(AVFilterContext *ctx, AVFrame *in, AVFrame *out)
+static int unsharp_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     AVFilterLink *inlink = ctx->inputs[0];
     UnsharpContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in = td->in, *out = td->out;
     int i, plane_w[3], plane_h[3];
     UnsharpFilterParam *fp[3];
     plane_w[0] = inlink->w;
@@ -115,11 +153,32 @@ static int apply_unsharp_c(AVFilterContext *ctx, AVFrame *in, AVFrame *out)
     fp[0] = &s->luma;
     fp[1] = fp[2] = &s->chroma;
     for (i = 0; i < 3; i++) {
-        apply_unsharp(out->data[i], out->linesize[i], in->data[i], in->linesize[i], plane_w[i], plane_h[i], fp[i]);
+        const int slice_start = (plane_h[i] *  jobnr     ) / nb_jobs;
+        const int slice_end   = (plane_h[i] * (jobnr + 1)) / nb_jobs;
+
+        if (slice_start >= slice_end)
+            continue;
+
+        apply_unsharp(out->data[i], out->linesize[i], in->data[i], in->linesize[i],
+                      plane_w[i], plane_h[i], slice_start, slice_end, fp[i],
+                      fp[i]->sr + jobnr * fp[i]->sr_stride,
+                      fp[i]->sc + jobnr * fp[i]->sc_stride * 2 * fp[i]->steps_y);
     }
     return 0;
 }
 
+static int apply_unsharp_c(AVFilterContext *ctx, AVFrame *in, AVFrame *out)
+{
+    UnsharpContext *s = ctx->priv;
+    ThreadData td;
+
+    td.in  = in;
+    td.out = out;
+    ctx->internal->execute(ctx, unsharp_slice, &td, NULL,
+                           FFMIN(ctx->inputs[0]->h, s->nb_threads));
+    return 0;
+}
+
 static void set_filter_param(UnsharpFilterParam *fp, int msize_x, int msize_y, float amount)
 {
     fp->msize_x = msize_x;
@@ -175,7 +234,7 @@ static int query_formats(AVFilterContext *ctx)
 
 static int init_filter_param(AVFilterContext *ctx, UnsharpFilterParam *fp, const char *effect_type, int width)
 {
-    int z;
+    UnsharpContext *s = ctx->priv;
     const char *effect = fp->amount == 0 ? "none" : fp->amount < 0 ? "blur" : "sharpen";
 
     if  (!(fp->msize_x & fp->msize_y & 1)) {
@@ -188,10 +247,12 @@ static int init_filter_param(AVFilterContext *ctx, UnsharpFilterParam *fp, const
     av_log(ctx, AV_LOG_VERBOSE, "effect:%s type:%s msize_x:%d msize_y:%d amount:%0.2f\n",
            effect, effect_type, fp->msize_x, fp->msize_y, fp->amount / 65535.0);
 
-    for (z = 0; z < 2 * fp->steps_y; z++)
-        if (!(fp->sc[z] = av_malloc_array(width + 2 * fp->steps_x,
-                                          sizeof(*(fp->sc[z])))))
-            return AVERROR(ENOMEM);
+    fp->sr_stride = width + 2 * fp->steps_x;
+    fp->sc_stride = width;
+
+    if (!(fp->sr = av_malloc_array(s->nb_threads, fp->sr_stride * sizeof(*fp->sr))) ||
+        !(fp->sc = av_malloc_array(s->nb_threads, fp->sc_stride * 2 * fp->steps_y * sizeof(*fp->sc))))
+        return AVERROR(ENOMEM);
 
     return 0;
 }
@@ -204,6 +265,7 @@ static int config_props(AVFilterLink *link)
 
     s->hsub = desc->log2_chroma_w;
     s->vsub = desc->log2_chroma_h;
+    s->nb_threads = ff_filter_get_nb_threads(link->dst);
 
     ret = init_filter_param(link->dst, &s->luma,   "luma",   link->w);
     if (ret < 0)
@@ -217,10 +279,8 @@ static int config_props(AVFilterLink *link)
 
 static void free_filter_param(UnsharpFilterParam *fp)
 {
-    int z;
-
-    for (z = 0; z < 2 * fp->steps_y; z++)
-        av_freep(&fp->sc[z]);
+    av_freep(&fp->sr);
+    av_freep(&fp->sc);
 }
 
 static av_cold void uninit(AVFilterContext *ctx)
@@ -314,5 +374,5 @@ AVFilter ff_vf_unsharp = {
     .query_formats = query_formats,
     .inputs        = avfilter_vf_unsharp_inputs,
     .outputs       = avfilter_vf_unsharp_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
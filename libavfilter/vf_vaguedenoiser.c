@@ -51,17 +51,21 @@ typedef struct VagueDenoiserContext {
     float *in;
     float *out;
     float *tmp;
+    int buf_size;
+    int nb_threads;
 
     int hlowsize[4][32];
     int hhighsize[4][32];
     int vlowsize[4][32];
     int vhighsize[4][32];
-
-    void (*thresholding)(float *block, const int width, const int height,
-                         const int stride, const float threshold,
-                         const float percent, const int nsteps);
 } VagueDenoiserContext;
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int plane;
+    int width, height;      ///< size of the part of the plane being transformed
+} ThreadData;
+
 #define OFFSET(x) offsetof(VagueDenoiserContext, x)
 #define FLAGS AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM
 static const AVOption vaguedenoiser_options[] = {
@@ -80,6 +84,9 @@ AVFILTER_DEFINE_CLASS(vaguedenoiser);
 
 #define NPAD 10
 
+/* the columns are transformed by blocks of that many columns at once */
+#define BLOCK_COLS 32
+
 static const float analysis_low[9] = {
     0.037828455506995f, -0.023849465019380f, -0.110624404418423f, 0.377402855612654f,
     0.852698679009403f, 0.377402855612654f, -0.110624404418423f, -0.023849465019380f, 0.037828455506995f
@@ -130,7 +137,8 @@ static int query_formats(AVFilterContext *ctx)
 
 static int config_input(AVFilterLink *inlink)
 {
-    VagueDenoiserContext *s = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
+    VagueDenoiserContext *s = ctx->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     int p, i, nsteps_width, nsteps_height, nsteps_max;
 
@@ -142,10 +150,13 @@ static int config_input(AVFilterLink *inlink)
     s->planewidth[1]  = s->planewidth[2]  = AV_CEIL_RSHIFT(inlink->w, desc->log2_chroma_w);
     s->planewidth[0]  = s->planewidth[3]  = inlink->w;
 
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    s->buf_size   = (32 + FFMAX(inlink->w, inlink->h)) * BLOCK_COLS;
+
     s->block = av_malloc_array(inlink->w * inlink->h, sizeof(*s->block));
-    s->in    = av_malloc_array(32 + FFMAX(inlink->w, inlink->h), sizeof(*s->in));
-    s->out   = av_malloc_array(32 + FFMAX(inlink->w, inlink->h), sizeof(*s->out));
-    s->tmp   = av_malloc_array(32 + FFMAX(inlink->w, inlink->h), sizeof(*s->tmp));
+    s->in    = av_mallocz_array(s->buf_size * s->nb_threads, sizeof(*s->in));
+    s->out   = av_mallocz_array(s->buf_size * s->nb_threads, sizeof(*s->out));
+    s->tmp   = av_mallocz_array(s->buf_size * s->nb_threads, sizeof(*s->tmp));
 
     if (!s->block || !s->in || !s->out || !s->tmp)
         return AVERROR(ENOMEM);
@@ -185,33 +196,17 @@ static inline void copy(const float *p1, float *p2, const int length)
     memcpy(p2, p1, length * sizeof(float));
 }
 
-static inline void copyv(const float *p1, const int stride1, float *p2, const int length)
-{
-    int i;
-
-    for (i = 0; i < length; i++) {
-        p2[i] = *p1;
-        p1 += stride1;
-    }
-}
-
-static inline void copyh(const float *p1, float *p2, const int stride2, const int length)
-{
-    int i;
-
-    for (i = 0; i < length; i++) {
-        *p2 = p1[i];
-        p2 += stride2;
-    }
-}
-
 // Do symmetric extension of data using prescribed symmetries
 // Original values are in output[npad] through output[npad+size-1]
 // New values will be placed in output[0] through output[npad] and in output[npad+size] through output[2*npad+size-1] (note: end values may not be filled in)
 // extension at left bdry is ... 3 2 1 0 | 0 1 2 3 ...
 // same for right boundary
 // if right_ext=1 then ... 3 2 1 0 | 1 2 3
-static void symmetric_extension(float *output, const int size, const int left_ext, const int right_ext)
+// Every value is made of n floats, n > 1 is used to extend BLOCK_COLS
+// columns at once.
+#define EXTEND(dst, src) memcpy(output + (dst) * n, output + (src) * n, n * sizeof(*output))
+static void symmetric_extension(float *output, const int size, const int left_ext, const int right_ext,
+                                const int n)
 {
     int first = NPAD;
     int last = NPAD - 1 + size;
@@ -219,28 +214,29 @@ static void symmetric_extension(float *output, const int size, const int left_ex
     int i, nextend, idx;
 
     if (left_ext == 2)
-        output[--first] = output[NPAD];
+        EXTEND(--first, NPAD);
     if (right_ext == 2)
-        output[++last] = output[originalLast];
+        EXTEND(++last, originalLast);
 
     // extend left end
     nextend = first;
     for (i = 0; i < nextend; i++)
-        output[--first] = output[NPAD + 1 + i];
+        EXTEND(--first, NPAD + 1 + i);
 
     idx = NPAD + NPAD - 1 + size;
 
     // extend right end
     nextend = idx - last;
     for (i = 0; i < nextend; i++)
-        output[++last] = output[originalLast - 1 - i];
+        EXTEND(++last, originalLast - 1 - i);
 }
+#undef EXTEND
 
 static void transform_step(float *input, float *output, const int size, const int low_size, VagueDenoiserContext *s)
 {
     int i;
 
-    symmetric_extension(input, size, 1, 1);
+    symmetric_extension(input, size, 1, 1, 1);
 
     for (i = NPAD; i < NPAD + low_size; i++) {
         const float a = input[2 * i - 14] * analysis_low[0];
@@ -279,7 +275,7 @@ static void invert_step(const float *input, float *output, float *temp, const in
     memcpy(temp + NPAD, input + NPAD, low_size * sizeof(float));
 
     right_ext = (size % 2 == 0) ? 2 : 1;
-    symmetric_extension(temp, low_size, left_ext, right_ext);
+    symmetric_extension(temp, low_size, left_ext, right_ext, 1);
 
     memset(output, 0, (NPAD + NPAD + size) * sizeof(float));
     findex = (size + 2) >> 1;
@@ -303,7 +299,7 @@ static void invert_step(const float *input, float *output, float *temp, const in
 
     left_ext = 2;
     right_ext = (size % 2 == 0) ? 1 : 2;
-    symmetric_extension(temp, high_size, left_ext, right_ext);
+    symmetric_extension(temp, high_size, left_ext, right_ext, 1);
 
     for (i = 8; i < findex + 11; i++) {
         const float a = temp[i] * synthesis_high[0];
@@ -324,89 +320,361 @@ static void invert_step(const float *input, float *output, float *temp, const in
     }
 }
 
-static void hard_thresholding(float *block, const int width, const int height,
-                              const int stride, const float threshold,
-                              const float percent, const int unused)
+static void fir_v(float *dst, const float *src, ptrdiff_t stride,
+                  const float *coefs, int ntaps, int n)
 {
-    const float frac = 1.f - percent * 0.01f;
-    int y, x;
+    int x, k;
+
+    for (x = 0; x < n; x++)
+        dst[x] = src[x] * coefs[0];
 
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            if (FFABS(block[x]) <= threshold)
-                block[x] *= frac;
+    for (k = 1; k < ntaps; k++) {
+        src += stride;
+        for (x = 0; x < n; x++)
+            dst[x] += src[x] * coefs[k];
+    }
+}
+
+static void fir_v_add(float *dst, ptrdiff_t stride, const float *src,
+                      const float *coefs, int ntaps, int n)
+{
+    int x, k;
+
+    for (k = 0; k < ntaps; k++) {
+        for (x = 0; x < n; x++)
+            dst[x] += src[x] * coefs[k];
+        dst += stride;
+    }
+}
+
+/* Same as transform_step(), for BLOCK_COLS columns of n values stored as
+ * rows of BLOCK_COLS floats. */
+static void transform_step_v(float *input, float *output, const int size, const int low_size,
+                             const int n)
+{
+    int i;
+
+    symmetric_extension(input, size, 1, 1, BLOCK_COLS);
+
+    for (i = NPAD; i < NPAD + low_size; i++)
+        fir_v(output + i * BLOCK_COLS, input + (2 * i - 14) * BLOCK_COLS,
+              BLOCK_COLS, analysis_low, 9, n);
+
+    for (i = NPAD; i < NPAD + low_size; i++)
+        fir_v(output + (i + low_size) * BLOCK_COLS, input + (2 * i - 12) * BLOCK_COLS,
+              BLOCK_COLS, analysis_high, 7, n);
+}
+
+/* Same as invert_step(), for BLOCK_COLS columns. */
+static void invert_step_v(const float *input, float *output, float *temp, const int size,
+                          const int n)
+{
+    const int low_size = (size + 1) >> 1;
+    const int high_size = size >> 1;
+    int left_ext = 1, right_ext, i;
+    int findex;
+
+    memcpy(temp + NPAD * BLOCK_COLS, input + NPAD * BLOCK_COLS,
+           low_size * BLOCK_COLS * sizeof(float));
+
+    right_ext = (size % 2 == 0) ? 2 : 1;
+    symmetric_extension(temp, low_size, left_ext, right_ext, BLOCK_COLS);
+
+    memset(output, 0, (NPAD + NPAD + size) * BLOCK_COLS * sizeof(float));
+    findex = (size + 2) >> 1;
+
+    for (i = 9; i < findex + 11; i++)
+        fir_v_add(output + (2 * i - 13) * BLOCK_COLS, BLOCK_COLS,
+                  temp + i * BLOCK_COLS, synthesis_low, 7, n);
+
+    memcpy(temp + NPAD * BLOCK_COLS, input + (NPAD + low_size) * BLOCK_COLS,
+           high_size * BLOCK_COLS * sizeof(float));
+
+    left_ext = 2;
+    right_ext = (size % 2 == 0) ? 1 : 2;
+    symmetric_extension(temp, high_size, left_ext, right_ext, BLOCK_COLS);
+
+    for (i = 8; i < findex + 11; i++)
+        fir_v_add(output + (2 * i - 13) * BLOCK_COLS, BLOCK_COLS,
+                  temp + i * BLOCK_COLS, synthesis_high, 9, n);
+}
+
+static void hard_thresholding(float *block, const int width, const float threshold,
+                              const float frac, const float unused)
+{
+    int x;
+
+    for (x = 0; x < width; x++) {
+        if (FFABS(block[x]) <= threshold)
+            block[x] *= frac;
+    }
+}
+
+static void soft_thresholding(float *block, const int width, const float threshold,
+                              const float frac, const float shift)
+{
+    int x;
+
+    for (x = 0; x < width; x++) {
+        const float temp = FFABS(block[x]);
+        if (temp <= threshold)
+            block[x] *= frac;
+        else
+            block[x] = (block[x] < 0.f ? -1.f : (block[x] > 0.f ? 1.f : 0.f)) * (temp - shift);
+    }
+}
+
+static void qian_thresholding(float *block, const int width, const float threshold,
+                              const float frac, const float tr2)
+{
+    int x;
+
+    for (x = 0; x < width; x++) {
+        const float temp = FFABS(block[x]);
+        if (temp <= threshold) {
+            block[x] *= frac;
+        } else {
+            const float tp2 = temp * temp;
+            block[x] *= (tp2 - tr2) / tp2;
         }
-        block += stride;
     }
 }
 
-static void soft_thresholding(float *block, const int width, const int height, const int stride,
-                              const float threshold, const float percent, const int nsteps)
+static void (* const thresholding[3])(float *block, int width, float threshold,
+                                      float frac, float param) = {
+    hard_thresholding,
+    soft_thresholding,
+    qian_thresholding,
+};
+
+static int load_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    const float frac = 1.f - percent * 0.01f;
-    const float shift = threshold * 0.01f * percent;
-    int w = width;
-    int h = height;
-    int y, x, l;
+    VagueDenoiserContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int p = td->plane;
+    const int width = s->planewidth[p];
+    const int slice_start = (s->planeheight[p] *  jobnr     ) / nb_jobs;
+    const int slice_end   = (s->planeheight[p] * (jobnr + 1)) / nb_jobs;
+    const uint8_t *srcp8 = td->in->data[p] + slice_start * td->in->linesize[p];
+    const uint16_t *srcp16 = (const uint16_t *)srcp8;
+    float *output = s->block + slice_start * width;
+    int y, x;
 
-    for (l = 0; l < nsteps; l++) {
-        w = (w + 1) >> 1;
-        h = (h + 1) >> 1;
+    if (s->depth <= 8) {
+        for (y = slice_start; y < slice_end; y++) {
+            for (x = 0; x < width; x++)
+                output[x] = srcp8[x];
+            srcp8 += td->in->linesize[p];
+            output += width;
+        }
+    } else {
+        for (y = slice_start; y < slice_end; y++) {
+            for (x = 0; x < width; x++)
+                output[x] = srcp16[x];
+            srcp16 += td->in->linesize[p] / 2;
+            output += width;
+        }
     }
+    return 0;
+}
 
-    for (y = 0; y < height; y++) {
-        const int x0 = (y < h) ? w : 0;
-        for (x = x0; x < width; x++) {
-            const float temp = FFABS(block[x]);
-            if (temp <= threshold)
-                block[x] *= frac;
-            else
-                block[x] = (block[x] < 0.f ? -1.f : (block[x] > 0.f ? 1.f : 0.f)) * (temp - shift);
+static int store_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VagueDenoiserContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int p = td->plane;
+    const int width = s->planewidth[p];
+    const int slice_start = (s->planeheight[p] *  jobnr     ) / nb_jobs;
+    const int slice_end   = (s->planeheight[p] * (jobnr + 1)) / nb_jobs;
+    uint8_t *dstp8 = td->out->data[p] + slice_start * td->out->linesize[p];
+    uint16_t *dstp16 = (uint16_t *)dstp8;
+    const float *input = s->block + slice_start * width;
+    int y, x;
+
+    if (s->depth <= 8) {
+        for (y = slice_start; y < slice_end; y++) {
+            for (x = 0; x < width; x++)
+                dstp8[x] = av_clip_uint8(input[x] + 0.5f);
+            input += width;
+            dstp8 += td->out->linesize[p];
         }
-        block += stride;
+    } else {
+        for (y = slice_start; y < slice_end; y++) {
+            for (x = 0; x < width; x++)
+                dstp16[x] = av_clip(input[x] + 0.5f, 0, s->peak);
+            input += width;
+            dstp16 += td->out->linesize[p] / 2;
+        }
+    }
+    return 0;
+}
+
+static int transform_rows(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VagueDenoiserContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int width = s->planewidth[td->plane];
+    const int low_size = (td->width + 1) >> 1;
+    const int slice_start = (td->height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (td->height * (jobnr + 1)) / nb_jobs;
+    float *in  = s->in  + jobnr * s->buf_size;
+    float *out = s->out + jobnr * s->buf_size;
+    float *input = s->block + slice_start * width;
+    int j;
+
+    for (j = slice_start; j < slice_end; j++) {
+        copy(input, in + NPAD, td->width);
+        transform_step(in, out, td->width, low_size, s);
+        copy(out + NPAD, input, td->width);
+        input += width;
+    }
+    return 0;
+}
+
+static int invert_rows(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VagueDenoiserContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int width = s->planewidth[td->plane];
+    const int slice_start = (td->height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (td->height * (jobnr + 1)) / nb_jobs;
+    float *in  = s->in  + jobnr * s->buf_size;
+    float *out = s->out + jobnr * s->buf_size;
+    float *tmp = s->tmp + jobnr * s->buf_size;
+    float *idx3 = s->block + slice_start * width;
+    int i;
+
+    for (i = slice_start; i < slice_end; i++) {
+        copy(idx3, in + NPAD, td->width);
+        invert_step(in, out, tmp, td->width, s);
+        copy(out + NPAD, idx3, td->width);
+        idx3 += width;
+    }
+    return 0;
+}
+
+static int nb_col_blocks(int width)
+{
+    return (width + BLOCK_COLS - 1) / BLOCK_COLS;
+}
+
+static void copy_cols_in(const float *src, int stride, float *dst, int n, int h)
+{
+    int y;
+
+    for (y = 0; y < h; y++) {
+        memcpy(dst, src, n * sizeof(*dst));
+        src += stride;
+        dst += BLOCK_COLS;
+    }
+}
+
+static void copy_cols_out(const float *src, float *dst, int stride, int n, int h)
+{
+    int y;
+
+    for (y = 0; y < h; y++) {
+        memcpy(dst, src, n * sizeof(*dst));
+        src += BLOCK_COLS;
+        dst += stride;
+    }
+}
+
+static int transform_cols(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VagueDenoiserContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int width = s->planewidth[td->plane];
+    const int low_size = (td->height + 1) >> 1;
+    const int nb_blocks = nb_col_blocks(td->width);
+    const int slice_start = (nb_blocks *  jobnr     ) / nb_jobs * BLOCK_COLS;
+    const int slice_end   = FFMIN((nb_blocks * (jobnr + 1)) / nb_jobs * BLOCK_COLS, td->width);
+    float *in  = s->in  + jobnr * s->buf_size;
+    float *out = s->out + jobnr * s->buf_size;
+    int x;
+
+    for (x = slice_start; x < slice_end; x += BLOCK_COLS) {
+        const int n = FFMIN(BLOCK_COLS, slice_end - x);
+
+        copy_cols_in(s->block + x, width, in + NPAD * BLOCK_COLS, n, td->height);
+        transform_step_v(in, out, td->height, low_size, n);
+        copy_cols_out(out + NPAD * BLOCK_COLS, s->block + x, width, n, td->height);
+    }
+    return 0;
+}
+
+static int invert_cols(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VagueDenoiserContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int width = s->planewidth[td->plane];
+    const int nb_blocks = nb_col_blocks(td->width);
+    const int slice_start = (nb_blocks *  jobnr     ) / nb_jobs * BLOCK_COLS;
+    const int slice_end   = FFMIN((nb_blocks * (jobnr + 1)) / nb_jobs * BLOCK_COLS, td->width);
+    float *in  = s->in  + jobnr * s->buf_size;
+    float *out = s->out + jobnr * s->buf_size;
+    float *tmp = s->tmp + jobnr * s->buf_size;
+    int x;
+
+    for (x = slice_start; x < slice_end; x += BLOCK_COLS) {
+        const int n = FFMIN(BLOCK_COLS, slice_end - x);
+
+        copy_cols_in(s->block + x, width, in + NPAD * BLOCK_COLS, n, td->height);
+        invert_step_v(in, out, tmp, td->height, n);
+        copy_cols_out(out + NPAD * BLOCK_COLS, s->block + x, width, n, td->height);
     }
+    return 0;
 }
 
-static void qian_thresholding(float *block, const int width, const int height,
-                              const int stride, const float threshold,
-                              const float percent, const int unused)
+static int threshold_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    const float percent01 = percent * 0.01f;
-    const float tr2 = threshold * threshold * percent01;
+    VagueDenoiserContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int width  = s->planewidth[td->plane];
+    const int height = s->planeheight[td->plane];
+    const int slice_start = (height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (height * (jobnr + 1)) / nb_jobs;
+    const float threshold = s->threshold;
+    const float percent01 = s->percent * 0.01f;
     const float frac = 1.f - percent01;
-    int y, x;
+    const float param = s->method == 1 ? threshold * 0.01f * s->percent :
+                        s->method == 2 ? threshold * threshold * percent01 : 0.f;
+    float *block = s->block + slice_start * width;
+    int w = width;
+    int h = height;
+    int y, l;
 
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++) {
-            const float temp = FFABS(block[x]);
-            if (temp <= threshold) {
-                block[x] *= frac;
-            } else {
-                const float tp2 = temp * temp;
-                block[x] *= (tp2 - tr2) / tp2;
-            }
+    /* soft thresholding leaves the lowest band alone */
+    if (s->method == 1) {
+        for (l = 0; l < s->nsteps; l++) {
+            w = (w + 1) >> 1;
+            h = (h + 1) >> 1;
         }
-        block += stride;
+    } else {
+        h = 0;
+    }
+
+    for (y = slice_start; y < slice_end; y++) {
+        const int x0 = (y < h) ? w : 0;
+
+        thresholding[s->method](block + x0, width - x0, threshold, frac, param);
+        block += width;
     }
+    return 0;
 }
 
-static void filter(VagueDenoiserContext *s, AVFrame *in, AVFrame *out)
+static void filter(AVFilterContext *ctx, AVFrame *in, AVFrame *out)
 {
-    int p, y, x, i, j;
+    VagueDenoiserContext *s = ctx->priv;
+    int p;
 
     for (p = 0; p < s->nb_planes; p++) {
         const int height = s->planeheight[p];
         const int width = s->planewidth[p];
-        const uint8_t *srcp8 = in->data[p];
-        const uint16_t *srcp16 = (const uint16_t *)in->data[p];
-        uint8_t *dstp8 = out->data[p];
-        uint16_t *dstp16 = (uint16_t *)out->data[p];
-        float *output = s->block;
-        int h_low_size0 = width;
-        int v_low_size0 = height;
+        const int nb_jobs = FFMIN(height, s->nb_threads);
         int nsteps_transform = s->nsteps;
         int nsteps_invert = s->nsteps;
-        const float *input = s->block;
+        ThreadData td;
 
         if (!((1 << p) & s->planes)) {
             av_image_copy_plane(out->data[p], out->linesize[p], in->data[p], in->linesize[p],
@@ -414,89 +682,43 @@ static void filter(VagueDenoiserContext *s, AVFrame *in, AVFrame *out)
             continue;
         }
 
-        if (s->depth <= 8) {
-            for (y = 0; y < height; y++) {
-                for (x = 0; x < width; x++)
-                    output[x] = srcp8[x];
-                srcp8 += in->linesize[p];
-                output += width;
-            }
-        } else {
-            for (y = 0; y < height; y++) {
-                for (x = 0; x < width; x++)
-                    output[x] = srcp16[x];
-                srcp16 += in->linesize[p] / 2;
-                output += width;
-            }
-        }
+        td.in     = in;
+        td.out    = out;
+        td.plane  = p;
+        td.width  = width;
+        td.height = height;
+
+        ctx->internal->execute(ctx, load_slice, &td, NULL, nb_jobs);
 
         while (nsteps_transform--) {
-            int low_size = (h_low_size0 + 1) >> 1;
-            float *input = s->block;
-            for (j = 0; j < v_low_size0; j++) {
-                copy(input, s->in + NPAD, h_low_size0);
-                transform_step(s->in, s->out, h_low_size0, low_size, s);
-                copy(s->out + NPAD, input, h_low_size0);
-                input += width;
-            }
-
-            low_size = (v_low_size0 + 1) >> 1;
-            input = s->block;
-            for (j = 0; j < h_low_size0; j++) {
-                copyv(input, width, s->in + NPAD, v_low_size0);
-                transform_step(s->in, s->out, v_low_size0, low_size, s);
-                copyh(s->out + NPAD, input, width, v_low_size0);
-                input++;
-            }
-
-            h_low_size0 = (h_low_size0 + 1) >> 1;
-            v_low_size0 = (v_low_size0 + 1) >> 1;
+            ctx->internal->execute(ctx, transform_rows, &td, NULL,
+                                   FFMIN(td.height, s->nb_threads));
+            ctx->internal->execute(ctx, transform_cols, &td, NULL,
+                                   FFMIN(nb_col_blocks(td.width), s->nb_threads));
+
+            td.width  = (td.width  + 1) >> 1;
+            td.height = (td.height + 1) >> 1;
         }
 
-        s->thresholding(s->block, width, height, width, s->threshold, s->percent, s->nsteps);
+        ctx->internal->execute(ctx, threshold_slice, &td, NULL, nb_jobs);
 
         while (nsteps_invert--) {
-            const int idx = s->vlowsize[p][nsteps_invert]  + s->vhighsize[p][nsteps_invert];
-            const int idx2 = s->hlowsize[p][nsteps_invert] + s->hhighsize[p][nsteps_invert];
-            float * idx3 = s->block;
-            for (i = 0; i < idx2; i++) {
-                copyv(idx3, width, s->in + NPAD, idx);
-                invert_step(s->in, s->out, s->tmp, idx, s);
-                copyh(s->out + NPAD, idx3, width, idx);
-                idx3++;
-            }
-
-            idx3 = s->block;
-            for (i = 0; i < idx; i++) {
-                copy(idx3, s->in + NPAD, idx2);
-                invert_step(s->in, s->out, s->tmp, idx2, s);
-                copy(s->out + NPAD, idx3, idx2);
-                idx3 += width;
-            }
-        }
+            td.height = s->vlowsize[p][nsteps_invert] + s->vhighsize[p][nsteps_invert];
+            td.width  = s->hlowsize[p][nsteps_invert] + s->hhighsize[p][nsteps_invert];
 
-        if (s->depth <= 8) {
-            for (y = 0; y < height; y++) {
-                for (x = 0; x < width; x++)
-                    dstp8[x] = av_clip_uint8(input[x] + 0.5f);
-                input += width;
-                dstp8 += out->linesize[p];
-            }
-        } else {
-            for (y = 0; y < height; y++) {
-                for (x = 0; x < width; x++)
-                    dstp16[x] = av_clip(input[x] + 0.5f, 0, s->peak);
-                input += width;
-                dstp16 += out->linesize[p] / 2;
-            }
+            ctx->internal->execute(ctx, invert_cols, &td, NULL,
+                                   FFMIN(nb_col_blocks(td.width), s->nb_threads));
+            ctx->internal->execute(ctx, invert_rows, &td, NULL,
+                                   FFMIN(td.height, s->nb_threads));
         }
+
+        ctx->internal->execute(ctx, store_slice, &td, NULL, nb_jobs);
     }
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx  = inlink->dst;
-    VagueDenoiserContext *s = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out;
     int direct = av_frame_is_writable(in);
@@ -513,7 +735,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         av_frame_copy_props(out, in);
     }
 
-    filter(s, in, out);
+    filter(ctx, in, out);
 
     if (!direct)
         av_frame_free(&in);
@@ -521,25 +743,6 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     return ff_filter_frame(outlink, out);
 }
 
-static av_cold int init(AVFilterContext *ctx)
-{
-    VagueDenoiserContext *s = ctx->priv;
-
-    switch (s->method) {
-    case 0:
-        s->thresholding = hard_thresholding;
-        break;
-    case 1:
-        s->thresholding = soft_thresholding;
-        break;
-    case 2:
-        s->thresholding = qian_thresholding;
-        break;
-    }
-
-    return 0;
-}
-
 static av_cold void uninit(AVFilterContext *ctx)
 {
     VagueDenoiserContext *s = ctx->priv;
@@ -574,10 +777,9 @@ AVFilter ff_vf_vaguedenoiser = {
     .description   = NULL_IF_CONFIG_SMALL("Apply a Wavelet based Denoiser."),
     .priv_size     = sizeof(VagueDenoiserContext),
     .priv_class    = &vaguedenoiser_class,
-    .init          = init,
     .uninit        = uninit,
     .query_formats = query_formats,
     .inputs        = vaguedenoiser_inputs,
     .outputs       = vaguedenoiser_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
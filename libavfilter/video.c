@@ -29,6 +29,7 @@
 #include "libavutil/mem.h"
 
 #include "avfilter.h"
+#include "framepool.h"
 #include "internal.h"
 #include "video.h"
 
@@ -40,34 +41,95 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
     return ff_get_video_buffer(link->dst->outputs[0], w, h);
 }
 
-AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
+/* Maximum number of distinct buffer configurations kept by a graph. */
+#define MAX_GRAPH_FRAME_POOLS 16
+
+static int pool_matches(FFVideoFramePool *pool, int w, int h,
+                        enum AVPixelFormat format, int align)
 {
     int pool_width = 0;
     int pool_height = 0;
     int pool_align = 0;
     enum AVPixelFormat pool_format = AV_PIX_FMT_NONE;
 
+    if (ff_video_frame_pool_get_config(pool, &pool_width, &pool_height,
+                                       &pool_format, &pool_align) < 0)
+        return 0;
+    return pool_width == w && pool_height == h &&
+           pool_format == format && pool_align == align;
+}
+
+/**
+ * Get a frame from the pools shared by all the links of a graph.
+ * Links carrying frames of the same size and format draw from the same
+ * pool, so that the buffers released by one filter are reused by the
+ * next ones instead of each link keeping its own set of buffers.
+ */
+static AVFrame *graph_get_video_buffer(AVFilterGraph *graph, int w, int h,
+                                       enum AVPixelFormat format)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    FFVideoFramePool *pool = NULL;
+    AVFrame *frame = NULL;
+    int i;
+
+    ff_mutex_lock(&gi->frame_pool_lock);
+    for (i = 0; i < gi->nb_frame_pools; i++) {
+        if (pool_matches(gi->frame_pools[i], w, h, format, BUFFER_ALIGN)) {
+            pool = gi->frame_pools[i];
+            break;
+        }
+    }
+    if (!pool) {
+        pool = ff_video_frame_pool_init(av_buffer_allocz, w, h, format,
+                                        BUFFER_ALIGN);
+        if (!pool)
+            goto end;
+        if (gi->nb_frame_pools == MAX_GRAPH_FRAME_POOLS) {
+            /* drop the least recently used configuration; the buffers
+               still in use are freed when their last reference goes */
+            ff_video_frame_pool_uninit(&gi->frame_pools[--gi->nb_frame_pools]);
+        } else {
+            FFVideoFramePool **pools = av_realloc_array(gi->frame_pools,
+                                                        gi->nb_frame_pools + 1,
+                                                        sizeof(*pools));
+            if (!pools) {
+                ff_video_frame_pool_uninit(&pool);
+                goto end;
+            }
+            gi->frame_pools = pools;
+        }
+        i = gi->nb_frame_pools++;
+    }
+    memmove(gi->frame_pools + 1, gi->frame_pools, i * sizeof(*gi->frame_pools));
+    gi->frame_pools[0] = pool;
+
+    frame = ff_video_frame_pool_get(pool);
+end:
+    ff_mutex_unlock(&gi->frame_pool_lock);
+    return frame;
+}
+
+AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
+{
+    AVFrame *frame;
+
+    if (link->graph) {
+        frame = graph_get_video_buffer(link->graph, w, h, link->format);
+        if (frame)
+            ff_filter_count_allocation(link);
+        return frame;
+    }
+
+    if (link->video_frame_pool &&
+        !pool_matches(link->video_frame_pool, w, h, link->format, BUFFER_ALIGN))
+        ff_video_frame_pool_uninit((FFVideoFramePool **)&link->video_frame_pool);
+
     if (!link->video_frame_pool) {
         link->video_frame_pool = ff_video_frame_pool_init(av_buffer_allocz, w, h,
                                                           link->format, BUFFER_ALIGN);
         if (!link->video_frame_pool)
             return NULL;
-    } else {
-        if (ff_video_frame_pool_get_config(link->video_frame_pool,
-                                           &pool_width, &pool_height,
-                                           &pool_format, &pool_align) < 0) {
-            return NULL;
-        }
-
-        if (pool_width != w || pool_height != h ||
-            pool_format != link->format || pool_align != BUFFER_ALIGN) {
-
-            ff_video_frame_pool_uninit((FFVideoFramePool **)&link->video_frame_pool);
-            link->video_frame_pool = ff_video_frame_pool_init(av_buffer_allocz, w, h,
-                                                              link->format, BUFFER_ALIGN);
-            if (!link->video_frame_pool)
-                return NULL;
-        }
     }
 
     return ff_video_frame_pool_get(link->video_frame_pool);
@@ -87,3 +149,20 @@ AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
 
     return ret;
 }
+
+AVFrame *ff_get_video_buffer_inplace(AVFilterLink *outlink, AVFrame *in)
+{
+    AVFilterLink *inlink = outlink->src->inputs[0];
+    AVFrame *out;
+
+    if (av_frame_is_writable(in) &&
+        in->width  == outlink->w && in->height == outlink->h &&
+        inlink->format == outlink->format)
+        return in;
+
+    out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+    if (!out)
+        return NULL;
+    av_frame_copy_props(out, in);
+    return out;
+}
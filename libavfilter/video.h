@@ -38,4 +38,19 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h);
  */
 AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h);
 
+/**
+ * Get the output frame of a filter able to work in place.
+ *
+ * If the input frame is writable and has the size and format of the
+ * output link, it is returned as is and the filter can process it in
+ * place; otherwise a new buffer is allocated and the properties of the
+ * input frame are copied to it.
+ *
+ * @param outlink the output link of the filter; its source filter must
+ *                have a single input with the same format
+ * @param in      the input frame, still owned by the caller
+ * @return        in, a new frame or NULL on allocation failure
+ */
+AVFrame *ff_get_video_buffer_inplace(AVFilterLink *outlink, AVFrame *in);
+
 #endif /* AVFILTER_VIDEO_H */
@@ -28,6 +28,7 @@
 
 #include <float.h>
 #include "attributes.h"
+#include "avassert.h"
 #include "avutil.h"
 #include "common.h"
 #include "eval.h"
@@ -146,6 +147,8 @@ static int strmatch(const char *s, const char *prefix)
     return !IS_IDENTIFIER_CHAR(s[i]);
 }
 
+#define EXPR_BLOCK 64
+
 struct AVExpr {
     enum {
         e_value, e_const, e_func0, e_func1, e_func2,
@@ -165,6 +168,13 @@ struct AVExpr {
     } a;
     struct AVExpr *param[3];
     double *var;
+
+    /* flattened program used by av_expr_eval_array(), root node only */
+    const struct AVExpr **prog;   ///< nodes in evaluation order, NULL pushes 0
+    int nb_insns;
+    int nb_consts;                ///< highest constant index used + 1
+    double (*stack)[EXPR_BLOCK];  ///< one row of lanes per stack slot
+    double *const_buf;            ///< per-lane constants for the fallback path
 };
 
 static double etime(double v)
@@ -322,6 +332,9 @@ void av_expr_free(AVExpr *e)
     av_expr_free(e->param[1]);
     av_expr_free(e->param[2]);
     av_freep(&e->var);
+    av_freep(&e->prog);
+    av_freep(&e->stack);
+    av_freep(&e->const_buf);
     av_freep(&e);
 }
 
@@ -655,6 +668,194 @@ static int verify_expr(AVExpr *e)
     }
 }
 
+static int count_consts(const AVExpr *e)
+{
+    int i, nb = 0;
+
+    if (!e)
+        return 0;
+    if (e->type == e_const)
+        nb = e->a.const_index + 1;
+    for (i = 0; i < 3; i++)
+        nb = FFMAX(nb, count_consts(e->param[i]));
+    return nb;
+}
+
+/**
+ * Flatten the tree into a postfix program for a stack machine whose
+ * slots hold EXPR_BLOCK lanes each. Constructs with side effects or data
+ * dependent control flow cannot be evaluated over several lanes at once
+ * and make the whole expression fall back to the tree walker.
+ */
+static int flatten_expr(const AVExpr **prog, int *nb_insns, int *max_depth,
+                        int depth, const AVExpr *e)
+{
+    int i, nb_args, ret;
+
+    if (e) {
+        switch (e->type) {
+        case e_value:
+        case e_const:
+            nb_args = 0;
+            break;
+        case e_st:
+        case e_while:
+        case e_taylor:
+        case e_root:
+        case e_print:
+        case e_random:
+            return AVERROR(ENOSYS);
+        case e_if:
+        case e_ifnot:
+        case e_between:
+        case e_clip:
+            nb_args = 3;
+            break;
+        default:
+            nb_args = e->param[1] ? 2 : 1;
+        }
+
+        for (i = 0; i < nb_args; i++)
+            if ((ret = flatten_expr(prog, nb_insns, max_depth, depth + i, e->param[i])) < 0)
+                return ret;
+    }
+
+    if (prog)
+        prog[*nb_insns] = e;
+    (*nb_insns)++;
+    *max_depth = FFMAX(*max_depth, depth + 1);
+    return 0;
+}
+
+/* called on the first av_expr_eval_array(), sets up either prog or const_buf */
+static int compile_expr(AVExpr *e)
+{
+    int nb_insns = 0, max_depth = 0;
+
+    if (flatten_expr(NULL, &nb_insns, &max_depth, 0, e) < 0) {
+        e->nb_consts = count_consts(e);
+        e->const_buf = av_malloc_array(FFMAX(e->nb_consts, 1), sizeof(*e->const_buf));
+        return e->const_buf ? 0 : AVERROR(ENOMEM);
+    }
+
+    e->prog  = av_malloc_array(nb_insns, sizeof(*e->prog));
+    e->stack = av_malloc_array(max_depth, sizeof(*e->stack));
+    if (!e->prog || !e->stack) {
+        av_freep(&e->prog);
+        av_freep(&e->stack);
+        return AVERROR(ENOMEM);
+    }
+    e->nb_insns = 0;
+    flatten_expr(e->prog, &e->nb_insns, &max_depth, 0, e);
+    return 0;
+}
+
+static void eval_block(AVExpr *root, double *res, int start, int len,
+                       const double *const_values,
+                       const double * const *const_arrays, void *opaque)
+{
+    double (*stack)[EXPR_BLOCK] = root->stack;
+    const double *var = root->var;
+    int sp = 0, n, i;
+
+    for (n = 0; n < root->nb_insns; n++) {
+        const AVExpr *e = root->prog[n];
+        const double v = e ? e->value : 0;
+        double *d, *a, *b;
+
+        if (!e) {
+            d = stack[sp++];
+            for (i = 0; i < len; i++)
+                d[i] = 0;
+            continue;
+        }
+
+        switch (e->type) {
+        case e_value:
+            d = stack[sp++];
+            for (i = 0; i < len; i++)
+                d[i] = v;
+            break;
+        case e_const: {
+            const double *src = const_arrays ? const_arrays[e->a.const_index] : NULL;
+            d = stack[sp++];
+            if (src) {
+                src += start;
+                for (i = 0; i < len; i++)
+                    d[i] = v * src[i];
+            } else {
+                const double c = v * const_values[e->a.const_index];
+                for (i = 0; i < len; i++)
+                    d[i] = c;
+            }
+            break;
+        }
+#define UNARY(type, expr)                   \
+        case type:                          \
+            d = stack[sp - 1];              \
+            for (i = 0; i < len; i++)       \
+                d[i] = expr;                \
+            break;
+        UNARY(e_func0,  v * e->a.func0(d[i]))
+        UNARY(e_func1,  v * e->a.func1(opaque, d[i]))
+        UNARY(e_squish, 1/(1+exp(4*d[i])))
+        UNARY(e_gauss,  exp(-d[i]*d[i]/2)/sqrt(2*M_PI))
+        UNARY(e_ld,     v * var[av_clip(d[i], 0, VARS-1)])
+        UNARY(e_isnan,  v * !!isnan(d[i]))
+        UNARY(e_isinf,  v * !!isinf(d[i]))
+        UNARY(e_floor,  v * floor(d[i]))
+        UNARY(e_ceil,   v * ceil (d[i]))
+        UNARY(e_trunc,  v * trunc(d[i]))
+        UNARY(e_sqrt,   v * sqrt (d[i]))
+        UNARY(e_not,    v * (d[i] == 0))
+#define TERNARY(type, expr)                 \
+        case type:                          \
+            sp -= 2;                        \
+            d = stack[sp - 1];              \
+            a = stack[sp];                  \
+            b = stack[sp + 1];              \
+            for (i = 0; i < len; i++)       \
+                d[i] = expr;                \
+            break;
+        TERNARY(e_if,      v * ( d[i] ? a[i] : b[i]))
+        TERNARY(e_ifnot,   v * (!d[i] ? a[i] : b[i]))
+        TERNARY(e_between, v * (d[i] >= a[i] && d[i] <= b[i]))
+        TERNARY(e_clip,    isnan(a[i]) || isnan(b[i]) || isnan(d[i]) || a[i] > b[i] ?
+                           NAN : v * av_clipd(d[i], a[i], b[i]))
+#define BINARY(type, expr)                  \
+        case type:                          \
+            sp--;                           \
+            d = stack[sp - 1];              \
+            b = stack[sp];                  \
+            for (i = 0; i < len; i++)       \
+                d[i] = expr;                \
+            break;
+        BINARY(e_func2,  v * e->a.func2(opaque, d[i], b[i]))
+        BINARY(e_mod,    v * (d[i] - floor((!CONFIG_FTRAPV || b[i]) ? d[i] / b[i] : d[i] * INFINITY) * b[i]))
+        BINARY(e_gcd,    v * av_gcd(d[i], b[i]))
+        BINARY(e_max,    v * (d[i] >  b[i] ? d[i] : b[i]))
+        BINARY(e_min,    v * (d[i] <  b[i] ? d[i] : b[i]))
+        BINARY(e_eq,     v * (d[i] == b[i] ? 1.0 : 0.0))
+        BINARY(e_gt,     v * (d[i] >  b[i] ? 1.0 : 0.0))
+        BINARY(e_gte,    v * (d[i] >= b[i] ? 1.0 : 0.0))
+        BINARY(e_lt,     v * (d[i] <  b[i] ? 1.0 : 0.0))
+        BINARY(e_lte,    v * (d[i] <= b[i] ? 1.0 : 0.0))
+        BINARY(e_pow,    v * pow(d[i], b[i]))
+        BINARY(e_mul,    v * (d[i] * b[i]))
+        BINARY(e_div,    v * ((!CONFIG_FTRAPV || b[i]) ? (d[i] / b[i]) : d[i] * INFINITY))
+        BINARY(e_add,    v * (d[i] + b[i]))
+        BINARY(e_last,   v * b[i])
+        BINARY(e_hypot,  v * hypot(d[i], b[i]))
+        BINARY(e_bitand, isnan(d[i]) || isnan(b[i]) ? NAN : v * ((long int)d[i] & (long int)b[i]))
+        BINARY(e_bitor,  isnan(d[i]) || isnan(b[i]) ? NAN : v * ((long int)d[i] | (long int)b[i]))
+        default:
+            av_assert0(0);
+        }
+    }
+
+    memcpy(res + start, stack[0], len * sizeof(*res));
+}
+
 int av_expr_parse(AVExpr **expr, const char *s,
                   const char * const *const_names,
                   const char * const *func1_names, double (* const *funcs1)(void *, double),
@@ -720,6 +921,57 @@ double av_expr_eval(AVExpr *e, const double *const_values, void *opaque)
     return eval_expr(&p, e);
 }
 
+int av_expr_eval_array(AVExpr *e, double *res, int nb_values,
+                       const double *const_values,
+                       const double * const *const_arrays, void *opaque)
+{
+    int i, j, ret;
+
+    if (!e->prog && !e->const_buf && (ret = compile_expr(e)) < 0)
+        return ret;
+
+    if (e->prog) {
+        for (i = 0; i < nb_values; i += EXPR_BLOCK)
+            eval_block(e, res, i, FFMIN(EXPR_BLOCK, nb_values - i),
+                       const_values, const_arrays, opaque);
+        return 0;
+    }
+
+    for (i = 0; i < nb_values; i++) {
+        for (j = 0; j < e->nb_consts; j++)
+            e->const_buf[j] = const_arrays && const_arrays[j] ? const_arrays[j][i]
+                                                              : const_values[j];
+        res[i] = av_expr_eval(e, e->const_buf, opaque);
+    }
+    return 0;
+}
+
+int av_expr_is_stateless(const AVExpr *e)
+{
+    int nb_insns = 0, max_depth = 0;
+
+    return flatten_expr(NULL, &nb_insns, &max_depth, 0, e) >= 0;
+}
+
+static void count_vars(const AVExpr *e, unsigned *counter, int size)
+{
+    int i;
+
+    if (e->type == e_const && e->a.const_index < size)
+        counter[e->a.const_index]++;
+    for (i = 0; i < 3 && e->param[i]; i++)
+        count_vars(e->param[i], counter, size);
+}
+
+int av_expr_count_vars(AVExpr *e, unsigned *counter, int size)
+{
+    if (!e || !counter || size <= 0)
+        return AVERROR(EINVAL);
+
+    count_vars(e, counter, size);
+    return 0;
+}
+
 int av_expr_parse_and_eval(double *d, const char *s,
                            const char * const *const_names, const double *const_values,
                            const char * const *func1_names, double (* const *funcs1)(void *, double),
@@ -86,6 +86,58 @@ int av_expr_parse(AVExpr **expr, const char *s,
  */
 double av_expr_eval(AVExpr *e, const double *const_values, void *opaque);
 
+/**
+ * Evaluate a previously parsed expression for several sets of constant
+ * values at once.
+ *
+ * Expressions without side effects are evaluated by a flattened program
+ * that processes blocks of values per operation, which is considerably
+ * faster than calling av_expr_eval() for every value. Other expressions
+ * are evaluated one value after the other.
+ *
+ * Both branches of if() and ifnot() may be evaluated, so the functions
+ * from funcs1 and funcs2 must not have side effects.
+ *
+ * @param res array where the nb_values results are stored
+ * @param nb_values number of values to compute
+ * @param const_values values for the identifiers from av_expr_parse()
+ * const_names that are the same for all results
+ * @param const_arrays array with one entry per identifier from
+ * av_expr_parse() const_names, either NULL or pointing to nb_values
+ * values to use instead of the corresponding entry of const_values;
+ * may be NULL if all constants are taken from const_values
+ * @param opaque a pointer which will be passed to all functions from funcs1 and funcs2
+ * @return 0 on success, a negative AVERROR code if the evaluator could not
+ * be set up on the first call
+ */
+int av_expr_eval_array(AVExpr *e, double *res, int nb_values,
+                       const double *const_values,
+                       const double * const *const_arrays, void *opaque);
+
+/**
+ * Check whether the result of an expression only depends on the values of
+ * its constants, i.e. it does not use st(), random(), print(), while(),
+ * taylor() or root(). Copies of such an expression evaluated on different
+ * values always give the same results as a single one evaluated on all of
+ * them, and av_expr_eval_array() can process them in blocks.
+ *
+ * @return 1 if the expression is stateless, 0 otherwise
+ */
+int av_expr_is_stateless(const AVExpr *e);
+
+/**
+ * Track the presence of variables and their number of occurrences in a
+ * parsed expression.
+ *
+ * @param e the AVExpr to track variables in
+ * @param counter a zero-initialized array where the count of each variable
+ * from av_expr_parse() const_names will be stored
+ * @param size size of the counter array
+ * @return 0 on success, a negative value if no expression or array was
+ * passed or size was zero
+ */
+int av_expr_count_vars(AVExpr *e, unsigned *counter, int size);
+
 /**
  * Free a parsed expression previously created with av_expr_parse().
  */
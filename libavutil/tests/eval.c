@@ -21,6 +21,7 @@
 #include <string.h>
 
 #include "libavutil/libm.h"
+#include "libavutil/log.h"
 #include "libavutil/timer.h"
 #include "libavutil/eval.h"
 
@@ -36,6 +37,44 @@ static const char *const const_names[] = {
     0
 };
 
+#define NB_LANES 100
+
+/* evaluate over several lanes with a varying PI and compare against
+ * the scalar evaluator, only mismatches are reported */
+static void check_eval_array(const char *s)
+{
+    AVExpr *e_ref = NULL, *e_new = NULL;
+    double pi[NB_LANES], res[NB_LANES], values[FF_ARRAY_ELEMS(const_values)];
+    const double *arrays[FF_ARRAY_ELEMS(const_values)] = { pi };
+    int i;
+
+    if (av_expr_parse(&e_ref, s, const_names, NULL, NULL, NULL, NULL, 0, NULL) < 0 ||
+        av_expr_parse(&e_new, s, const_names, NULL, NULL, NULL, NULL, 0, NULL) < 0)
+        goto end;
+
+    for (i = 0; i < NB_LANES; i++)
+        pi[i] = M_PI + i - NB_LANES / 2;
+    if (av_expr_eval_array(e_new, res, NB_LANES, const_values, arrays, NULL) < 0)
+        goto end;
+
+    memcpy(values, const_values, sizeof(values));
+    for (i = 0; i < NB_LANES; i++) {
+        double ref;
+
+        values[0] = pi[i];
+        ref = av_expr_eval(e_ref, values, NULL);
+        if (ref != res[i] && !(isnan(ref) && isnan(res[i]))) {
+            printf("av_expr_eval_array mismatch for '%s' at %d: %f != %f\n",
+                   s, i, res[i], ref);
+            break;
+        }
+    }
+
+end:
+    av_expr_free(e_ref);
+    av_expr_free(e_new);
+}
+
 int main(int argc, char **argv)
 {
     int i;
@@ -154,6 +193,11 @@ int main(int argc, char **argv)
             printf("av_expr_parse_and_eval failed\n");
     }
 
+    av_log_set_level(AV_LOG_QUIET);
+    for (expr = exprs; *expr; expr++)
+        check_eval_array(*expr);
+    av_log_set_level(AV_LOG_INFO);
+
     ret = av_expr_parse_and_eval(&d, "1+(5-2)^(3-1)+1/2+sin(PI)-max(-2.2,-3.1)",
                            const_names, const_values,
                            NULL, NULL, NULL, NULL, NULL, 0, NULL);
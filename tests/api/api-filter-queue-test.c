@@ -0,0 +1,218 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Bounded filter queues test: feed only one input of a multi-input filter
+ * and check that the buffer source stalls instead of letting the filter
+ * hoard the frames, then feed the lagging input and check the output.
+ */
+
+#include <string.h>
+
+#include "libavutil/channel_layout.h"
+#include "libavutil/frame.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+
+#define MAX_QUEUED_FRAMES  4
+#define MAX_STALL_FRAMES  (8 * MAX_QUEUED_FRAMES)
+#define NB_FRAMES         50
+#define NB_SAMPLES        100
+
+struct test_input {
+    AVFilterContext *src;
+    int nb_sent;
+    int eof;
+};
+
+static int send_frame(struct test_input *in, enum AVMediaType type)
+{
+    AVFrame *frame;
+    int ret;
+
+    if (in->eof)
+        return 0;
+    if (in->nb_sent == NB_FRAMES) {
+        if ((ret = av_buffersrc_add_frame_flags(in->src, NULL, AV_BUFFERSRC_FLAG_PUSH)) < 0)
+            return ret;
+        in->eof = 1;
+        return 1;
+    }
+
+    frame = av_frame_alloc();
+    if (!frame)
+        return AVERROR(ENOMEM);
+    if (type == AVMEDIA_TYPE_VIDEO) {
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width  = 16;
+        frame->height = 16;
+        frame->pts    = in->nb_sent;
+    } else {
+        frame->format         = AV_SAMPLE_FMT_FLTP;
+        frame->channel_layout = AV_CH_LAYOUT_MONO;
+        frame->sample_rate    = 8000;
+        frame->nb_samples     = NB_SAMPLES;
+        frame->pts            = in->nb_sent * NB_SAMPLES;
+    }
+    if ((ret = av_frame_get_buffer(frame, 32)) < 0)
+        goto end;
+    if (type == AVMEDIA_TYPE_VIDEO) {
+        memset(frame->data[0], 0x10, frame->linesize[0] * frame->height);
+        memset(frame->data[1], 0x80, frame->linesize[1] * frame->height / 2);
+        memset(frame->data[2], 0x80, frame->linesize[2] * frame->height / 2);
+    } else {
+        memset(frame->data[0], 0, NB_SAMPLES * sizeof(float));
+    }
+
+    ret = av_buffersrc_add_frame_flags(in->src, frame, AV_BUFFERSRC_FLAG_PUSH);
+    if (ret >= 0) {
+        in->nb_sent++;
+        ret = 1;
+    } else if (ret == AVERROR(EAGAIN)) {
+        ret = 0;
+    }
+end:
+    av_frame_free(&frame);
+    return ret;
+}
+
+static int drain_sink(AVFilterContext *sink, int64_t *nb_out)
+{
+    AVFrame *frame = av_frame_alloc();
+    int ret, progress = 0;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+    while ((ret = av_buffersink_get_frame(sink, frame)) >= 0) {
+        *nb_out += frame->nb_samples ? frame->nb_samples : 1;
+        av_frame_unref(frame);
+        progress = 1;
+    }
+    av_frame_free(&frame);
+    if (ret == AVERROR_EOF)
+        return -1;
+    if (ret != AVERROR(EAGAIN))
+        return ret;
+    return progress;
+}
+
+static int run_test(const char *filter_name, const char *filter_args,
+                    enum AVMediaType type, unsigned lead, unsigned lag,
+                    int64_t nb_expected)
+{
+    const char *src_name  = type == AVMEDIA_TYPE_VIDEO ? "buffer" : "abuffer";
+    const char *sink_name = type == AVMEDIA_TYPE_VIDEO ? "buffersink" : "abuffersink";
+    const char *src_args  = type == AVMEDIA_TYPE_VIDEO ?
+        "video_size=16x16:pix_fmt=yuv420p:time_base=1/25:pixel_aspect=1/1" :
+        "sample_rate=8000:sample_fmt=fltp:channel_layout=mono:time_base=1/8000";
+    AVFilterGraph *graph;
+    AVFilterContext *filter, *sink;
+    struct test_input in[2] = { { 0 } };
+    int64_t nb_out = 0;
+    int i, ret, sink_eof = 0;
+
+    graph = avfilter_graph_alloc();
+    if (!graph)
+        return AVERROR(ENOMEM);
+    graph->max_queued_frames = MAX_QUEUED_FRAMES;
+
+    ret = avfilter_graph_create_filter(&filter, avfilter_get_by_name(filter_name),
+                                       NULL, filter_args, NULL, graph);
+    if (ret < 0)
+        goto end;
+    for (i = 0; i < 2; i++) {
+        ret = avfilter_graph_create_filter(&in[i].src, avfilter_get_by_name(src_name),
+                                           NULL, src_args, NULL, graph);
+        if (ret < 0 || (ret = avfilter_link(in[i].src, 0, filter, i)) < 0)
+            goto end;
+    }
+    ret = avfilter_graph_create_filter(&sink, avfilter_get_by_name(sink_name),
+                                       NULL, NULL, NULL, graph);
+    if (ret < 0 || (ret = avfilter_link(filter, 0, sink, 0)) < 0 ||
+        (ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto end;
+
+    /* feed the leading input alone until the source stalls */
+    while ((ret = send_frame(&in[lead], type)) > 0) {
+        if (in[lead].nb_sent > MAX_STALL_FRAMES) {
+            fprintf(stderr, "%s: %d frames taken from the leading input alone\n",
+                    filter_name, in[lead].nb_sent);
+            ret = AVERROR_BUG;
+            goto end;
+        }
+    }
+    if (ret < 0)
+        goto end;
+
+    /* feed the lagging input until everything has been filtered */
+    while (!sink_eof) {
+        int progress = 0;
+
+        if ((ret = send_frame(&in[lag], type)) < 0)
+            goto end;
+        progress |= ret;
+        if ((ret = send_frame(&in[lead], type)) < 0)
+            goto end;
+        progress |= ret;
+        if ((ret = drain_sink(sink, &nb_out)) < -1)
+            goto end;
+        sink_eof = ret < 0;
+        progress |= ret;
+        if (!progress) {
+            fprintf(stderr, "%s: no progress after %d and %d frames\n",
+                    filter_name, in[lead].nb_sent, in[lag].nb_sent);
+            ret = AVERROR_BUG;
+            goto end;
+        }
+    }
+
+    if (nb_out != nb_expected) {
+        fprintf(stderr, "%s: got %"PRId64" output units, expected %"PRId64"\n",
+                filter_name, nb_out, nb_expected);
+        ret = AVERROR_BUG;
+        goto end;
+    }
+    ret = 0;
+
+end:
+    avfilter_graph_free(&graph);
+    if (ret < 0 && ret != AVERROR_BUG)
+        fprintf(stderr, "%s: %s\n", filter_name, av_err2str(ret));
+    return ret;
+}
+
+int main(void)
+{
+    int ret = 0;
+
+    avfilter_register_all();
+
+    /* main input ahead of the overlaid input */
+    ret |= run_test("overlay", NULL, AVMEDIA_TYPE_VIDEO, 0, 1, NB_FRAMES);
+    /* first input ahead of the second input */
+    ret |= run_test("amix", NULL, AVMEDIA_TYPE_AUDIO, 0, 1, NB_FRAMES * NB_SAMPLES);
+    /* second input ahead of the first input */
+    ret |= run_test("amix", NULL, AVMEDIA_TYPE_AUDIO, 1, 0, NB_FRAMES * NB_SAMPLES);
+    /* second segment available before the first one */
+    ret |= run_test("concat", "n=2", AVMEDIA_TYPE_VIDEO, 1, 0, 2 * NB_FRAMES);
+
+    return !!ret;
+}
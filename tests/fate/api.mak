@@ -34,6 +34,12 @@ fate-api-threadmessage: CMD = run $(APITESTSDIR)/api-threadmessage-test 3 10 30
 fate-api-threadmessage: CMP = null
 fate-api-threadmessage: REF = /dev/null
 
+FATE_API-$(call ALLYES, AMIX_FILTER OVERLAY_FILTER CONCAT_FILTER) += fate-api-filter-queue
+fate-api-filter-queue: $(APITESTSDIR)/api-filter-queue-test$(EXESUF)
+fate-api-filter-queue: CMD = run $(APITESTSDIR)/api-filter-queue-test
+fate-api-filter-queue: CMP = null
+fate-api-filter-queue: REF = /dev/null
+
 FATE_API_SAMPLES-$(CONFIG_AVFORMAT) += $(FATE_API_SAMPLES_LIBAVFORMAT-yes)
 
 ifdef SAMPLES
@@ -123,6 +123,16 @@ fate-filter-firequalizer: CMP = oneoff
 fate-filter-firequalizer: CMP_UNIT = s16
 fate-filter-firequalizer: SIZE_TOLERANCE = 1058400 - 1097208
 
+# delays long enough for the partitioned convolution
+FATE_AFILTER-$(call FILTERDEMDECENCMUX, FIREQUALIZER ATRIM, WAV, PCM_S16LE, PCM_S16LE, WAV) += fate-filter-firequalizer-long
+fate-filter-firequalizer-long: tests/data/asynth-44100-2.wav
+fate-filter-firequalizer-long: tests/data/filtergraphs/firequalizer-long
+fate-filter-firequalizer-long: REF = tests/data/asynth-44100-2.wav
+fate-filter-firequalizer-long: CMD = ffmpeg -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav -filter_script $(TARGET_PATH)/tests/data/filtergraphs/firequalizer-long -f wav -acodec pcm_s16le -
+fate-filter-firequalizer-long: CMP = oneoff
+fate-filter-firequalizer-long: CMP_UNIT = s16
+fate-filter-firequalizer-long: SIZE_TOLERANCE = 1058400 - 1173060
+
 FATE_AFILTER_SAMPLES-$(call FILTERDEMDECENCMUX, SILENCEREMOVE, WAV, PCM_S16LE, PCM_S16LE, WAV) += fate-filter-silenceremove
 fate-filter-silenceremove: SRC = $(TARGET_SAMPLES)/audio-reference/divertimenti_2ch_96kHz_s24.wav
 fate-filter-silenceremove: CMD = framecrc -i $(SRC) -aframes 30 -af silenceremove=0:0:0:-1:0:-90dB
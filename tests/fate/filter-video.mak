@@ -115,6 +115,9 @@ fate-filter-interlace: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf interlace
 FATE_FILTER_VSYNTH-$(call ALLYES, NEGATE_FILTER PERMS_FILTER) += fate-filter-negate
 fate-filter-negate: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf perms=random,negate
 
+FATE_FILTER_VSYNTH-$(call ALLYES, CROP_FILTER LUTYUV_FILTER) += fate-filter-lutyuv-odd
+fate-filter-lutyuv-odd: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf crop=351:287:1:1:exact=1,lutyuv=y=negval:u=2*val:v=val/2
+
 FATE_FILTER_VSYNTH-$(CONFIG_HISTOGRAM_FILTER) += fate-filter-histogram-levels
 fate-filter-histogram-levels: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf histogram -flags +bitexact -sws_flags +accurate_rnd+bitexact
 
@@ -180,6 +183,14 @@ FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER PAD_FILTER OVERLAY_F
 fate-filter-overlay_yuv444: tests/data/filtergraphs/overlay_yuv444
 fate-filter-overlay_yuv444: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_yuv444
 
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER SCALE_FILTER ALPHAMERGE_FILTER OVERLAY_FILTER) += fate-filter-overlay_yuv420_odd
+fate-filter-overlay_yuv420_odd: tests/data/filtergraphs/overlay_yuv420_odd
+fate-filter-overlay_yuv420_odd: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_yuv420_odd
+
+FATE_FILTER_VSYNTH-$(call ALLYES, SPLIT_FILTER FORMAT_FILTER SCALE_FILTER ALPHAMERGE_FILTER OVERLAY_FILTER) += fate-filter-overlay_yuv422_odd
+fate-filter-overlay_yuv422_odd: tests/data/filtergraphs/overlay_yuv422_odd
+fate-filter-overlay_yuv422_odd: CMD = framecrc -c:v pgmyuv -i $(SRC) -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/overlay_yuv422_odd
+
 FATE_FILTER_VSYNTH-$(CONFIG_PHASE_FILTER) += fate-filter-phase
 fate-filter-phase: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf phase
 
@@ -319,6 +330,9 @@ FATE_FILTER_VSYNTH-$(CONFIG_TRIM_FILTER) += $(FATE_TRIM)
 FATE_FILTER_VSYNTH-$(CONFIG_UNSHARP_FILTER) += fate-filter-unsharp
 fate-filter-unsharp: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf unsharp=11:11:-1.5:11:11:-1.5
 
+FATE_FILTER_VSYNTH-$(call ALLYES, CROP_FILTER UNSHARP_FILTER) += fate-filter-unsharp-odd
+fate-filter-unsharp-odd: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf crop=351:287:1:1:exact=1,unsharp=5:3:1.5:3:5:-1
+
 FATE_FILTER_SAMPLES-$(call ALLYES, SMJPEG_DEMUXER MJPEG_DECODER PERMS_FILTER HQDN3D_FILTER) += fate-filter-hqdn3d-sample
 fate-filter-hqdn3d-sample: tests/data/filtergraphs/hqdn3d
 fate-filter-hqdn3d-sample: CMD = framecrc -idct simple -i $(TARGET_SAMPLES)/smjpeg/scenwin.mjpg -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/hqdn3d -an
@@ -393,6 +407,9 @@ FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scalechroma
 fate-filter-scalechroma: tests/data/vsynth1.yuv
 fate-filter-scalechroma: CMD = framecrc -flags bitexact -s 352x288 -pix_fmt yuv444p -i tests/data/vsynth1.yuv -pix_fmt yuv420p -sws_flags +bitexact -vf scale=out_v_chr_pos=33:out_h_chr_pos=151
 
+FATE_FILTER_VSYNTH-$(call ALLYES, CROP_FILTER VAGUEDENOISER_FILTER) += fate-filter-vaguedenoiser-odd
+fate-filter-vaguedenoiser-odd: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf crop=351:287:1:1:exact=1,vaguedenoiser=method=soft:nsteps=4
+
 FATE_FILTER_VSYNTH-$(CONFIG_VFLIP_FILTER) += fate-filter-vflip
 fate-filter-vflip: CMD = video_filter "vflip"
 
@@ -643,6 +660,10 @@ FATE_METADATA_FILTER-$(call ALLYES, $(EBUR128_METADATA_DEPS)) += fate-filter-met
 fate-filter-metadata-ebur128: SRC = $(TARGET_SAMPLES)/filter/seq-3341-7_seq-3342-5-24bit.flac
 fate-filter-metadata-ebur128: CMD = run $(FILTER_METADATA_COMMAND) "amovie='$(SRC)',ebur128=metadata=1"
 
+EBUR128_TRUEPEAK_METADATA_DEPS = FFPROBE AVDEVICE LAVFI_INDEV AEVALSRC_FILTER EBUR128_FILTER
+FATE_METADATA_FILTER_NOSAMPLES-$(call ALLYES, $(EBUR128_TRUEPEAK_METADATA_DEPS)) += fate-filter-metadata-ebur128-truepeak
+fate-filter-metadata-ebur128-truepeak: CMD = run $(FILTER_METADATA_COMMAND) "aevalsrc=t*sin(2*PI*997*t)|0.5*sin(2*PI*19000*t+1):s=48000:d=1,ebur128=metadata=1:peak=true:framelog=quiet"
+
 READVITC_METADATA_DEPS = FFPROBE LAVFI_INDEV MOVIE_FILTER AVCODEC AVDEVICE \
                          AVI_DEMUXER FFVHUFF_DECODER READVITC_FILTER
 FATE_METADATA_FILTER-$(call ALLYES, $(READVITC_METADATA_DEPS)) += fate-filter-metadata-readvitc-def
@@ -662,10 +683,15 @@ FATE_FILTER_SAMPLES-$(call ALLYES, MOV_DEMUXER H264_DECODER AAC_FIXED_DECODER PC
 fate-filter-meta-4560-rotate0: tests/data/file4560-override2rotate0.mov
 fate-filter-meta-4560-rotate0: CMD = framecrc -flags +bitexact -c:a aac_fixed -i $(TARGET_PATH)/tests/data/file4560-override2rotate0.mov
 
+FATE_FILTER-yes += fate-filter-drawutils
+fate-filter-drawutils: libavfilter/tests/drawutils$(EXESUF)
+fate-filter-drawutils: CMD = run libavfilter/tests/drawutils
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
+FATE_FFPROBE += $(FATE_METADATA_FILTER_NOSAMPLES-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
 
 fate-vfilter: $(FATE_FILTER-yes) $(FATE_FILTER_SAMPLES-yes) $(FATE_FILTER_VSYNTH-yes)
 
-fate-filter: fate-afilter fate-vfilter $(FATE_METADATA_FILTER-yes)
+fate-filter: fate-afilter fate-vfilter $(FATE_METADATA_FILTER-yes) $(FATE_METADATA_FILTER_NOSAMPLES-yes)